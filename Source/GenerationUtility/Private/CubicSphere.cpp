@@ -1,6 +1,7 @@
 #include "CubicSphere.h"
 #include "CUMeasureTimer.h"
 #include "KismetProceduralMeshLibrary.h"
+#include "Async/ParallelFor.h"
 
 #define DEBUG_CUBIC_SPHERE_TIMINGS 0
 
@@ -33,27 +34,14 @@ void FCubicSphere::GenerateFace(FVector Direction, const FCubicSphereParams& Sph
 	float Spacing = SphereParams.Scaling / (GridCount - 1);
 	//FVector ChunkCenter = FVector(0.f);	//move chunks around to fit...
 
-	FTransform Transform;
 	float HalfOffset = (Spacing * (GridCount - 1)) / 2;
 
 	FCubicSphere::CreateQuadGridMeshWelded(GridCount, GridCount, Data.Triangles, Data.Vertices, Data.UVs, Spacing);
 	Data.Normals.SetNumUninitialized(Data.Vertices.Num());
 
-	if (SphereParams.bOffsetByDirection)
-	{
-		Transform.SetLocation((Direction * HalfOffset) + SphereParams.LocalOffset);
-	}
-	else
-	{
-		Transform.SetLocation(SphereParams.LocalOffset);
-	}
+	const FTransform Transform = FaceTransform(Direction, SphereParams, HalfOffset);
 
-	Transform.SetRotation(Direction.ToOrientationQuat() * FRotator(-90, 0, 0).Quaternion());
-
-	FGnomonicParams Gnomonic;
-	Gnomonic.Radius = SphereParams.Radius;
-	Gnomonic.SphericalFactor = SphereParams.SphericalFactor;
-	Gnomonic.EquiangularFactor = SphereParams.EquiAngleFactor;
+	const FGnomonicParams Gnomonic = GnomonicForParams(SphereParams);
 
 	//Transform Vertices of resolution plane to match desired shape
 	{
@@ -63,7 +51,6 @@ void FCubicSphere::GenerateFace(FVector Direction, const FCubicSphereParams& Sph
 		for (int32 i = 0; i < Data.Vertices.Num(); i++)
 		{
 			FVector3d Vertex = FVector3d(Data.Vertices[i]);
-			FVector3d Normal = FVector3d(Data.Normals[i]);
 
 			//Cube vertex
 			Vertex = Transform.TransformPosition(Vertex);
@@ -82,14 +69,15 @@ void FCubicSphere::GenerateFace(FVector Direction, const FCubicSphereParams& Sph
 #if DEBUG_CUBIC_SPHERE_TIMINGS
 		FCUScopeTimer Timer0(TEXT("Normals"));
 #endif
-		//NB: need to convert calc for RMC tangents, currently semi-broken
-		TArray<FVector3d> Normals = RMC_ConvertTArray<FVector3d>(Data.Normals);
-		UKismetProceduralMeshLibrary::CalculateTangentsForMesh(RMC_ConvertTArray<FVector3d>(Data.Vertices),
-			Data.Triangles,
-			RMC_ConvertTArray<FVector2d>(Data.UVs),
-			Normals,
-			Data.PMTangents);
-		Data.Normals = RMC_ConvertTArray<FVector3f>(Normals);
+		//Grid aware float kernel, no double round trip
+		TArray<FVector3f> TangentsX;
+		CalculateGridTangents((int32)GridCount, (int32)GridCount, Data.Vertices, Data.Normals, TangentsX);
+
+		Data.Tangents.SetNumUninitialized(TangentsX.Num());
+		for (int32 i = 0; i < TangentsX.Num(); i++)
+		{
+			Data.Tangents[i] = FRealtimeMeshTangentsNormalPrecision(Data.Normals[i], TangentsX[i]);
+		}
 	}
 
 	GenerateCallback(Data);
@@ -104,10 +92,6 @@ void FCubicSphere::GenerateFace(FVector Direction, const FCubicSphereParams& Sph
 
 void FCubicSphere::GenerateCube(const FCubicSphereParams& SphereParams, TFunction<void(FMeshSectionData& MeshData)> GenerateCallback)
 {
-	//Ensure we sync our desired resolution (NB: could be skipped if params didn't change...)
-	//Scaling == desired diameter, pass in half for radius
-	PlanetQuad->UpdateTreeResolution(SphereParams.Scaling / 2.f, SphereParams.QuadDepth, SphereParams.QuadBaseline);
-
 	TFunction<void(FMeshSectionData&)> DefaultGenerateCallback = [](FMeshSectionData& Data)
 	{
 		//NB: overwrite condition possible if WaitFor is omitted.
@@ -127,20 +111,29 @@ void FCubicSphere::GenerateCube(const FCubicSphereParams& SphereParams, TFunctio
 		GenerateCallback = DefaultGenerateCallback;
 	}
 
-	//Pass the generate face param to match
+	TArray<FCubeFace> Faces;
+	CollectFaces(SphereParams, Faces);
+
+	for (const FCubeFace& Face : Faces)
+	{
+		GenerateFace(Face.Direction, Face.Params, GenerateCallback);
+	}
+}
+
+void FCubicSphere::CollectFaces(const FCubicSphereParams& SphereParams, TArray<FCubeFace>& OutFaces)
+{
+	//Ensure we sync our desired resolution (NB: could be skipped if params didn't change...)
+	//Scaling == desired diameter, pass in half for radius
+	PlanetQuad->UpdateTreeResolution(SphereParams.Scaling / 2.f, SphereParams.QuadDepth, SphereParams.QuadBaseline);
 
 	//Uses QuadTree lodding, generate quadtree and generate one face per quad
 	if (SphereParams.bQuadSplit)
 	{
 		PlanetQuad->SetTopOnly(SphereParams.bTopOnly);
+		PlanetQuad->SetStitchEdges(SphereParams.bStitchEdges);
 
 		//Specify sphericity params for node center comparison using gnomonic sphere cube projection
-		FGnomonicParams Gnomonic;
-		Gnomonic.Radius = SphereParams.Radius;
-		Gnomonic.SphericalFactor = SphereParams.SphericalFactor;
-		Gnomonic.EquiangularFactor = SphereParams.EquiAngleFactor;
-
-		PlanetQuad->Regenerate(SphereParams.WorldCamera, SphereParams.WorldOrigin, Gnomonic);
+		PlanetQuad->Regenerate(SphereParams.WorldCamera, SphereParams.WorldOrigin, GnomonicForParams(SphereParams));
 
 		TArray<FGridQuadNode*> TipNodes;
 		PlanetQuad->FillTipNodes(TipNodes);
@@ -148,16 +141,9 @@ void FCubicSphere::GenerateCube(const FCubicSphereParams& SphereParams, TFunctio
 		UE_LOG(LogTemp, Log, TEXT("GenerateCube: Total TipNodes: %d"), TipNodes.Num());
 
 		int32 N = 0;
-		FCubicSphereParams NodeParams = SphereParams;
 		for (FGridQuadNode* Node : TipNodes)
 		{
-
-			NodeParams.LocalOffset = Node->Center;
-			NodeParams.Scaling = Node->Size.X * 2.f;
-			NodeParams.Section = N;
-			NodeParams.bOffsetByDirection = false;
-
-			GenerateFace(Node->Normal, NodeParams, GenerateCallback);
+			AddNodeFace(*Node, SphereParams, N, OutFaces);
 			N++;
 		}
 	}
@@ -167,52 +153,312 @@ void FCubicSphere::GenerateCube(const FCubicSphereParams& SphereParams, TFunctio
 		NodeParams.Section = 0;
 
 		//No Quad loding, just apply as single mesh
-		GenerateFace(FVector::UpVector, NodeParams, GenerateCallback);
+		OutFaces.Add({ FVector::UpVector, NodeParams, FPatchKey(0, 0, 0, 0) });
 
 		if (!SphereParams.bTopOnly)
 		{
 			for (int32 i = 1; i < 6; i++)
 			{
 				NodeParams.Section = 0;
-				GenerateFace(FPlanetQuad::NormalForFaceIndex(i), NodeParams, GenerateCallback);
+				OutFaces.Add({ FPlanetQuad::NormalForFaceIndex(i), NodeParams, FPatchKey(i, 0, 0, 0) });
 			}
 		}
 	}
 }
 
-void FCubicSphere::CreateQuadGridMeshWelded(int32 NumX, int32 NumY, TArray<int32>& Triangles, TArray<FVector3f>& Vertices, TArray<FVector2f>& UVs, float GridSpacing)
+void FCubicSphere::AddNodeFace(const FGridQuadNode& Node, const FCubicSphereParams& SphereParams, int32 Section, TArray<FCubeFace>& OutFaces)
 {
-	Triangles.Empty();
-	Vertices.Empty();
-	UVs.Empty();
+	FCubicSphereParams NodeParams = SphereParams;
+	NodeParams.LocalOffset = Node.Center;
+	NodeParams.Scaling = Node.Size.X * 2.f;
+	NodeParams.Section = Section;
+	NodeParams.bOffsetByDirection = false;
 
-	if (NumX >= 2 && NumY >= 2)
+	OutFaces.Add({ Node.Normal, NodeParams, Node.GetKey(), Node.Forward, Node.StitchMask });
+}
+
+FGnomonicParams FCubicSphere::GnomonicForParams(const FCubicSphereParams& SphereParams)
+{
+	FGnomonicParams Gnomonic;
+	Gnomonic.Radius = SphereParams.Radius;
+	Gnomonic.SphericalFactor = SphereParams.SphericalFactor;
+	Gnomonic.EquiangularFactor = SphereParams.EquiAngleFactor;
+	return Gnomonic;
+}
+
+FTransform FCubicSphere::FaceTransform(const FVector& Direction, const FCubicSphereParams& SphereParams, float HalfOffset)
+{
+	FTransform Transform;
+
+	if (SphereParams.bOffsetByDirection)
+	{
+		Transform.SetLocation((Direction * HalfOffset) + SphereParams.LocalOffset);
+	}
+	else
+	{
+		Transform.SetLocation(SphereParams.LocalOffset);
+	}
+
+	Transform.SetRotation(Direction.ToOrientationQuat() * FRotator(-90, 0, 0).Quaternion());
+	return Transform;
+}
+
+void FCubicSphere::GenerateCubeStreams(const FCubicSphereParams& SphereParams, TArray<FCubicSphereSection>& OutSections, TFunction<void(FMeshSectionData& MeshData)> DeformCallback)
+{
+	TArray<FCubeFace> Faces;
+	CollectFaces(SphereParams, Faces);
+
+	BuildFaces(Faces, OutSections, DeformCallback);
+}
+
+void FCubicSphere::GenerateCubeIncremental(const FCubicSphereParams& SphereParams, TArray<FCubicSphereSection>& OutAdded, TArray<FPatchKey>& OutRemoved,
+	TFunction<void(FMeshSectionData& MeshData)> DeformCallback)
+{
+	OutRemoved.Reset();
+
+	if (!SphereParams.bQuadSplit)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FCubicSphere::GenerateCubeIncremental needs bQuadSplit, building all faces"));
+		GenerateCubeStreams(SphereParams, OutAdded, DeformCallback);
+		return;
+	}
+
+	PlanetQuad->UpdateTreeResolution(SphereParams.Scaling / 2.f, SphereParams.QuadDepth, SphereParams.QuadBaseline);
+	PlanetQuad->SetTopOnly(SphereParams.bTopOnly);
+	PlanetQuad->SetStitchEdges(SphereParams.bStitchEdges);
+	PlanetQuad->MergeHysteresis = SphereParams.MergeHysteresis;
+
+	FQuadTreeUpdate Update;
+	PlanetQuad->UpdateIncremental(SphereParams.WorldCamera, SphereParams.WorldOrigin, GnomonicForParams(SphereParams), Update);
+
+	UE_LOG(LogTemp, Log, TEXT("GenerateCubeIncremental: %d tip nodes added, %d removed, %d pooled nodes"), Update.Added.Num(), Update.Removed.Num(), PlanetQuad->NumNodes());
+
+	TArray<FCubeFace> Faces;
+	for (int32 i = 0; i < Update.Added.Num(); i++)
 	{
-		FVector2D Extent = FVector2D((NumX - 1) * GridSpacing, (NumY - 1) * GridSpacing) / 2;
+		AddNodeFace(*Update.Added[i], SphereParams, i, Faces);
+	}
+
+	BuildFaces(Faces, OutAdded, DeformCallback);
+	OutRemoved = MoveTemp(Update.Removed);
+}
 
-		for (int i = 0; i < NumY; i++)
+void FCubicSphere::BuildFaces(const TArray<FCubeFace>& Faces, TArray<FCubicSphereSection>& OutSections, TFunction<void(FMeshSectionData& MeshData)>& DeformCallback)
+{
+	//Every face writes its own slot, no locking needed
+	OutSections.SetNum(Faces.Num());
+
+#if DEBUG_CUBIC_SPHERE_TIMINGS
+	FCUScopeTimer Timer0(TEXT("Parallel Faces"));
+#endif
+	TArray<FFaceScratch> ScratchPool;
+	ParallelForWithTaskContext(ScratchPool, Faces.Num(), [&](FFaceScratch& Scratch, int32 Index)
+	{
+		BuildFaceStreams(Faces[Index], DeformCallback, Scratch, OutSections[Index]);
+		OutSections[Index].Section = Index;
+		OutSections[Index].Key = Faces[Index].Key;
+	});
+}
+
+uint8 FCubicSphere::GridStitchMask(const FCubeFace& Face, const FTransform& Transform)
+{
+	if (Face.StitchMask == 0)
+	{
+		return 0;
+	}
+
+	//Node edges are in face axes, the grid is rotated onto the face by Transform
+	const FVector Right = FVector::CrossProduct(Face.Direction, Face.Forward);
+	const FVector EdgeDirections[4] = { -Right, Right, -Face.Forward, Face.Forward };
+	const FVector GridX = Transform.TransformVectorNoScale(FVector::XAxisVector);
+	const FVector GridY = Transform.TransformVectorNoScale(FVector::YAxisVector);
+
+	uint8 Mask = 0;
+	for (int32 Edge = 0; Edge < 4; Edge++)
+	{
+		if (!(Face.StitchMask & (1 << Edge)))
 		{
-			for (int j = 0; j < NumX; j++)
-			{
-				Vertices.Add(FVector3f((float)j * GridSpacing - Extent.X, (float)i * GridSpacing - Extent.Y, 0));
-				UVs.Add(FVector2f((float)j / ((float)NumX - 1), (float)i / ((float)NumY - 1)));
-			}
+			continue;
 		}
 
-		for (int i = 0; i < NumY - 1; i++)
+		const double X = FVector::DotProduct(EdgeDirections[Edge], GridX);
+		const double Y = FVector::DotProduct(EdgeDirections[Edge], GridY);
+		EQuadEdge GridEdge;
+		if (FMath::Abs(X) > FMath::Abs(Y))
 		{
-			for (int j = 0; j < NumX - 1; j++)
-			{
-				int idx = j + (i * NumX);
-				Triangles.Add(idx);
-				Triangles.Add(idx + NumX);
-				Triangles.Add(idx + 1);
-
-				Triangles.Add(idx + 1);
-				Triangles.Add(idx + NumX);
-				Triangles.Add(idx + NumX + 1);
-			}
+			GridEdge = X < 0 ? EQuadEdge::West : EQuadEdge::East;
+		}
+		else
+		{
+			GridEdge = Y < 0 ? EQuadEdge::South : EQuadEdge::North;
+		}
+		Mask |= 1 << (uint8)GridEdge;
+	}
+	return Mask;
+}
+
+void FCubicSphere::BuildFaceStreams(const FCubeFace& Face, TFunction<void(FMeshSectionData& MeshData)>& DeformCallback, FFaceScratch& Scratch, FCubicSphereSection& OutSection)
+{
+	FMeshSectionData& MeshData = Scratch.MeshData;
+
+	const int32 GridCount = FMath::Max(Face.Params.Resolution, 2);
+	const float Spacing = Face.Params.Scaling / (GridCount - 1);
+	const float HalfOffset = (Spacing * (GridCount - 1)) / 2;
+
+	FCanonicalGridMeshRef Grid = FCanonicalGridMeshCache::Get().FindOrCreate(GridCount, GridCount);
+	const FTransform Transform = FaceTransform(Face.Direction, Face.Params, HalfOffset);
+
+	//Edges meeting a coarser tip skip every other vertex, so they line up with it
+	FStitchedGridIndicesRef Stitched = FStitchedGridIndexCache::Get().FindOrCreate(GridCount);
+	const TArray<int32>& Triangles = Stitched->Variants[GridStitchMask(Face, Transform)];
+
+	const FGnomonicParams Gnomonic = GnomonicForParams(Face.Params);
+
+	//Only Vertices are filled for the callback, nothing of the previous face may show through
+	MeshData.Mesh = Mesh;
+	MeshData.Section = Face.Params.Section;
+	MeshData.Triangles.Reset();
+	MeshData.Normals.Reset();
+	MeshData.UVs.Reset();
+	MeshData.VertexColors.Reset();
+	MeshData.Tangents.Reset();
+	MeshData.PMTangents.Reset();
+	MeshData.Vertices.SetNumUninitialized(Grid->Vertices.Num());
+	for (int32 i = 0; i < Grid->Vertices.Num(); i++)
+	{
+		const FVector3d Vertex = Transform.TransformPosition(FVector3d(Grid->Vertices[i] * Spacing));
+		MeshData.Vertices[i] = (FVector3f)FGnomonicParams::GnomonicProjection(Vertex, Gnomonic);
+	}
+
+	if (DeformCallback)
+	{
+		DeformCallback(MeshData);
+	}
+
+	CalculateGridTangents(GridCount, GridCount, MeshData.Vertices, MeshData.Normals, Scratch.Tangents);
+
+	FRealtimeMeshStreamSet& StreamSet = OutSection.Streams;
+
+	TRealtimeMeshStreamBuilder<FVector3f> PositionBuilder(StreamSet.AddStream(FRealtimeMeshStreams::Position, GetRealtimeMeshBufferLayout<FVector3f>()));
+	TRealtimeMeshStreamBuilder<FRealtimeMeshTangentsHighPrecision, FRealtimeMeshTangentsNormalPrecision> TangentBuilder(
+		StreamSet.AddStream(FRealtimeMeshStreams::Tangents, GetRealtimeMeshBufferLayout<FRealtimeMeshTangentsNormalPrecision>()));
+	TRealtimeMeshStreamBuilder<FVector2f, FVector2DHalf> TexCoordsBuilder(StreamSet.AddStream(FRealtimeMeshStreams::TexCoords, GetRealtimeMeshBufferLayout<FVector2DHalf>()));
+	TRealtimeMeshStreamBuilder<FColor> ColorBuilder(StreamSet.AddStream(FRealtimeMeshStreams::Color, GetRealtimeMeshBufferLayout<FColor>()));
+
+	const int32 NumVertices = MeshData.Vertices.Num();
+	PositionBuilder.Reserve(NumVertices);
+	TangentBuilder.Reserve(NumVertices);
+	TexCoordsBuilder.Reserve(NumVertices);
+	ColorBuilder.Reserve(NumVertices);
+
+	for (int32 i = 0; i < NumVertices; i++)
+	{
+		PositionBuilder.Add(MeshData.Vertices[i]);
+		TangentBuilder.Add(FRealtimeMeshTangentsHighPrecision(MeshData.Normals[i], Scratch.Tangents[i]));
+		TexCoordsBuilder.Add(Grid->UVs[i]);
+		ColorBuilder.Add(FColor::White);
+	}
+
+	//16 bit indices whenever the patch allows it
+	auto AddTriangles = [&Triangles](auto& TrianglesBuilder)
+	{
+		TrianglesBuilder.Reserve(Triangles.Num() / 3);
+		for (int32 i = 0; i < Triangles.Num(); i += 3)
+		{
+			TrianglesBuilder.Add(TIndex3<uint32>(Triangles[i], Triangles[i + 1], Triangles[i + 2]));
+		}
+	};
+
+	if (NumVertices <= MAX_uint16)
+	{
+		TRealtimeMeshStreamBuilder<TIndex3<uint32>, TIndex3<uint16>> TrianglesBuilder(StreamSet.AddStream(FRealtimeMeshStreams::Triangles, GetRealtimeMeshBufferLayout<TIndex3<uint16>>()));
+		AddTriangles(TrianglesBuilder);
+	}
+	else
+	{
+		TRealtimeMeshStreamBuilder<TIndex3<uint32>> TrianglesBuilder(StreamSet.AddStream(FRealtimeMeshStreams::Triangles, GetRealtimeMeshBufferLayout<TIndex3<uint32>>()));
+		AddTriangles(TrianglesBuilder);
+	}
+}
+
+void FCubicSphere::ApplySections(URealtimeMeshComponent* MeshComponent, TArray<FCubicSphereSection>& Sections)
+{
+	URealtimeMeshSimple* RealtimeMesh = MeshComponent->GetRealtimeMeshAs<URealtimeMeshSimple>();
+	if (!RealtimeMesh)
+	{
+		RealtimeMesh = MeshComponent->InitializeRealtimeMesh<URealtimeMeshSimple>();
+		RealtimeMesh->SetupMaterialSlot(0, "MaterialSlot0");
+	}
+
+	for (FCubicSphereSection& Section : Sections)
+	{
+		const FRealtimeMeshSectionGroupKey GroupKey = SectionGroupKey(Section.Key);
+		RealtimeMesh->CreateSectionGroup(GroupKey, MoveTemp(Section.Streams));
+		RealtimeMesh->UpdateSectionConfig(FRealtimeMeshSectionKey::CreateForPolyGroup(GroupKey, 0), FRealtimeMeshSectionConfig(0));
+	}
+}
+
+void FCubicSphere::RemoveSections(URealtimeMeshComponent* MeshComponent, const TArray<FPatchKey>& Keys)
+{
+	URealtimeMeshSimple* RealtimeMesh = MeshComponent->GetRealtimeMeshAs<URealtimeMeshSimple>();
+	if (!RealtimeMesh)
+	{
+		return;
+	}
+
+	for (const FPatchKey& Key : Keys)
+	{
+		RealtimeMesh->RemoveSectionGroup(SectionGroupKey(Key));
+	}
+}
+
+FRealtimeMeshSectionGroupKey FCubicSphere::SectionGroupKey(const FPatchKey& Key)
+{
+	return FRealtimeMeshSectionGroupKey::Create(0, FName(*FString::Printf(TEXT("Quad_%llx"), Key.Packed)));
+}
+
+void FCubicSphere::CalculateGridTangents(int32 NumX, int32 NumY, const TArray<FVector3f>& Vertices, TArray<FVector3f>& OutNormals, TArray<FVector3f>& OutTangents)
+{
+	OutNormals.SetNumUninitialized(Vertices.Num());
+	OutTangents.SetNumUninitialized(Vertices.Num());
+
+	if (Vertices.Num() != NumX * NumY || NumX < 2 || NumY < 2)
+	{
+		return;
+	}
+
+	for (int32 Y = 0; Y < NumY; Y++)
+	{
+		const int32 Up = FMath::Max(Y - 1, 0) * NumX;
+		const int32 Down = FMath::Min(Y + 1, NumY - 1) * NumX;
+
+		for (int32 X = 0; X < NumX; X++)
+		{
+			const int32 Left = FMath::Max(X - 1, 0);
+			const int32 Right = FMath::Min(X + 1, NumX - 1);
+
+			//Grid x runs along U, rows along V, +Z of the flat grid is the front face
+			const FVector3f AlongU = Vertices[Y * NumX + Right] - Vertices[Y * NumX + Left];
+			const FVector3f AlongV = Vertices[Down + X] - Vertices[Up + X];
+
+			const int32 Index = Y * NumX + X;
+			OutNormals[Index] = FVector3f::CrossProduct(AlongU, AlongV).GetSafeNormal(SMALL_NUMBER, FVector3f::UpVector);
+			OutTangents[Index] = AlongU.GetSafeNormal(SMALL_NUMBER, FVector3f::ForwardVector);
 		}
 	}
 }
 
+void FCubicSphere::CreateQuadGridMeshWelded(int32 NumX, int32 NumY, TArray<int32>& Triangles, TArray<FVector3f>& Vertices, TArray<FVector2f>& UVs, float GridSpacing)
+{
+	//Indices and UVs are shared per resolution, only positions depend on spacing
+	FCanonicalGridMeshRef Grid = FCanonicalGridMeshCache::Get().FindOrCreate(NumX, NumY);
+
+	Triangles = Grid->Triangles;
+	UVs = Grid->UVs;
+
+	Vertices.SetNumUninitialized(Grid->Vertices.Num());
+	for (int32 i = 0; i < Grid->Vertices.Num(); i++)
+	{
+		Vertices[i] = Grid->Vertices[i] * GridSpacing;
+	}
+}
@@ -4,6 +4,115 @@
 #include "InstancedStruct.h"
 #include "SIOJConvert.h"
 #include "EntitySpawningManagerActor.h"
+#include "Async/Async.h"
+#include "Misc/FileHelper.h"
+#include "Algo/BinarySearch.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+    const TCHAR* JournalSuffix = TEXT(".journal");
+
+    //Journal that is being folded into a checkpoint, kept until the new checkpoint is safely on disk
+    const TCHAR* CompactingJournalSuffix = TEXT(".journal.old");
+
+    void SerializeTrackStruct(UScriptStruct* Struct, void* StructPtr, bool bIsBinaryType, TArray<uint8>& OutBytes)
+    {
+        if (bIsBinaryType)
+        {
+            UCUBlueprintLibrary::SerializeStruct(Struct, StructPtr, OutBytes);
+        }
+        else
+        {
+            USIOJConvert::StructToBytes(Struct, StructPtr, OutBytes);
+        }
+    }
+
+    void DeserializeTrackStruct(UScriptStruct* Struct, void* StructPtr, bool bIsBinaryType, TArray<uint8>& Bytes)
+    {
+        if (bIsBinaryType)
+        {
+            UCUBlueprintLibrary::DeserializeStruct(Struct, StructPtr, Bytes);
+        }
+        else
+        {
+            USIOJConvert::BytesToStruct(Bytes, Struct, StructPtr);
+        }
+    }
+
+    //Emitted by parallel plan jobs, applied on the game thread
+    struct FPlanActionCommand
+    {
+        enum ECommandFlags : uint8
+        {
+            None = 0,
+            SetTarget = 1 << 0,
+            SetAnimCustom = 1 << 1,
+            NotifyScript = 1 << 2,
+            //Plan state was stepped, needs journaling
+            PlanChanged = 1 << 3,
+        };
+
+        uint8 Flags = None;
+        FVector Target = FVector::ZeroVector;
+        float Speed = -1.f;
+        float AnimCustom = 0.f;
+    };
+
+    //Journal layout is a sequence of [int32 size][serialized FEntityMapTrackDelta], returns number of deltas applied
+    int32 ReplayJournal(const FString& JournalPath, bool bIsBinaryType, FEntityMapTrackData& TrackData)
+    {
+        TArray<uint8> Bytes;
+        if (!FFileHelper::LoadFileToArray(Bytes, *JournalPath, FILEREAD_Silent))
+        {
+            return 0;
+        }
+
+        int32 DeltaCount = 0;
+        int32 Offset = 0;
+        while (Offset + (int32)sizeof(int32) <= Bytes.Num())
+        {
+            int32 DeltaSize = 0;
+            FMemory::Memcpy(&DeltaSize, Bytes.GetData() + Offset, sizeof(int32));
+            Offset += sizeof(int32);
+
+            if (DeltaSize < 0 || Offset + DeltaSize > Bytes.Num())
+            {
+                //torn append (e.g. crash mid save), everything before it is still valid
+                UE_LOG(LogTemp, Warning, TEXT("ReplayJournal: truncated entry in %s, ignoring tail."), *JournalPath);
+                break;
+            }
+
+            TArray<uint8> DeltaBytes(Bytes.GetData() + Offset, DeltaSize);
+            Offset += DeltaSize;
+
+            FEntityMapTrackDelta Delta;
+            DeserializeTrackStruct(FEntityMapTrackDelta::StaticStruct(), &Delta, bIsBinaryType, DeltaBytes);
+
+            if (Delta.bClearedAll)
+            {
+                TrackData.PlanMap.Empty();
+                TrackData.Positions.Reset();
+            }
+            for (int32 EntityId : Delta.RemovedIds)
+            {
+                TrackData.PlanMap.Remove(EntityId);
+                TrackData.Positions.RemoveEntity(EntityId);
+            }
+            for (TPair<int32, FEntityPlan>& Pair : Delta.PlanMap)
+            {
+                TrackData.PlanMap.Add(Pair.Key, MoveTemp(Pair.Value));
+            }
+            const FEntityPositionSnapshot& Changed = Delta.ChangedPositions;
+            for (int32 i = 0; i < Changed.EntityIds.Num() && i < Changed.Transforms.Num(); i++)
+            {
+                TrackData.Positions.SetTransform(Changed.EntityIds[i], Changed.Transforms[i]);
+            }
+            DeltaCount++;
+        }
+        return DeltaCount;
+    }
+}
 
 //Plan handler
 UEntityPlanTrack::UEntityPlanTrack()
@@ -16,6 +125,7 @@ UEntityPlanTrack::UEntityPlanTrack()
 void UEntityPlanTrack::SetPlanForEntity(const FEntityPlan& Plan, int32 EntityId)
 {
     TrackData.PlanMap.Add(EntityId, Plan);
+    MarkEntityDirty(EntityId);
 }
 
 FEntityPlan& UEntityPlanTrack::PlanForEntity(int32 EntityId)
@@ -27,6 +137,9 @@ FEntityPlan& UEntityPlanTrack::PlanForEntity(int32 EntityId)
         TrackData.PlanMap.Add(EntityId, Plan);
     }
 
+    //Caller gets a mutable reference, assume it changes
+    MarkEntityDirty(EntityId);
+
     return TrackData.PlanMap[EntityId];
 }
 
@@ -88,7 +201,13 @@ FString UEntityPlanTrack::CurrentActionTypeForEntity(int32 EntityId)
 
 void UEntityPlanTrack::ClearPlanForEntity(int32 EntityId)
 {
-    TrackData.PlanMap.Remove(EntityId);
+    if (TrackData.PlanMap.Remove(EntityId) > 0)
+    {
+        TrackData.Positions.RemoveEntity(EntityId);
+        DirtyEntities.Remove(EntityId);
+        DirtyPositionIds.Remove(EntityId);
+        RemovedEntities.Add(EntityId);
+    }
 }
 
 FString UEntityPlanTrack::PlanDescriptionForEntity(int32 EntityId)
@@ -111,6 +230,12 @@ void UEntityPlanTrack::ClearPlanForAllEntities()
 {
     //Fully empty the map
     TrackData.PlanMap.Empty();
+    TrackData.Positions.Reset();
+
+    DirtyEntities.Empty();
+    RemovedEntities.Empty();
+    DirtyPositionIds.Empty();
+    bClearedSinceLastSave = true;
 }
 
 UPlanProcessor* UEntityPlanTrack::GetProcessorForEntity(int32 EntityId)
@@ -131,6 +256,15 @@ void UEntityPlanTrack::SetDefaultProcessor(UPlanProcessor* Processor)
 }
 
 void UEntityPlanTrack::SaveTrackToFile(const FString& FileName, bool bIsFullPath)
+{
+    FString FullPath;
+    bool bIsBinaryType;
+    ResolveTrackPath(FileName, bIsFullPath, FullPath, bIsBinaryType);
+
+    WriteCheckpoint(FullPath, bIsBinaryType);
+}
+
+void UEntityPlanTrack::LoadTrackFromFile(const FString& FileName, bool bIsFullPath)
 {
     UCUFileSubsystem* CUSystem = GEngine->GetEngineSubsystem<UCUFileSubsystem>();
     if (!CUSystem)
@@ -138,108 +272,324 @@ void UEntityPlanTrack::SaveTrackToFile(const FString& FileName, bool bIsFullPath
         return;
     }
 
-    FString FullPath = FileName;
-    bool bIsBinaryType = FileName.EndsWith(TEXT(".bin"));
-    if (!bIsFullPath)
+    FString FullPath;
+    bool bIsBinaryType;
+    ResolveTrackPath(FileName, bIsFullPath, FullPath, bIsBinaryType);
+
+    WaitForCompaction();
+
+    //Read file bytes
+    TArray<uint8> Bytes;
+    CUSystem->ReadBytesFromPath(FullPath, Bytes);
+
+    DeserializeTrackStruct(FEntityMapTrackData::StaticStruct(), &TrackData, bIsBinaryType, Bytes);
+    TrackData.MigrateLegacyPositions();
+
+    //Loaded data isn't a journal base until it's saved again
+    ResetJournalState();
+}
+
+void UEntityPlanTrack::SaveTrackJournaled(const FString& FileName, bool bIsFullPath)
+{
+    FString FullPath;
+    bool bIsBinaryType;
+    ResolveTrackPath(FileName, bIsFullPath, FullPath, bIsBinaryType);
+
+    //No checkpoint for this path yet, start one
+    if (JournalCheckpointPath != FullPath || !FPaths::FileExists(FullPath))
     {
-        FullPath = CacheSettings.FullPath(FileName);
-        bIsBinaryType = CacheSettings.IsBinaryFileType();
+        WriteCheckpoint(FullPath, bIsBinaryType);
+        return;
     }
 
-    //Serialize into bytes
-    TArray<uint8> Bytes;
+    if (DirtyEntities.Num() == 0 && RemovedEntities.Num() == 0 && DirtyPositionIds.Num() == 0 && !bClearedSinceLastSave)
+    {
+        return;
+    }
+
+    FEntityMapTrackDelta Delta;
+    Delta.bClearedAll = bClearedSinceLastSave;
+    Delta.RemovedIds = RemovedEntities.Array();
+    Delta.PlanMap.Reserve(DirtyEntities.Num());
 
-    if (bIsBinaryType)
+    for (int32 EntityId : DirtyEntities)
     {
-        UCUBlueprintLibrary::SerializeStruct(FEntityMapTrackData::StaticStruct(), &TrackData, Bytes);
+        if (const FEntityPlan* Plan = TrackData.PlanMap.Find(EntityId))
+        {
+            Delta.PlanMap.Add(EntityId, *Plan);
+        }
     }
-    else
+
+    TArray<int32> MovedIds = DirtyPositionIds.Array();
+    MovedIds.Sort();
+    const FEntityPositionSnapshot& Positions = TrackData.Positions;
+    for (int32 EntityId : MovedIds)
     {
-        USIOJConvert::StructToBytes(FEntityMapTrackData::StaticStruct(), &TrackData, Bytes);
+        const int32 Index = Algo::BinarySearch(Positions.EntityIds, EntityId);
+        if (Index != INDEX_NONE)
+        {
+            Delta.ChangedPositions.EntityIds.Add(EntityId);
+            Delta.ChangedPositions.Transforms.Add(Positions.Transforms[Index]);
+        }
     }
 
-    //Save bytes to file
-    CUSystem->SaveBytesToPath(Bytes, FullPath, false);
+    TArray<uint8> DeltaBytes;
+    SerializeTrackStruct(FEntityMapTrackDelta::StaticStruct(), &Delta, bIsBinaryType, DeltaBytes);
+
+    //Size prefix lets replay skip a torn tail
+    TArray<uint8> Entry;
+    const int32 DeltaSize = DeltaBytes.Num();
+    Entry.SetNumUninitialized(sizeof(int32));
+    FMemory::Memcpy(Entry.GetData(), &DeltaSize, sizeof(int32));
+    Entry.Append(DeltaBytes);
+
+    if (!FFileHelper::SaveArrayToFile(Entry, *(FullPath + JournalSuffix), &IFileManager::Get(), FILEWRITE_Append))
+    {
+        //Keep dirty state so the next save retries
+        UE_LOG(LogTemp, Warning, TEXT("UEntityPlanTrack::SaveTrackJournaled failed to append to journal for %s"), *FullPath);
+        return;
+    }
+
+    DirtyEntities.Empty();
+    RemovedEntities.Empty();
+    DirtyPositionIds.Empty();
+    bClearedSinceLastSave = false;
+    JournalDeltaCount++;
+
+    if (JournalCompactionThreshold > 0 && JournalDeltaCount >= JournalCompactionThreshold)
+    {
+        CompactJournalAtPath(FullPath, bIsBinaryType);
+    }
 }
 
-void UEntityPlanTrack::LoadTrackFromFile(const FString& FileName, bool bIsFullPath)
+void UEntityPlanTrack::LoadTrackJournaled(const FString& FileName, bool bIsFullPath)
 {
-    UCUFileSubsystem* CUSystem = GEngine->GetEngineSubsystem<UCUFileSubsystem>();
-    if (!CUSystem)
+    FString FullPath;
+    bool bIsBinaryType;
+    ResolveTrackPath(FileName, bIsFullPath, FullPath, bIsBinaryType);
+
+    WaitForCompaction();
+
+    TrackData.PlanMap.Empty();
+
+    TArray<uint8> Bytes;
+    if (FFileHelper::LoadFileToArray(Bytes, *FullPath, FILEREAD_Silent))
     {
+        DeserializeTrackStruct(FEntityMapTrackData::StaticStruct(), &TrackData, bIsBinaryType, Bytes);
+    }
+
+    //A leftover compacting journal means a compaction didn't finish, its entries are still needed
+    int32 ReplayedCount = ReplayJournal(FullPath + CompactingJournalSuffix, bIsBinaryType, TrackData);
+    ReplayedCount += ReplayJournal(FullPath + JournalSuffix, bIsBinaryType, TrackData);
+    TrackData.MigrateLegacyPositions();
+
+    ResetJournalState();
+    JournalCheckpointPath = FullPath;
+    JournalDeltaCount = ReplayedCount;
+}
+
+void UEntityPlanTrack::CompactTrackJournal(const FString& FileName, bool bIsFullPath)
+{
+    FString FullPath;
+    bool bIsBinaryType;
+    ResolveTrackPath(FileName, bIsFullPath, FullPath, bIsBinaryType);
+
+    if (JournalCheckpointPath != FullPath)
+    {
+        //Nothing journaled against this path, a plain checkpoint is equivalent
+        WriteCheckpoint(FullPath, bIsBinaryType);
         return;
     }
 
-    FString FullPath = FileName;
-    bool bIsBinaryType = FileName.EndsWith(TEXT(".bin"));
+    CompactJournalAtPath(FullPath, bIsBinaryType);
+}
+
+bool UEntityPlanTrack::IsCompactingJournal() const
+{
+    return bIsCompactingJournal;
+}
+
+void UEntityPlanTrack::BeginDestroy()
+{
+    //Compaction worker references this track
+    WaitForCompaction();
+
+    Super::BeginDestroy();
+}
+
+void UEntityPlanTrack::ResolveTrackPath(const FString& FileName, bool bIsFullPath, FString& OutFullPath, bool& bOutIsBinaryType)
+{
+    OutFullPath = FileName;
+    bOutIsBinaryType = FileName.EndsWith(TEXT(".bin"));
     if (!bIsFullPath)
     {
-        FullPath = CacheSettings.FullPath(FileName);
-        bIsBinaryType = CacheSettings.IsBinaryFileType();
+        OutFullPath = CacheSettings.FullPath(FileName);
+        bOutIsBinaryType = CacheSettings.IsBinaryFileType();
     }
+}
 
-    //Read file bytes
+void UEntityPlanTrack::WriteCheckpoint(const FString& FullPath, bool bIsBinaryType)
+{
+    UCUFileSubsystem* CUSystem = GEngine->GetEngineSubsystem<UCUFileSubsystem>();
+    if (!CUSystem)
+    {
+        return;
+    }
+
+    //Don't race an in-flight compaction writing the same checkpoint
+    WaitForCompaction();
+
+    //Serialize into bytes
     TArray<uint8> Bytes;
-    CUSystem->ReadBytesFromPath(FullPath, Bytes);
+    SerializeTrackStruct(FEntityMapTrackData::StaticStruct(), &TrackData, bIsBinaryType, Bytes);
+
+    //Save bytes to file
+    CUSystem->SaveBytesToPath(Bytes, FullPath, false);
+
+    //Full checkpoint supersedes any journal
+    IFileManager::Get().Delete(*(FullPath + JournalSuffix), false, false, true);
+    IFileManager::Get().Delete(*(FullPath + CompactingJournalSuffix), false, false, true);
+
+    ResetJournalState();
+    JournalCheckpointPath = FullPath;
+}
+
+void UEntityPlanTrack::MarkEntityDirty(int32 EntityId)
+{
+    DirtyEntities.Add(EntityId);
+    RemovedEntities.Remove(EntityId);
+}
+
+void UEntityPlanTrack::ResetJournalState()
+{
+    DirtyEntities.Empty();
+    RemovedEntities.Empty();
+    DirtyPositionIds.Empty();
+    bClearedSinceLastSave = false;
+    JournalCheckpointPath.Empty();
+    JournalDeltaCount = 0;
+}
 
-    if (bIsBinaryType)
+void UEntityPlanTrack::CompactJournalAtPath(const FString& FullPath, bool bIsBinaryType)
+{
+    if (bIsCompactingJournal)
     {
+        return;
+    }
+    bIsCompactingJournal = true;
+    JournalDeltaCount = 0;
+
+    IFileManager& FileManager = IFileManager::Get();
+    const FString JournalPath = FullPath + JournalSuffix;
+    const FString CompactingPath = FullPath + CompactingJournalSuffix;
 
-        UCUBlueprintLibrary::DeserializeStruct(FEntityMapTrackData::StaticStruct(), &TrackData, Bytes);
+    //Rotate the journal so saves during compaction append to a fresh one
+    if (FileManager.FileExists(*CompactingPath))
+    {
+        //previous compaction failed, fold current journal into the pending one
+        TArray<uint8> JournalBytes;
+        if (FFileHelper::LoadFileToArray(JournalBytes, *JournalPath, FILEREAD_Silent))
+        {
+            FFileHelper::SaveArrayToFile(JournalBytes, *CompactingPath, &FileManager, FILEWRITE_Append);
+            FileManager.Delete(*JournalPath, false, false, true);
+        }
     }
-    else
+    else if (FileManager.FileExists(*JournalPath))
     {
-        USIOJConvert::BytesToStruct(Bytes, FEntityMapTrackData::StaticStruct(), &TrackData);
+        FileManager.Move(*CompactingPath, *JournalPath, true, true);
+    }
+
+    //Snapshot covers everything journaled so far, pending dirty entities stay dirty for the next append
+    TSharedPtr<FEntityMapTrackData> Snapshot = MakeShared<FEntityMapTrackData>(TrackData);
+
+    CompactionTask = Async(EAsyncExecution::ThreadPool, [this, Snapshot, FullPath, CompactingPath, bIsBinaryType]
+    {
+        TArray<uint8> Bytes;
+        SerializeTrackStruct(FEntityMapTrackData::StaticStruct(), Snapshot.Get(), bIsBinaryType, Bytes);
+
+        //Write aside and swap so a crash never leaves a half written checkpoint
+        const FString TempPath = FullPath + TEXT(".tmp");
+        const bool bSaved = FFileHelper::SaveArrayToFile(Bytes, *TempPath) &&
+            IFileManager::Get().Move(*FullPath, *TempPath, true, true);
+
+        if (bSaved)
+        {
+            IFileManager::Get().Delete(*CompactingPath, false, false, true);
+        }
+        else
+        {
+            UE_LOG(LogTemp, Warning, TEXT("UEntityPlanTrack::CompactTrackJournal failed to write %s, journal kept for replay."), *FullPath);
+        }
+
+        bIsCompactingJournal = false;
+    });
+}
+
+void UEntityPlanTrack::WaitForCompaction()
+{
+    if (CompactionTask.IsValid())
+    {
+        CompactionTask.Wait();
+        CompactionTask.Reset();
     }
 }
 
 void UEntityPlanTrack::CacheCurrentEntityPositions(UStaticMesh* ForKey)
 {
     //Cache our current position is we have a valid esm link
-    if (Esm.IsValid())
+    if (!Esm.IsValid())
     {
-        TArray<int32> Keys;
-        TrackData.PlanMap.GetKeys(Keys);
+        return;
+    }
 
-        //For each entity plan in this track
-        for (int32 Key : Keys)
-        {
-            //Caching for key must be generalized
-            //TrackData.PlanMap[Key].MeshKey = ForKey;
+    FEntityPositionSnapshot& Positions = TrackData.Positions;
 
-            //Meshkey might be null so this might fail if not set
-            UInstancedStaticMeshComponent* ISMComponent = Esm->DynamicInstanceComponentForMesh(ForKey);
+    TArray<int32> EntityIds;
+    TrackData.PlanMap.GetKeys(EntityIds);
+    EntityIds.Sort();
 
-            if (ISMComponent)
-            {
-                FTransform CurrentTransform;
-                ISMComponent->GetInstanceTransform(Key, CurrentTransform);
+    //No instances to read, the snapshot we have is still the best we know
+    TArray<FTransform> Transforms;
+    if (!Esm->GetISMTransformsForIndices(ForKey, EntityIds, Transforms))
+    {
+        return;
+    }
 
-                TrackData.PlanMap[Key].LastTransform = CurrentTransform;
+    //Only moved entities need to go into the next journal entry
+    if (EntityIds == Positions.EntityIds)
+    {
+        for (int32 i = 0; i < EntityIds.Num(); i++)
+        {
+            if (!Positions.Transforms[i].Equals(Transforms[i]))
+            {
+                DirtyPositionIds.Add(EntityIds[i]);
             }
         }
     }
+    else
+    {
+        DirtyPositionIds.Append(EntityIds);
+    }
+
+    Positions.EntityIds = MoveTemp(EntityIds);
+    Positions.Transforms = MoveTemp(Transforms);
 }
 
 void UEntityPlanTrack::LoadCurrentEntityPositions(UStaticMesh* ForKey)
 {
-
     //Get owning esm
-    if (Esm.IsValid())
+    if (!Esm.IsValid())
     {
-        TArray<int32> Keys;
-        TrackData.PlanMap.GetKeys(Keys);
-
-        for (int32 Key : Keys)
-        {
-            //Grab last transform
-            const FTransform& NewTransform = TrackData.PlanMap[Key].LastTransform;
-
-            //feed the positions back into the keyed esm instances
-            Esm->SetISMTransformForIndex(ForKey, NewTransform, Key);
-        }
+        return;
+    }
 
-    }    
+    //Older saves were migrated into the snapshot on load
+    const FEntityPositionSnapshot& Positions = TrackData.Positions;
+    if (Positions.EntityIds.Num() > 0)
+    {
+        //feed the positions back into the keyed esm instances
+        Esm->SetISMTransformsForIndices(ForKey, Positions.EntityIds, Positions.Transforms);
+    }
 }
 
 void UEntityPlanTrack::SetESMLink(AEntitySpawningManagerActor* Manager)
@@ -247,6 +597,11 @@ void UEntityPlanTrack::SetESMLink(AEntitySpawningManagerActor* Manager)
     Esm = Manager;
 }
 
+AEntitySpawningManagerActor* UEntityPlanTrack::GetESMLink() const
+{
+    return Esm.Get();
+}
+
 
 //planning system
 UEntityPlanningSystem::UEntityPlanningSystem()
@@ -347,6 +702,157 @@ void UPlanProcessor::ProcessNextActionForEntity(int32 EntityId)
     }
 }
 
+void UPlanProcessor::ProcessPendingEntitiesParallel(const TArray<int32>& IdsNeedingProcessing)
+{
+    if (!Track || IdsNeedingProcessing.Num() == 0)
+    {
+        return;
+    }
+
+    //Each plan may only be touched by one job, drop duplicates keeping first occurrence order.
+    //Missing plans are created in the same pass, reserving up front keeps earlier plan pointers stable.
+    //Plans aren't marked dirty here, only entities the jobs actually changed are marked below
+    TMap<int32, FEntityPlan>& PlanMap = Track->TrackData.PlanMap;
+    PlanMap.Reserve(PlanMap.Num() + IdsNeedingProcessing.Num());
+
+    TArray<int32> Ids;
+    TArray<FEntityPlan*> Plans;
+    Ids.Reserve(IdsNeedingProcessing.Num());
+    Plans.Reserve(IdsNeedingProcessing.Num());
+    {
+        TSet<int32> SeenIds;
+        SeenIds.Reserve(IdsNeedingProcessing.Num());
+        for (int32 EntityId : IdsNeedingProcessing)
+        {
+            bool bAlreadySeen = false;
+            SeenIds.Add(EntityId, &bAlreadySeen);
+            if (!bAlreadySeen)
+            {
+                Ids.Add(EntityId);
+                Plans.Add(&PlanMap.FindOrAdd(EntityId));
+            }
+        }
+    }
+    const int32 Num = Ids.Num();
+
+    AEntitySpawningManagerActor* Esm = NativeActionMesh ? Track->GetESMLink() : nullptr;
+    const bool bApplyNatively = Esm != nullptr;
+    const bool bAutoComplete = bAutoCompleteActions;
+    const bool bNotifyNative = bNotifyScriptForNativeActions;
+    const bool bApplyAnimCustom = NativeAnimCustomDataIndex >= 0;
+
+    //One slot per entity, each job only writes its own range
+    TArray<FPlanActionCommand> Commands;
+    Commands.SetNumUninitialized(Num);
+
+    const int32 BatchSize = FMath::Max(1, ParallelBatchSize);
+    const int32 NumBatches = FMath::DivideAndRoundUp(Num, BatchSize);
+
+    ParallelFor(NumBatches, [&](int32 BatchIndex)
+    {
+        const int32 Start = BatchIndex * BatchSize;
+        const int32 End = FMath::Min(Start + BatchSize, Num);
+
+        for (int32 i = Start; i < End; i++)
+        {
+            FEntityPlan& Plan = *Plans[i];
+            FPlanActionCommand& Command = Commands[i];
+            Command = FPlanActionCommand();
+
+            const int32 PrevActionIndex = Plan.ActionIndex;
+            const bool bWasActive = Plan.bIsActive;
+            const bool bWasProcessing = Plan.bActionIsBeingProcessed;
+            const bool bHadCompleted = Plan.bDidComplete;
+
+            if (bAutoComplete)
+            {
+                Plan.bActionIsBeingProcessed = false;
+            }
+
+            if (!UEntityPlanConstructor::IncrementActionIndex(Plan))
+            {
+                if (Plan.ActionIndex != PrevActionIndex || Plan.bIsActive != bWasActive ||
+                    Plan.bActionIsBeingProcessed != bWasProcessing || Plan.bDidComplete != bHadCompleted)
+                {
+                    Command.Flags = FPlanActionCommand::PlanChanged;
+                }
+                continue;
+            }
+            Command.Flags = FPlanActionCommand::PlanChanged;
+            UEntityPlanConstructor::ActivatePlan(Plan);
+
+            if (!Plan.Actions.IsValidIndex(Plan.ActionIndex))
+            {
+                continue;
+            }
+
+            const FInstancedAction* InstancedAction = bApplyNatively ? Plan.Actions[Plan.ActionIndex].GetPtr<FInstancedAction>() : nullptr;
+            if (InstancedAction)
+            {
+                Command.Flags |= FPlanActionCommand::SetTarget;
+                Command.Target = InstancedAction->Target;
+                Command.Speed = InstancedAction->Speed;
+                Command.AnimCustom = InstancedAction->AnimCustom;
+
+                if (bApplyAnimCustom)
+                {
+                    Command.Flags |= FPlanActionCommand::SetAnimCustom;
+                }
+                if (bNotifyNative)
+                {
+                    Command.Flags |= FPlanActionCommand::NotifyScript;
+                }
+            }
+            else
+            {
+                Command.Flags |= FPlanActionCommand::NotifyScript;
+            }
+        }
+    });
+
+    //Apply in input order
+    TArray<int32> AnimIds;
+    TArray<float> AnimValues;
+
+    for (int32 i = 0; i < Num; i++)
+    {
+        const FPlanActionCommand& Command = Commands[i];
+        const int32 EntityId = Ids[i];
+
+        if (Command.Flags != FPlanActionCommand::None)
+        {
+            Track->MarkEntityDirty(EntityId);
+        }
+        if (Command.Flags & FPlanActionCommand::SetTarget)
+        {
+            Esm->SetISMMovementTargetDataForIndex(NativeActionMesh, Command.Target, EntityId, Command.Speed);
+        }
+        if (Command.Flags & FPlanActionCommand::SetAnimCustom)
+        {
+            AnimIds.Add(EntityId);
+            AnimValues.Add(Command.AnimCustom);
+        }
+        if (Command.Flags & FPlanActionCommand::NotifyScript)
+        {
+            //Re-resolve, script callbacks earlier in this loop may have changed the track
+            if (const FEntityPlan* Plan = PlanMap.Find(EntityId))
+            {
+                if (Plan->Actions.IsValidIndex(Plan->ActionIndex))
+                {
+                    //Copy, listeners may add plans and move the map
+                    const FInstancedStruct Action = Plan->Actions[Plan->ActionIndex];
+                    OnNextAction.Broadcast(Action, EntityId);
+                }
+            }
+        }
+    }
+
+    if (AnimIds.Num() > 0)
+    {
+        Esm->SetISMCustomDataValueForIndices(NativeActionMesh, AnimIds, AnimValues, NativeAnimCustomDataIndex);
+    }
+}
+
 void UPlanProcessor::ResumePlanForEntity(int32 EntityId)
 {
     FEntityPlan& Plan = Track->PlanForEntity(EntityId);
@@ -232,6 +232,30 @@ void AEntitySpawningManagerActor::SetISMCustomFloats(UStaticMesh* Mesh, const TA
     }
 }
 
+void AEntitySpawningManagerActor::SetISMCustomDataValueForIndices(UStaticMesh* Mesh, const TArray<int32>& Indices, const TArray<float>& Values, int32 CustomDataIndex /*= 0*/)
+{
+    UInstancedStaticMeshComponent* ISMComponent = DynamicInstanceComponentForMesh(Mesh);
+
+    if (!ISMComponent || Indices.Num() == 0)
+    {
+        return;
+    }
+
+    if (Indices.Num() != Values.Num() || CustomDataIndex < 0 || CustomDataIndex >= ISMComponent->NumCustomDataFloats)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("AEntitySpawningManagerActor::SetISMCustomDataValueForIndices invalid input (%d indices, %d values, custom index %d)."),
+            Indices.Num(), Values.Num(), CustomDataIndex);
+        return;
+    }
+
+    for (int32 i = 0; i < Indices.Num(); i++)
+    {
+        ISMComponent->SetCustomDataValueById({ Indices[i] }, CustomDataIndex, Values[i]);
+    }
+
+    ISMComponent->MarkRenderInstancesDirty();
+}
+
 void AEntitySpawningManagerActor::SetNearFieldActor(UStaticMesh* Mesh, UClass* NearFieldActorClass)
 {
     if (DynamicMapData.TargetData.Contains(Mesh))
@@ -515,10 +539,22 @@ void AEntitySpawningManagerActor::TravelDynamicISMTowardTargets(UStaticMesh* Mes
         NextTransforms.Add(InstanceTransform);
     }
 
-    // Optionally, get player location (only if we need near-field swaps).
+    // Simulation LOD: far instances are only stepped on their tick bucket.
+    const FESMSimulationLODSettings& SimulationLOD = Settings.SimulationLOD;
+    const bool bSimulationLOD = SimulationLOD.bEnableSimulationLOD && SimulationLOD.FarUpdateTickInterval > 1;
+    const float FullRateDistanceSquared = FMath::Square(SimulationLOD.FullRateDistance);
+    const double WorldTime = GetWorld()->GetTimeSeconds();
+    int32 LODTickBucket = 0;
+    if (bSimulationLOD)
+    {
+        LODTickBucket = ISMSpecializedData.SimulationFrameCounter % SimulationLOD.FarUpdateTickInterval;
+        ISMSpecializedData.SimulationFrameCounter++;
+    }
+
+    // Optionally, get player location (only if we need near-field swaps or distance LOD).
     FVector PlayerLocation;
     FTransform PlayerTransform;
-    if (bDoNearFieldSwapCalculations)
+    if (bDoNearFieldSwapCalculations || bSimulationLOD)
     {
         if (AActor* PlayerActor = GetDefaultPossessedActor())
         {
@@ -610,6 +646,7 @@ void AEntitySpawningManagerActor::TravelDynamicISMTowardTargets(UStaticMesh* Mes
                     // Sync both transforms to the actor�s last known position.
                     Transform = ActorFarfieldTransform;
                     PrevTransform = ActorFarfieldTransform;
+                    SpecializedData.LastSimulatedTime = -1.0;
 
                     TransformUpdateIds.Add(InstanceId);
                     bHasSwapUpdates = true;
@@ -667,6 +704,28 @@ void AEntitySpawningManagerActor::TravelDynamicISMTowardTargets(UStaticMesh* Mes
             continue;
         }
 
+        // Far instances skip ticks off their bucket and advance by the full elapsed time when stepped,
+        // so moving between bands never loses or gains travel distance.
+        float StepTime = DeltaTime;
+        if (bSimulationLOD)
+        {
+            if (SpecializedData.LastSimulatedTime < 0.0)
+            {
+                SpecializedData.LastSimulatedTime = WorldTime - DeltaTime;
+            }
+
+            if (!SpecializedData.bIsNearFieldSwapped)
+            {
+                const bool bIsFar = FVector::DistSquared(PlayerLocation, CurrentPosition) > FullRateDistanceSquared;
+                if (bIsFar && (i % SimulationLOD.FarUpdateTickInterval) != LODTickBucket)
+                {
+                    continue;
+                }
+                StepTime = (float)(WorldTime - SpecializedData.LastSimulatedTime);
+            }
+            SpecializedData.LastSimulatedTime = WorldTime;
+        }
+
         if (!SpecializedData.bIsNearFieldSwapped)
         {
             TransformUpdateIds.Add(InstanceId);
@@ -714,7 +773,7 @@ void AEntitySpawningManagerActor::TravelDynamicISMTowardTargets(UStaticMesh* Mes
         }
 
         // Move the instance toward the target.
-        const float MovementMagnitude = SpecializedData.Speed * DeltaTime;
+        const float MovementMagnitude = SpecializedData.Speed * StepTime;
         if (DistanceToTarget < MovementMagnitude)
         {
             Transform.SetTranslation(SpecializedData.Target);
@@ -753,6 +812,7 @@ void AEntitySpawningManagerActor::TravelDynamicISMTowardTargets(UStaticMesh* Mes
                     const FTransform ActorFarfieldTransform = SwapPool.ToIsmTransform(Actor->GetActorTransform());
                     SwapPool.ReleaseActor(Actor);
                     SpecializedData.bIsNearFieldSwapped = false;
+                    SpecializedData.LastSimulatedTime = -1.0;
 
                     NextTransforms[idx] = ActorFarfieldTransform;
                     PrevTransforms[idx] = ActorFarfieldTransform;
@@ -1660,6 +1720,7 @@ void AEntitySpawningManagerActor::SetISMMovementTargetDataForIndex(UStaticMesh*
     FInstanceSpecializedData& PerInstanceData = MeshTargetDataList.PerInstance[Index];
     PerInstanceData.Target = Target;
     PerInstanceData.bReachedTarget = false;
+    PerInstanceData.LastSimulatedTime = -1.0;   //idle time shouldn't count as travel
     MeshTargetDataList.ReachedTargetSet.Remove(Index);
     MeshTargetDataList.ReachedSetSinceLastCheck.Remove(Index);
 
@@ -1783,6 +1844,96 @@ FTransform AEntitySpawningManagerActor::GetISMTransformForIndex(UStaticMesh* Mes
     return Transform;
 }
 
+bool AEntitySpawningManagerActor::GetISMTransformsForIndices(UStaticMesh* Mesh, const TArray<int32>& Indices, TArray<FTransform>& OutTransforms)
+{
+    OutTransforms.Reset(Indices.Num());
+
+    UInstancedStaticMeshComponent* ISMComponent = DynamicInstanceComponentForMesh(Mesh);
+    if (!ISMComponent)
+    {
+        return false;
+    }
+
+    FISMSpecializedData* ISMSpecializedData = Settings.bSwapActorsNearFieldActors ? DynamicMapData.TargetData.Find(Mesh) : nullptr;
+    const TArray<FInstancedStaticMeshInstanceData>& InstanceData = ISMComponent->PerInstanceSMData;
+
+    for (int32 Index : Indices)
+    {
+        //Case: we're nearfield swapped, the actor holds the real position
+        if (ISMSpecializedData && ISMSpecializedData->PerInstance.IsValidIndex(Index))
+        {
+            const FInstanceSpecializedData& SpecializedData = ISMSpecializedData->PerInstance[Index];
+            if (SpecializedData.bIsNearFieldSwapped && SpecializedData.NearFieldActor)
+            {
+                OutTransforms.Add(ISMSpecializedData->NearFieldInfo.SwapPool.ToIsmTransform(SpecializedData.NearFieldActor->GetActorTransform()));
+                continue;
+            }
+        }
+
+        if (InstanceData.IsValidIndex(Index))
+        {
+            OutTransforms.Add(FTransform(InstanceData[Index].Transform));
+        }
+        else
+        {
+            OutTransforms.Add(FTransform::Identity);
+        }
+    }
+    return true;
+}
+
+void AEntitySpawningManagerActor::SetISMTransformsForIndices(UStaticMesh* Mesh, const TArray<int32>& Indices, const TArray<FTransform>& Transforms)
+{
+    UInstancedStaticMeshComponent* ISMComponent = DynamicInstanceComponentForMesh(Mesh);
+
+    if (!ISMComponent)
+    {
+        return;
+    }
+
+    if (Indices.Num() != Transforms.Num())
+    {
+        UE_LOG(LogTemp, Warning, TEXT("AEntitySpawningManagerActor::SetISMTransformsForIndices mismatched input sizes %d != %d"),
+            Indices.Num(), Transforms.Num());
+        return;
+    }
+
+    FISMSpecializedData* ISMSpecializedData = Settings.bSwapActorsNearFieldActors ? DynamicMapData.TargetData.Find(Mesh) : nullptr;
+
+    ISMComponent->Modify();
+    ISMComponent->SetHasPerInstancePrevTransforms(true);
+
+    for (int32 i = 0; i < Indices.Num(); i++)
+    {
+        const int32 Index = Indices[i];
+        const FTransform& Transform = Transforms[i];
+        FPrimitiveInstanceId InstanceId = { Index };
+
+        if (ISMComponent->GetInstanceIndexForId(InstanceId) == INDEX_NONE)
+        {
+            continue;
+        }
+
+        //Restores are teleports, no motion vectors
+        ISMComponent->SetPreviousTransformById(InstanceId, Transform, false);
+        ISMComponent->UpdateInstanceTransformById(InstanceId, Transform, false, false);
+
+        if (ISMSpecializedData && ISMSpecializedData->PerInstance.IsValidIndex(Index))
+        {
+            FInstanceSpecializedData& SpecializedData = ISMSpecializedData->PerInstance[Index];
+
+            if (SpecializedData.bIsNearFieldSwapped && SpecializedData.NearFieldActor &&
+                SpecializedData.NearFieldActor->Implements<UEntityGroupActionInterface>())
+            {
+                //Sync to desired group transform instruction
+                IEntityGroupActionInterface::Execute_OnGroupTransformUpdate(SpecializedData.NearFieldActor, Transform);
+            }
+        }
+    }
+
+    ISMComponent->MarkRenderInstancesDirty();
+}
+
 UInstancedStaticMeshComponent* AEntitySpawningManagerActor::StaticInstanceComponentForMesh(UStaticMesh* Mesh)
 {
     UInstancedStaticMeshComponent** PointerOrNull = StaticMapData.MeshComponentMap.Find(Mesh);
@@ -1,4 +1,5 @@
 #include "GUDataTypes.h"
+#include "Algo/BinarySearch.h"
 
 FString FEntityBaseAction::Description() const
 {
@@ -28,4 +29,66 @@ FString FPGCacheSettings::FullPath(const FString& InFileName)
 bool FPGCacheSettings::IsBinaryFileType()
 {
 	return FileType == TEXT(".bin");
-}
\ No newline at end of file
+}
+
+void FEntityPositionSnapshot::Reset()
+{
+	EntityIds.Reset();
+	Transforms.Reset();
+}
+
+void FEntityPositionSnapshot::SetTransform(int32 EntityId, const FTransform& Transform)
+{
+	const int32 Index = Algo::LowerBound(EntityIds, EntityId);
+	if (EntityIds.IsValidIndex(Index) && EntityIds[Index] == EntityId)
+	{
+		Transforms[Index] = Transform;
+	}
+	else
+	{
+		EntityIds.Insert(EntityId, Index);
+		Transforms.Insert(Transform, Index);
+	}
+}
+
+void FEntityPositionSnapshot::RemoveEntity(int32 EntityId)
+{
+	const int32 Index = Algo::BinarySearch(EntityIds, EntityId);
+	if (Index != INDEX_NONE)
+	{
+		EntityIds.RemoveAt(Index);
+		Transforms.RemoveAt(Index);
+	}
+}
+
+void FEntityMapTrackData::MigrateLegacyPositions()
+{
+	bool bHasLegacyTransforms = false;
+	for (const TPair<int32, FEntityPlan>& Pair : PlanMap)
+	{
+		if (!Pair.Value.LastTransform.Equals(FTransform::Identity))
+		{
+			bHasLegacyTransforms = true;
+			break;
+		}
+	}
+
+	//Newer saves never write LastTransform, identity there is just the default
+	if (!bHasLegacyTransforms)
+	{
+		return;
+	}
+
+	if (Positions.EntityIds.Num() == 0)
+	{
+		for (const TPair<int32, FEntityPlan>& Pair : PlanMap)
+		{
+			Positions.SetTransform(Pair.Key, Pair.Value.LastTransform);
+		}
+	}
+
+	for (TPair<int32, FEntityPlan>& Pair : PlanMap)
+	{
+		Pair.Value.LastTransform = FTransform::Identity;
+	}
+}
@@ -32,42 +32,238 @@ FVector FGnomonicParams::GnomonicProjection(const FVector& InVector, const FGnom
 	return Vertex;
 }
 
+namespace
+{
+	constexpr int32 PatchKeyCoordBits = 28;
+	constexpr uint64 PatchKeyCoordMask = (uint64(1) << PatchKeyCoordBits) - 1;
+
+	//Sign extend the 28 bit coordinate back to int32
+	int32 UnpackCoord(uint64 Bits)
+	{
+		const int32 Value = int32(Bits & PatchKeyCoordMask);
+		return (Value << (32 - PatchKeyCoordBits)) >> (32 - PatchKeyCoordBits);
+	}
+}
+
+FPatchKey::FPatchKey(int32 Face, int32 Depth, int32 X, int32 Y)
+{
+	Packed = (uint64(Face & 0x7) << 61) |
+		(uint64(Depth & 0x1F) << 56) |
+		((uint64(uint32(X)) & PatchKeyCoordMask) << PatchKeyCoordBits) |
+		(uint64(uint32(Y)) & PatchKeyCoordMask);
+}
+
+FPatchKey FPatchKey::FromIndex(const FPatch2DIndex& Index, int32 Face)
+{
+	return FPatchKey(Face, Index.Depth, FMath::FloorToInt(Index.X), FMath::FloorToInt(Index.Y));
+}
+
+int32 FPatchKey::GetFace() const
+{
+	return int32(Packed >> 61);
+}
+
+int32 FPatchKey::GetDepth() const
+{
+	return int32((Packed >> 56) & 0x1F);
+}
+
+int32 FPatchKey::GetX() const
+{
+	return UnpackCoord(Packed >> PatchKeyCoordBits);
+}
+
+int32 FPatchKey::GetY() const
+{
+	return UnpackCoord(Packed);
+}
+
+//FPatchHeightCache
+
+FPatchHeightCache::FPatchHeightCache(int64 InMemoryBudgetBytes)
+	: AccessClock(0)
+	, MemoryBudgetBytes(InMemoryBudgetBytes)
+	, MemoryUsedBytes(0)
+{
+}
+
+FPatchHeightData FPatchHeightCache::Add(const FPatchKey& Key, TArray<float>&& Heights)
+{
+	FPatchHeightData Data = MakeShared<const TArray<float>, ESPMode::ThreadSafe>(MoveTemp(Heights));
+	Add(Key, Data);
+	return Data;
+}
+
+void FPatchHeightCache::Add(const FPatchKey& Key, const FPatchHeightData& Heights)
+{
+	if (!Heights.IsValid())
+	{
+		return;
+	}
+
+	TUniquePtr<FEntry> Entry = MakeUnique<FEntry>();
+	Entry->Data = Heights;
+	Entry->Bytes = Heights->GetAllocatedSize();
+	Entry->LastAccess = ++AccessClock;
+
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+
+	if (TUniquePtr<FEntry>* Existing = Entries.Find(Key))
+	{
+		MemoryUsedBytes -= (*Existing)->Bytes;
+	}
+	MemoryUsedBytes += Entry->Bytes;
+	Entries.Add(Key, MoveTemp(Entry));
+
+	EvictToBudget();
+}
+
+FPatchHeightData FPatchHeightCache::Find(const FPatchKey& Key) const
+{
+	FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+
+	const TUniquePtr<FEntry>* Entry = Entries.Find(Key);
+	if (!Entry)
+	{
+		return nullptr;
+	}
+
+	(*Entry)->LastAccess.store(++AccessClock, std::memory_order_relaxed);
+	return (*Entry)->Data;
+}
+
+bool FPatchHeightCache::Contains(const FPatchKey& Key) const
+{
+	FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+	return Entries.Contains(Key);
+}
+
+void FPatchHeightCache::Remove(const FPatchKey& Key)
+{
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+
+	TUniquePtr<FEntry> Entry;
+	if (Entries.RemoveAndCopyValue(Key, Entry))
+	{
+		MemoryUsedBytes -= Entry->Bytes;
+	}
+}
+
+void FPatchHeightCache::Empty()
+{
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+	Entries.Empty();
+	MemoryUsedBytes = 0;
+}
+
+void FPatchHeightCache::SetMemoryBudget(int64 InMemoryBudgetBytes)
+{
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+	MemoryBudgetBytes = InMemoryBudgetBytes;
+	EvictToBudget();
+}
+
+int64 FPatchHeightCache::GetMemoryUsed() const
+{
+	FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+	return MemoryUsedBytes;
+}
+
+int32 FPatchHeightCache::Num() const
+{
+	FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+	return Entries.Num();
+}
+
+void FPatchHeightCache::EvictToBudget()
+{
+	if (MemoryUsedBytes <= MemoryBudgetBytes)
+	{
+		return;
+	}
+
+	TArray<TPair<uint64, FPatchKey>> ByAccess;
+	ByAccess.Reserve(Entries.Num());
+	for (const TPair<FPatchKey, TUniquePtr<FEntry>>& Pair : Entries)
+	{
+		ByAccess.Emplace(Pair.Value->LastAccess.load(std::memory_order_relaxed), Pair.Key);
+	}
+	ByAccess.Sort([](const TPair<uint64, FPatchKey>& A, const TPair<uint64, FPatchKey>& B)
+	{
+		return A.Key < B.Key;
+	});
+
+	//Oldest first, outstanding readers keep their data alive through the shared pointer
+	for (const TPair<uint64, FPatchKey>& Access : ByAccess)
+	{
+		if (MemoryUsedBytes <= MemoryBudgetBytes)
+		{
+			break;
+		}
+		TUniquePtr<FEntry> Entry;
+		Entries.RemoveAndCopyValue(Access.Value, Entry);
+		MemoryUsedBytes -= Entry->Bytes;
+	}
+}
+
+//FGridSurfaceCache
+
 void FGridSurfaceCache::AddResult(const FPatch2DArray& Result)
 {
-	AddResult(Result.Index.ToString(), Result);
+	TArray<float> Heights = Result.Data;
+	Cache.Add(FPatchKey::FromIndex(Result.Index), MoveTemp(Heights));
 }
 
 void FGridSurfaceCache::AddResult(const FString& IndexString, const FPatch2DArray& Result)
 {
-	Cache.Add(IndexString, Result);
+	FPatch2DArray Keyed = Result;
+	Keyed.Index.SetFromString(IndexString);
+	AddResult(Keyed);
 }
 
 void FGridSurfaceCache::RemoveResult(const FPatch2DIndex& Index)
 {
-	RemoveResult(Index.ToString());
+	Cache.Remove(FPatchKey::FromIndex(Index));
 }
 
 void FGridSurfaceCache::RemoveResult(const FString& IndexString)
 {
-	Cache.Remove(IndexString);
+	FPatch2DIndex Index;
+	Index.SetFromString(IndexString);
+	RemoveResult(Index);
 }
 
 bool FGridSurfaceCache::ResultForIndex(const FString& Index, FPatch2DArray& OutResult)
 {
-	if (Cache.Contains(Index))
-	{
-		OutResult = Cache[Index];
-		return true;
-	}
-	else
+	FPatch2DIndex PatchIndex;
+	PatchIndex.SetFromString(Index);
+
+	FPatchHeightData Heights = HeightsForIndex(PatchIndex);
+	if (!Heights.IsValid())
 	{
 		return false;
 	}
+
+	OutResult.Index = PatchIndex;
+	OutResult.Data = *Heights;
+	return true;
 }
 
 bool FGridSurfaceCache::ContainsResult(const FString& Index)
 {
-	return Cache.Contains(Index);
+	FPatch2DIndex PatchIndex;
+	PatchIndex.SetFromString(Index);
+	return ContainsResult(PatchIndex);
+}
+
+FPatchHeightData FGridSurfaceCache::HeightsForIndex(const FPatch2DIndex& Index) const
+{
+	return Cache.Find(FPatchKey::FromIndex(Index));
+}
+
+bool FGridSurfaceCache::ContainsResult(const FPatch2DIndex& Index) const
+{
+	return Cache.Contains(FPatchKey::FromIndex(Index));
 }
 
 
@@ -85,6 +281,205 @@ FGridSurfaceCache::~FGridSurfaceCache()
 
 }
 
+FCanonicalGridMeshCache& FCanonicalGridMeshCache::Get()
+{
+	static FCanonicalGridMeshCache Cache;
+	return Cache;
+}
+
+FCanonicalGridMeshRef FCanonicalGridMeshCache::FindOrCreate(int32 NumX, int32 NumY)
+{
+	const FIntPoint Key(NumX, NumY);
+	{
+		FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+		if (const FCanonicalGridMeshRef* Found = Grids.Find(Key))
+		{
+			return *Found;
+		}
+	}
+
+	//Built outside the lock, if two threads race the first one in wins
+	TSharedPtr<FCanonicalGridMesh, ESPMode::ThreadSafe> Grid = MakeShared<FCanonicalGridMesh, ESPMode::ThreadSafe>();
+	Grid->NumX = NumX;
+	Grid->NumY = NumY;
+
+	if (NumX >= 2 && NumY >= 2)
+	{
+		const FVector2f Extent = FVector2f(NumX - 1, NumY - 1) / 2;
+
+		Grid->Vertices.Reserve(NumX * NumY);
+		Grid->UVs.Reserve(NumX * NumY);
+		for (int32 i = 0; i < NumY; i++)
+		{
+			for (int32 j = 0; j < NumX; j++)
+			{
+				Grid->Vertices.Add(FVector3f((float)j - Extent.X, (float)i - Extent.Y, 0));
+				Grid->UVs.Add(FVector2f((float)j / ((float)NumX - 1), (float)i / ((float)NumY - 1)));
+			}
+		}
+
+		Grid->Triangles.Reserve((NumX - 1) * (NumY - 1) * 6);
+		for (int32 i = 0; i < NumY - 1; i++)
+		{
+			for (int32 j = 0; j < NumX - 1; j++)
+			{
+				const int32 Idx = j + (i * NumX);
+				Grid->Triangles.Add(Idx);
+				Grid->Triangles.Add(Idx + NumX);
+				Grid->Triangles.Add(Idx + 1);
+
+				Grid->Triangles.Add(Idx + 1);
+				Grid->Triangles.Add(Idx + NumX);
+				Grid->Triangles.Add(Idx + NumX + 1);
+			}
+		}
+	}
+
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+	if (const FCanonicalGridMeshRef* Found = Grids.Find(Key))
+	{
+		return *Found;
+	}
+	return Grids.Add(Key, Grid);
+}
+
+void FCanonicalGridMeshCache::Empty()
+{
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+	Grids.Empty();
+}
+
+namespace
+{
+	//Triangles of a square grid where Mask edges only use every other vertex, see FStitchedGridIndexCache
+	void BuildStitchedGridIndices(int32 Num, uint8 Mask, TArray<int32>& OutTriangles)
+	{
+		auto AddTriangle = [Num, &OutTriangles](FIntPoint A, FIntPoint B, FIntPoint C)
+		{
+			//Keep the canonical grid winding, which is negative area in grid space
+			const int32 Cross = (B.X - A.X) * (C.Y - A.Y) - (B.Y - A.Y) * (C.X - A.X);
+			if (Cross > 0)
+			{
+				Swap(B, C);
+			}
+			OutTriangles.Add(A.X + A.Y * Num);
+			OutTriangles.Add(B.X + B.Y * Num);
+			OutTriangles.Add(C.X + C.Y * Num);
+		};
+
+		//Interior cells as in the canonical grid
+		for (int32 Y = 1; Y < Num - 2; Y++)
+		{
+			for (int32 X = 1; X < Num - 2; X++)
+			{
+				AddTriangle(FIntPoint(X, Y), FIntPoint(X, Y + 1), FIntPoint(X + 1, Y));
+				AddTriangle(FIntPoint(X + 1, Y), FIntPoint(X, Y + 1), FIntPoint(X + 1, Y + 1));
+			}
+		}
+
+		//Border ring as four trapezoids, each zips its outer edge to the inner row next to it
+		TArray<int32> Outer;
+		TArray<int32> Inner;
+		for (int32 Edge = 0; Edge < 4; Edge++)
+		{
+			auto SidePoint = [Num, Edge](int32 T, int32 Inset)
+			{
+				switch ((EQuadEdge)Edge)
+				{
+				case EQuadEdge::West:	return FIntPoint(Inset, T);
+				case EQuadEdge::East:	return FIntPoint(Num - 1 - Inset, T);
+				case EQuadEdge::South:	return FIntPoint(T, Inset);
+				default:				return FIntPoint(T, Num - 1 - Inset);
+				}
+			};
+
+			const int32 OuterStep = (Mask & (1 << Edge)) ? 2 : 1;
+			Outer.Reset();
+			Inner.Reset();
+			for (int32 T = 0; T < Num; T += OuterStep)
+			{
+				Outer.Add(T);
+			}
+			for (int32 T = 1; T < Num - 1; T++)
+			{
+				Inner.Add(T);
+			}
+
+			int32 O = 0;
+			int32 I = 0;
+			while (O < Outer.Num() - 1 || I < Inner.Num() - 1)
+			{
+				//Advance whichever side has the nearer next segment midpoint
+				const bool bAdvanceOuter = I == Inner.Num() - 1 ||
+					(O < Outer.Num() - 1 && Outer[O] + Outer[O + 1] <= Inner[I] + Inner[I + 1]);
+
+				if (bAdvanceOuter)
+				{
+					AddTriangle(SidePoint(Outer[O], 0), SidePoint(Outer[O + 1], 0), SidePoint(Inner[I], 1));
+					O++;
+				}
+				else
+				{
+					AddTriangle(SidePoint(Outer[O], 0), SidePoint(Inner[I + 1], 1), SidePoint(Inner[I], 1));
+					I++;
+				}
+			}
+		}
+	}
+}
+
+FStitchedGridIndexCache& FStitchedGridIndexCache::Get()
+{
+	static FStitchedGridIndexCache Cache;
+	return Cache;
+}
+
+FStitchedGridIndicesRef FStitchedGridIndexCache::FindOrCreate(int32 Num)
+{
+	{
+		FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+		if (const FStitchedGridIndicesRef* Found = Grids.Find(Num))
+		{
+			return *Found;
+		}
+	}
+
+	//Built outside the lock, if two threads race the first one in wins
+	TSharedPtr<FStitchedGridIndices, ESPMode::ThreadSafe> Indices = MakeShared<FStitchedGridIndices, ESPMode::ThreadSafe>();
+	Indices->Num = Num;
+	Indices->Variants[0] = FCanonicalGridMeshCache::Get().FindOrCreate(Num, Num)->Triangles;
+
+	for (int32 Mask = 1; Mask < 16; Mask++)
+	{
+		if (CanStitch(Num))
+		{
+			BuildStitchedGridIndices(Num, (uint8)Mask, Indices->Variants[Mask]);
+		}
+		else
+		{
+			Indices->Variants[Mask] = Indices->Variants[0];
+		}
+	}
+
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+	if (const FStitchedGridIndicesRef* Found = Grids.Find(Num))
+	{
+		return *Found;
+	}
+	return Grids.Add(Num, Indices);
+}
+
+void FStitchedGridIndexCache::Empty()
+{
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+	Grids.Empty();
+}
+
+bool FStitchedGridIndexCache::CanStitch(int32 Num)
+{
+	return Num >= 3 && (Num - 1) % 2 == 0;
+}
+
 FString FPatch2DIndex::ToString() const
 {
 	FPatch2DIndex Copy;
@@ -107,13 +502,17 @@ void FPatch2DIndex::SetFromString(const FString& IndexString)
 //FGridQuadNode
 
 
-FGridQuadNode::FGridQuadNode(int32 InDepth /*= 0*/, int32 InMaxDepth /*= 8*/, FVector InCenter /*= FVector(0.f)*/, FVector InNormal /*= FVector(0,0,1)*/, FVector2D InSize /*= FVector2D(1,1)*/)
+FGridQuadNode::FGridQuadNode(int32 InDepth /*= 0*/, int32 InMaxDepth /*= 8*/, FVector InCenter /*= FVector(0.f)*/, FVector InNormal /*= FVector(0,0,1)*/, FVector2D InSize /*= FVector2D(1,1)*/, int32 InFace /*= 0*/, FIntPoint InCoord /*= FIntPoint::ZeroValue*/)
 {
 	Depth = InDepth;
 	Size = InSize;
 	Center = InCenter;
 	Normal = InNormal;
 	MaxDepth = InMaxDepth;
+	Face = InFace;
+	Coord = InCoord;
+	StitchMask = 0;
+	FirstChild = INDEX_NONE;
 
 	Forward = FVector::CrossProduct(Normal, FVector::RightVector);
 	if (Forward == FVector(0.f))
@@ -127,98 +526,57 @@ FGridQuadNode::~FGridQuadNode()
 
 }
 
-void FGridQuadNode::BuildTree(FVector CameraPosition, const TMap<int32, float>& DepthComparison, const FGnomonicParams& GnomonicParams /*= FGnomonicParams()*/)
+FPatchKey FGridQuadNode::GetKey() const
 {
-	FVector ProjectedCenter = FGnomonicParams::GnomonicProjection(Center, GnomonicParams);
+	return FPatchKey(Face, Depth, Coord.X, Coord.Y);
+}
 
-	float Distance = (CameraPosition - ProjectedCenter).Size();
+float FGridQuadNode::CameraDistance(const FVector& CameraPosition, const FGnomonicParams& GnomonicParams) const
+{
+	FVector ProjectedCenter = FGnomonicParams::GnomonicProjection(Center, GnomonicParams);
 
-	/*
-	//Debug the tree construction
-	UE_LOG(LogTemp, Log, TEXT("FGridQuadNode::BuildTree for %d depth at (%s - %s)=> %1.3f Dist. Normal: %s"), Depth,
-		*CameraPosition.ToString(),
-		*Center.ToString(),
-		Distance,
-		*Normal.ToString());*/
+	return (CameraPosition - ProjectedCenter).Size();
+}
 
-	//Split condition based on distance
-	if (Distance < DepthComparison[Depth] && Depth < MaxDepth)
-	{
-		//Split Quadtree
-		FVector HalfRight = (FVector::CrossProduct(Normal,Forward) * (Size.X / 2.f));	//Normal.RightVector
-		FVector HalfForward = (Forward * (Size.Y / 2.f));	//Normal.ForwardVector
+bool FGridQuadNode::IsTipNode() const
+{
+	return FirstChild == INDEX_NONE;
+}
 
-		if (!TopLeft.IsValid())
-		{
-			FVector LeafCenter = Center - HalfRight + HalfForward;
-			TopLeft = MakeShareable(new FGridQuadNode(Depth + 1, MaxDepth, LeafCenter, Normal, Size / 2.f));
-		}
-		TopLeft->BuildTree(CameraPosition, DepthComparison, GnomonicParams);
+//FQuadNodePool
 
-		if (!TopRight.IsValid())
-		{
-			FVector LeafCenter = Center + HalfRight + HalfForward;
-			TopRight = MakeShareable(new FGridQuadNode(Depth + 1, MaxDepth, LeafCenter, Normal, Size / 2.f));
-		}
-		TopRight->BuildTree(CameraPosition, DepthComparison, GnomonicParams);
-
-		if (!BottomLeft.IsValid())
-		{
-			FVector LeafCenter = Center - HalfRight - HalfForward;
-			BottomLeft = MakeShareable(new FGridQuadNode(Depth + 1, MaxDepth, LeafCenter, Normal, Size / 2.f));
-		}
-		BottomLeft->BuildTree(CameraPosition, DepthComparison, GnomonicParams);
+int32 FQuadNodePool::AllocateChildren()
+{
+	if (FreeBlocks.Num() > 0)
+	{
+		return FreeBlocks.Pop();
+	}
 
-		if (!BottomRight.IsValid())
-		{
-			FVector LeafCenter = Center + HalfRight - HalfForward;
-			BottomRight = MakeShareable(new FGridQuadNode(Depth + 1, MaxDepth, LeafCenter, Normal, Size / 2.f));
-		}
-		BottomRight->BuildTree(CameraPosition, DepthComparison, GnomonicParams);
+	//Pages hold whole blocks, a block never straddles two
+	if (NumAllocated + 4 > Pages.Num() * NodesPerPage)
+	{
+		Pages.Add(MakeUnique<FGridQuadNode[]>(NodesPerPage));
 	}
+
+	const int32 First = NumAllocated;
+	NumAllocated += 4;
+	return First;
 }
 
-void FGridQuadNode::ClearTree()
+void FQuadNodePool::FreeChildren(int32 FirstChild)
 {
-	TopLeft = nullptr;
-	TopRight = nullptr;
-	BottomLeft = nullptr;
-	BottomRight = nullptr;
+	FreeBlocks.Add(FirstChild);
 }
 
-void FGridQuadNode::FillTipNodes(TArray<FGridQuadNode*>& OutNodes)
+void FQuadNodePool::Reset()
 {
-	if (IsTipNode())
-	{
-		OutNodes.Add(this);
-	}
-	else
-	{
-		if (TopLeft != nullptr)
-		{
-			TopLeft->FillTipNodes(OutNodes);
-		}
-		if (TopRight != nullptr)
-		{
-			TopRight->FillTipNodes(OutNodes);
-		}
-		if (BottomLeft != nullptr)
-		{
-			BottomLeft->FillTipNodes(OutNodes);
-		}
-		if (BottomRight != nullptr)
-		{
-			BottomRight->FillTipNodes(OutNodes);
-		}
-	}
+	FreeBlocks.Reset();
+	NumAllocated = 0;
 }
 
-bool FGridQuadNode::IsTipNode()
+int32 FQuadNodePool::NumNodes() const
 {
-	return	(TopLeft == nullptr &&
-			TopRight == nullptr &&
-			BottomLeft == nullptr &&
-			BottomRight == nullptr);
+	return NumAllocated - FreeBlocks.Num() * 4;
 }
 
 FPlanetQuad::FPlanetQuad(FVector InCenter, float InRadius)
@@ -228,10 +586,12 @@ FPlanetQuad::FPlanetQuad(FVector InCenter, float InRadius)
 
 	DepthDistanceScaleFactor = 1.f;
 
-	SetTopOnly(false);
-
+	bTopOnly = false;
 	MaxTreeDepth = 0;	//to ensure we init before bool check
 	TreeBaseline = 0.f;
+	MergeHysteresis = 1.1f;
+	bTreeReset = true;
+	bStitchEdges = false;
 	UpdateTreeResolution(8, 1.f);	//set default map
 }
 
@@ -261,6 +621,7 @@ void FPlanetQuad::UpdateTreeResolution(float InRadius /*= 1000.f*/, int32 InMaxT
 		}
 
 		//Build Quads
+		NodePool.Reset();
 		PlanetBaseQuads.Empty(6);
 		for (int32 i = 0; i < 6; i++)
 		{
@@ -268,52 +629,414 @@ void FPlanetQuad::UpdateTreeResolution(float InRadius /*= 1000.f*/, int32 InMaxT
 			FVector Normal = NormalForFaceIndex(i);
 
 			//Node is given relative location to cube, not global (don't add planet center position)
-			FGridQuadNode Node(0, MaxTreeDepth, (Normal * Radius), Normal, FVector2D(Radius, Radius));
+			FGridQuadNode Node(0, MaxTreeDepth, (Normal * Radius), Normal, FVector2D(Radius, Radius), i);
 			PlanetBaseQuads.Add(Node);
 		}
+		bTreeReset = true;
 	}
 }
 
 void FPlanetQuad::Regenerate(FVector CameraPosition, FVector WorldOrigin, const FGnomonicParams& GnomonicParams /*= FGnomonicParams()*/)
 {
+	ResetNodes();
+
 	if (bTopOnly)
 	{
-		FGridQuadNode& Node = PlanetBaseQuads[0];	//Top is first one
-
-		Node.ClearTree();
-		Node.BuildTree(CameraPosition, DepthDistanceMap, GnomonicParams);
+		BuildTree(PlanetBaseQuads[0], CameraPosition, GnomonicParams);	//Top is first one
 	}
 	else
 	{
 		for (FGridQuadNode& Node : PlanetBaseQuads)
 		{
-			Node.ClearTree();
-			Node.BuildTree(CameraPosition, DepthDistanceMap, GnomonicParams);
+			BuildTree(Node, CameraPosition, GnomonicParams);
+		}
+	}
+
+	if (bStitchEdges)
+	{
+		BalanceTree(nullptr);
+	}
+
+	//Incremental updates continue from this tree
+	FinalizeTips(nullptr, true);
+	bTreeReset = false;
+}
+
+void FPlanetQuad::UpdateIncremental(FVector CameraPosition, FVector WorldOrigin, const FGnomonicParams& GnomonicParams, FQuadTreeUpdate& OutUpdate)
+{
+	OutUpdate.Added.Reset();
+	OutUpdate.Removed.Reset();
+
+	const int32 NumFaces = bTopOnly ? 1 : PlanetBaseQuads.Num();
+	const bool bReset = bTreeReset;
+
+	if (bReset)
+	{
+		//Base quads were rebuilt (or never built), whatever was handed out before is gone
+		TipStitchMasks.GenerateKeyArray(OutUpdate.Removed);
+		ResetNodes();
+		for (int32 i = 0; i < NumFaces; i++)
+		{
+			UpdateTree(PlanetBaseQuads[i], CameraPosition, GnomonicParams, OutUpdate, true);
+		}
+		bTreeReset = false;
+	}
+	else
+	{
+		for (int32 i = 0; i < NumFaces; i++)
+		{
+			UpdateTree(PlanetBaseQuads[i], CameraPosition, GnomonicParams, OutUpdate, false);
+		}
+	}
+
+	if (bStitchEdges)
+	{
+		BalanceTree(&OutUpdate);
+	}
+
+	FinalizeTips(&OutUpdate, bReset);
+}
+
+FGridQuadNode* FPlanetQuad::GetChild(const FGridQuadNode& Node, int32 X, int32 Y)
+{
+	if (Node.IsTipNode())
+	{
+		return nullptr;
+	}
+	return &NodePool[Node.FirstChild + (X | (Y << 1))];
+}
+
+void FPlanetQuad::SplitNode(FGridQuadNode& Node)
+{
+	if (!Node.IsTipNode())
+	{
+		return;
+	}
+
+	FVector HalfRight = (FVector::CrossProduct(Node.Normal, Node.Forward) * (Node.Size.X / 2.f));	//Normal.RightVector
+	FVector HalfForward = (Node.Forward * (Node.Size.Y / 2.f));	//Normal.ForwardVector
+
+	//Pages don't move, Node stays valid even if this adds one
+	const int32 First = NodePool.AllocateChildren();
+	for (int32 Slot = 0; Slot < 4; Slot++)
+	{
+		const int32 X = Slot & 1;
+		const int32 Y = Slot >> 1;
+		const FVector LeafCenter = Node.Center + HalfRight * (X ? 1.f : -1.f) + HalfForward * (Y ? 1.f : -1.f);
+
+		NodePool[First + Slot] = FGridQuadNode(Node.Depth + 1, Node.MaxDepth, LeafCenter, Node.Normal, Node.Size / 2.f, Node.Face, Node.Coord * 2 + FIntPoint(X, Y));
+	}
+	Node.FirstChild = First;
+}
+
+void FPlanetQuad::ClearNode(FGridQuadNode& Node)
+{
+	if (Node.IsTipNode())
+	{
+		return;
+	}
+
+	TArray<int32, TInlineAllocator<64>> Blocks;
+	Blocks.Add(Node.FirstChild);
+	Node.FirstChild = INDEX_NONE;
+
+	while (Blocks.Num() > 0)
+	{
+		const int32 First = Blocks.Pop();
+		for (int32 Slot = 0; Slot < 4; Slot++)
+		{
+			FGridQuadNode& Child = NodePool[First + Slot];
+			if (!Child.IsTipNode())
+			{
+				Blocks.Add(Child.FirstChild);
+				Child.FirstChild = INDEX_NONE;
+			}
 		}
+		NodePool.FreeChildren(First);
+	}
+}
+
+void FPlanetQuad::ResetNodes()
+{
+	NodePool.Reset();
+	for (FGridQuadNode& Node : PlanetBaseQuads)
+	{
+		Node.FirstChild = INDEX_NONE;
 	}
 }
 
+void FPlanetQuad::CollectTips(FGridQuadNode& Root, TArray<FGridQuadNode*>& OutNodes)
+{
+	TArray<FGridQuadNode*, TInlineAllocator<64>> Stack;
+	Stack.Add(&Root);
+
+	while (Stack.Num() > 0)
+	{
+		FGridQuadNode* Node = Stack.Pop();
+		if (Node->IsTipNode())
+		{
+			OutNodes.Add(Node);
+			continue;
+		}
+
+		//Reversed so slot 0 pops first
+		for (int32 Slot = 3; Slot >= 0; Slot--)
+		{
+			Stack.Add(&NodePool[Node->FirstChild + Slot]);
+		}
+	}
+}
+
+void FPlanetQuad::BuildTree(FGridQuadNode& Root, const FVector& CameraPosition, const FGnomonicParams& GnomonicParams)
+{
+	TArray<FGridQuadNode*, TInlineAllocator<64>> Stack;
+	Stack.Add(&Root);
+
+	while (Stack.Num() > 0)
+	{
+		FGridQuadNode* Node = Stack.Pop();
+
+		//Split condition based on distance
+		if (Node->Depth < Node->MaxDepth && Node->CameraDistance(CameraPosition, GnomonicParams) < DepthDistanceMap[Node->Depth])
+		{
+			SplitNode(*Node);
+			for (int32 Slot = 3; Slot >= 0; Slot--)
+			{
+				Stack.Add(&NodePool[Node->FirstChild + Slot]);
+			}
+		}
+	}
+}
+
+void FPlanetQuad::UpdateTree(FGridQuadNode& Root, const FVector& CameraPosition, const FGnomonicParams& GnomonicParams, FQuadTreeUpdate& OutUpdate, bool bIsNewRoot)
+{
+	struct FPendingNode
+	{
+		FGridQuadNode* Node;
+		bool bIsNew;
+	};
+
+	TArray<FPendingNode, TInlineAllocator<64>> Stack;
+	Stack.Add({ &Root, bIsNewRoot });
+
+	TArray<FGridQuadNode*> SubtreeTips;
+
+	while (Stack.Num() > 0)
+	{
+		const FPendingNode Pending = Stack.Pop();
+		FGridQuadNode* Node = Pending.Node;
+
+		const float Distance = Node->CameraDistance(CameraPosition, GnomonicParams);
+		const float SplitDistance = DepthDistanceMap[Node->Depth];
+
+		if (Node->IsTipNode())
+		{
+			if (Distance < SplitDistance && Node->Depth < Node->MaxDepth)
+			{
+				//Crossed inward: this tip is replaced by its children
+				if (!Pending.bIsNew)
+				{
+					OutUpdate.Removed.Add(Node->GetKey());
+				}
+				SplitNode(*Node);
+				for (int32 Slot = 3; Slot >= 0; Slot--)
+				{
+					Stack.Add({ &NodePool[Node->FirstChild + Slot], true });
+				}
+			}
+			else if (Pending.bIsNew)
+			{
+				OutUpdate.Added.Add(Node);
+			}
+			continue;
+		}
+
+		if (Distance >= SplitDistance * MergeHysteresis || Node->Depth >= Node->MaxDepth)
+		{
+			//Crossed outward: collapse the subtree back into this tip
+			SubtreeTips.Reset();
+			CollectTips(*Node, SubtreeTips);
+			for (const FGridQuadNode* Tip : SubtreeTips)
+			{
+				OutUpdate.Removed.Add(Tip->GetKey());
+			}
+			ClearNode(*Node);
+			OutUpdate.Added.Add(Node);
+			continue;
+		}
+
+		for (int32 Slot = 3; Slot >= 0; Slot--)
+		{
+			Stack.Add({ &NodePool[Node->FirstChild + Slot], false });
+		}
+	}
+}
+
+bool FPlanetQuad::IsFaceActive(int32 Face) const
+{
+	return bTopOnly ? Face == 0 : PlanetBaseQuads.IsValidIndex(Face);
+}
+
+FGridQuadNode* FPlanetQuad::FindCoveringNode(const FPatchKey& Key)
+{
+	const int32 Depth = Key.GetDepth();
+	const int32 X = Key.GetX();
+	const int32 Y = Key.GetY();
+
+	FGridQuadNode* Node = &PlanetBaseQuads[Key.GetFace()];
+	for (int32 Level = 1; Level <= Depth && !Node->IsTipNode(); Level++)
+	{
+		const int32 Shift = Depth - Level;
+		Node = GetChild(*Node, (X >> Shift) & 1, (Y >> Shift) & 1);
+	}
+	return Node;
+}
+
+void FPlanetQuad::BalanceTree(FQuadTreeUpdate* Update)
+{
+	TArray<FGridQuadNode*> Pending;
+	FillTipNodes(Pending);
+
+	while (Pending.Num() > 0)
+	{
+		FGridQuadNode* Tip = Pending.Pop();
+		if (!Tip->IsTipNode())
+		{
+			continue;
+		}
+
+		const FPatchKey TipKey = Tip->GetKey();
+		for (int32 Edge = 0; Edge < 4; Edge++)
+		{
+			const FPatchKey Key = NeighborKey(TipKey, (EQuadEdge)Edge);
+			if (!IsFaceActive(Key.GetFace()))
+			{
+				continue;
+			}
+
+			FGridQuadNode* Neighbor = FindCoveringNode(Key);
+			if (Neighbor->Depth >= Tip->Depth - 1)
+			{
+				continue;
+			}
+
+			//Neighbour tip is too coarse, split it and look at this tip again afterwards
+			if (Update && Update->Added.Remove(Neighbor) == 0)
+			{
+				Update->Removed.Add(Neighbor->GetKey());
+			}
+
+			SplitNode(*Neighbor);
+			for (int32 Slot = 0; Slot < 4; Slot++)
+			{
+				FGridQuadNode* ChildNode = &NodePool[Neighbor->FirstChild + Slot];
+				Pending.Add(ChildNode);
+				if (Update)
+				{
+					Update->Added.Add(ChildNode);
+				}
+			}
+			Pending.Add(Tip);
+			break;
+		}
+	}
+}
+
+uint8 FPlanetQuad::ComputeStitchMask(FGridQuadNode& Tip)
+{
+	uint8 Mask = 0;
+	const FPatchKey TipKey = Tip.GetKey();
+	for (int32 Edge = 0; Edge < 4; Edge++)
+	{
+		const FPatchKey Key = NeighborKey(TipKey, (EQuadEdge)Edge);
+		if (IsFaceActive(Key.GetFace()) && FindCoveringNode(Key)->Depth < Tip.Depth)
+		{
+			Mask |= 1 << Edge;
+		}
+	}
+	return Mask;
+}
+
+void FPlanetQuad::FinalizeTips(FQuadTreeUpdate* Update, bool bReset)
+{
+	TArray<FGridQuadNode*> TipNodes;
+	FillTipNodes(TipNodes);
+
+	TMap<FPatchKey, uint8> NewStitchMasks;
+	NewStitchMasks.Reserve(TipNodes.Num());
+	for (FGridQuadNode* Node : TipNodes)
+	{
+		Node->StitchMask = bStitchEdges ? ComputeStitchMask(*Node) : 0;
+		NewStitchMasks.Add(Node->GetKey(), Node->StitchMask);
+	}
+
+	if (Update && !bReset)
+	{
+		TSet<FGridQuadNode*> Added(Update->Added);
+		TSet<FPatchKey> Removed(Update->Removed);
+
+		//Tips that were split and merged back (or the reverse) within this update are unchanged if their edges are
+		Update->Added.RemoveAll([&](FGridQuadNode* Node)
+		{
+			const FPatchKey Key = Node->GetKey();
+			const uint8* OldMask = TipStitchMasks.Find(Key);
+			return OldMask && *OldMask == Node->StitchMask && Removed.Remove(Key) > 0;
+		});
+		Update->Removed = Removed.Array();
+
+		//Neighbours changed depth, same tip needs new edge indices
+		for (FGridQuadNode* Node : TipNodes)
+		{
+			const uint8* OldMask = TipStitchMasks.Find(Node->GetKey());
+			if (OldMask && *OldMask != Node->StitchMask && !Added.Contains(Node))
+			{
+				Update->Removed.Add(Node->GetKey());
+				Update->Added.Add(Node);
+			}
+		}
+	}
+
+	TipStitchMasks = MoveTemp(NewStitchMasks);
+}
+
 void FPlanetQuad::FillTipNodes(TArray<FGridQuadNode*>& OutNodes)
 {
 	if (bTopOnly)
 	{
-		FGridQuadNode& Node = PlanetBaseQuads[0];
-		Node.FillTipNodes(OutNodes);
+		CollectTips(PlanetBaseQuads[0], OutNodes);
 	}
 	else
 	{
 		for (FGridQuadNode& Node : PlanetBaseQuads)
 		{
-			Node.FillTipNodes(OutNodes);
+			CollectTips(Node, OutNodes);
 		}
 	}
 }
 
+int32 FPlanetQuad::NumNodes() const
+{
+	return NodePool.NumNodes();
+}
+
 void FPlanetQuad::SetTopOnly(bool bInTopOnly)
 {
+	if (bTopOnly != bInTopOnly)
+	{
+		bTreeReset = true;
+	}
 	bTopOnly = bInTopOnly;
 }
 
+void FPlanetQuad::SetStitchEdges(bool bInStitchEdges)
+{
+	if (bStitchEdges != bInStitchEdges)
+	{
+		bTreeReset = true;
+	}
+	bStitchEdges = bInStitchEdges;
+}
+
 FVector FPlanetQuad::NormalForFaceIndex(int32 Index)
 {
 	if (Index == 0)
@@ -347,3 +1070,70 @@ FVector FPlanetQuad::NormalForFaceIndex(int32 Index)
 	}
 }
 
+int32 FPlanetQuad::FaceIndexForNormal(const FVector& Normal)
+{
+	int32 BestFace = 0;
+	double BestDot = -2.0;
+	for (int32 i = 0; i < 6; i++)
+	{
+		const double Dot = FVector::DotProduct(Normal, NormalForFaceIndex(i));
+		if (Dot > BestDot)
+		{
+			BestDot = Dot;
+			BestFace = i;
+		}
+	}
+	return BestFace;
+}
+
+void FPlanetQuad::FaceAxes(int32 Face, FVector& OutRight, FVector& OutForward)
+{
+	//Same as the FGridQuadNode constructor and SplitNode
+	const FVector Normal = NormalForFaceIndex(Face);
+	OutForward = FVector::CrossProduct(Normal, FVector::RightVector);
+	if (OutForward == FVector(0.f))
+	{
+		OutForward = FVector::ForwardVector;
+	}
+	OutRight = FVector::CrossProduct(Normal, OutForward);
+}
+
+FPatchKey FPlanetQuad::NeighborKey(const FPatchKey& Key, EQuadEdge Edge)
+{
+	static const FIntPoint EdgeSteps[4] = { FIntPoint(-1, 0), FIntPoint(1, 0), FIntPoint(0, -1), FIntPoint(0, 1) };
+
+	const int32 Face = Key.GetFace();
+	const int32 Depth = Key.GetDepth();
+	const int32 Cells = 1 << Depth;
+	const FIntPoint Coord(Key.GetX(), Key.GetY());
+	const FIntPoint Step = EdgeSteps[(uint8)Edge];
+	const FIntPoint Next = Coord + Step;
+
+	if (Next.X >= 0 && Next.X < Cells && Next.Y >= 0 && Next.Y < Cells)
+	{
+		return FPatchKey(Face, Depth, Next.X, Next.Y);
+	}
+
+	//Off the face: on a unit cube, fold the point half a cell past the edge onto the face we walked onto
+	FVector Right, Forward;
+	FaceAxes(Face, Right, Forward);
+
+	const double HalfCell = 1.0 / Cells;
+	const double U = -1.0 + (2.0 * Coord.X + 1.0) * HalfCell;
+	const double V = -1.0 + (2.0 * Coord.Y + 1.0) * HalfCell;
+
+	const FVector Outward = Right * Step.X + Forward * Step.Y;
+	const FVector Along = Step.X != 0 ? Forward * V : Right * U;
+	const FVector Folded = Outward + NormalForFaceIndex(Face) * (1.0 - HalfCell) + Along;
+
+	const int32 NextFace = FaceIndexForNormal(Outward);
+	FVector NextRight, NextForward;
+	FaceAxes(NextFace, NextRight, NextForward);
+
+	auto ToCell = [Cells](double T)
+	{
+		return FMath::Clamp(FMath::FloorToInt((T + 1.0) * 0.5 * Cells), 0, Cells - 1);
+	};
+	return FPatchKey(NextFace, Depth, ToCell(FVector::DotProduct(Folded, NextRight)), ToCell(FVector::DotProduct(Folded, NextForward)));
+}
+
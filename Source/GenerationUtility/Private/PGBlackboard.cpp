@@ -0,0 +1,310 @@
+#include "PGBlackboard.h"
+
+namespace
+{
+	//FTransform has no operator==, exact per element like the single Transform case
+	bool IsSameTransformArray(const TArray<FTransform>& A, const TArray<FTransform>& B)
+	{
+		if (A.Num() != B.Num())
+		{
+			return false;
+		}
+		for (int32 i = 0; i < A.Num(); i++)
+		{
+			if (!A[i].Equals(B[i], 0.f))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+bool FPGBlackboardValue::IsSameValue(const FPGBlackboardValue& Other) const
+{
+	if (Type != Other.Type)
+	{
+		return false;
+	}
+
+	switch (Type)
+	{
+	case EPGBlackboardType::Float:
+		return Float == Other.Float;
+	case EPGBlackboardType::Int:
+		return Int == Other.Int;
+	case EPGBlackboardType::Vector:
+		return Vector == Other.Vector;
+	case EPGBlackboardType::Transform:
+		return Transform.Equals(Other.Transform, 0.f);
+	case EPGBlackboardType::Object:
+		return Object == Other.Object;
+	case EPGBlackboardType::FloatArray:
+		return FloatArray.IsSharedWith(Other.FloatArray) || FloatArray.Get() == Other.FloatArray.Get();
+	case EPGBlackboardType::VectorArray:
+		return VectorArray.IsSharedWith(Other.VectorArray) || VectorArray.Get() == Other.VectorArray.Get();
+	case EPGBlackboardType::TransformArray:
+		return TransformArray.IsSharedWith(Other.TransformArray) || IsSameTransformArray(TransformArray.Get(), Other.TransformArray.Get());
+	default:
+		return true;
+	}
+}
+
+uint32 FPGBlackboardValue::GetContentHash() const
+{
+	auto HashTransform = [](const FTransform& InTransform)
+	{
+		return HashCombine(GetTypeHash(InTransform.GetTranslation()),
+			HashCombine(GetTypeHash(InTransform.GetRotation()), GetTypeHash(InTransform.GetScale3D())));
+	};
+
+	uint32 Hash = GetTypeHash(Type);
+
+	switch (Type)
+	{
+	case EPGBlackboardType::Float:
+		return HashCombine(Hash, GetTypeHash(Float));
+	case EPGBlackboardType::Int:
+		return HashCombine(Hash, GetTypeHash(Int));
+	case EPGBlackboardType::Vector:
+		return HashCombine(Hash, GetTypeHash(Vector));
+	case EPGBlackboardType::Transform:
+		return HashCombine(Hash, HashTransform(Transform));
+	case EPGBlackboardType::Object:
+		return HashCombine(Hash, Object.IsValid() ? GetTypeHash(Object->GetPathName()) : 0);
+	case EPGBlackboardType::FloatArray:
+		return FCrc::MemCrc32(FloatArray.Get().GetData(), FloatArray.Get().Num() * sizeof(float), Hash);
+	case EPGBlackboardType::VectorArray:
+		return FCrc::MemCrc32(VectorArray.Get().GetData(), VectorArray.Get().Num() * sizeof(FVector), Hash);
+	case EPGBlackboardType::TransformArray:
+		for (const FTransform& Element : TransformArray.Get())
+		{
+			Hash = HashCombine(Hash, HashTransform(Element));
+		}
+		return Hash;
+	default:
+		return Hash;
+	}
+}
+
+int32 FPGBlackboard::Num() const
+{
+	return Slots.IsValid() ? Slots->Num() : 0;
+}
+
+bool FPGBlackboard::Contains(FName Key) const
+{
+	return Slots.IsValid() && Slots->Contains(Key);
+}
+
+EPGBlackboardType FPGBlackboard::GetType(FName Key) const
+{
+	const FPGBlackboardValue* Value = Find(Key);
+	return Value ? Value->Type : EPGBlackboardType::None;
+}
+
+const FPGBlackboardValue* FPGBlackboard::Find(FName Key) const
+{
+	return Slots.IsValid() ? Slots->Find(Key) : nullptr;
+}
+
+void FPGBlackboard::GetKeys(TArray<FName>& OutKeys) const
+{
+	OutKeys.Reset();
+	if (Slots.IsValid())
+	{
+		Slots->GetKeys(OutKeys);
+	}
+}
+
+void FPGBlackboard::SetFloat(FName Key, float Value)
+{
+	EditSlot(Key, EPGBlackboardType::Float).Float = Value;
+}
+
+bool FPGBlackboard::GetFloat(FName Key, float& OutValue) const
+{
+	const FPGBlackboardValue* Value = FindTyped(Key, EPGBlackboardType::Float);
+	if (!Value)
+	{
+		return false;
+	}
+	OutValue = Value->Float;
+	return true;
+}
+
+void FPGBlackboard::SetInt(FName Key, int32 Value)
+{
+	EditSlot(Key, EPGBlackboardType::Int).Int = Value;
+}
+
+bool FPGBlackboard::GetInt(FName Key, int32& OutValue) const
+{
+	const FPGBlackboardValue* Value = FindTyped(Key, EPGBlackboardType::Int);
+	if (!Value)
+	{
+		return false;
+	}
+	OutValue = Value->Int;
+	return true;
+}
+
+void FPGBlackboard::SetVector(FName Key, const FVector& Value)
+{
+	EditSlot(Key, EPGBlackboardType::Vector).Vector = Value;
+}
+
+bool FPGBlackboard::GetVector(FName Key, FVector& OutValue) const
+{
+	const FPGBlackboardValue* Value = FindTyped(Key, EPGBlackboardType::Vector);
+	if (!Value)
+	{
+		return false;
+	}
+	OutValue = Value->Vector;
+	return true;
+}
+
+void FPGBlackboard::SetTransform(FName Key, const FTransform& Value)
+{
+	EditSlot(Key, EPGBlackboardType::Transform).Transform = Value;
+}
+
+bool FPGBlackboard::GetTransform(FName Key, FTransform& OutValue) const
+{
+	const FPGBlackboardValue* Value = FindTyped(Key, EPGBlackboardType::Transform);
+	if (!Value)
+	{
+		return false;
+	}
+	OutValue = Value->Transform;
+	return true;
+}
+
+void FPGBlackboard::SetObject(FName Key, UObject* Value)
+{
+	EditSlot(Key, EPGBlackboardType::Object).Object = Value;
+}
+
+UObject* FPGBlackboard::GetObject(FName Key) const
+{
+	const FPGBlackboardValue* Value = FindTyped(Key, EPGBlackboardType::Object);
+	return Value ? Value->Object.Get() : nullptr;
+}
+
+void FPGBlackboard::SetFloatArray(FName Key, TArray<float> Values)
+{
+	EditSlot(Key, EPGBlackboardType::FloatArray).FloatArray.Set(MoveTemp(Values));
+}
+
+const TArray<float>& FPGBlackboard::GetFloatArray(FName Key) const
+{
+	static const TArray<float> Empty;
+	const FPGBlackboardValue* Value = FindTyped(Key, EPGBlackboardType::FloatArray);
+	return Value ? Value->FloatArray.Get() : Empty;
+}
+
+TArray<float>& FPGBlackboard::EditFloatArray(FName Key)
+{
+	return EditSlot(Key, EPGBlackboardType::FloatArray).FloatArray.Edit();
+}
+
+void FPGBlackboard::SetVectorArray(FName Key, TArray<FVector> Values)
+{
+	EditSlot(Key, EPGBlackboardType::VectorArray).VectorArray.Set(MoveTemp(Values));
+}
+
+const TArray<FVector>& FPGBlackboard::GetVectorArray(FName Key) const
+{
+	static const TArray<FVector> Empty;
+	const FPGBlackboardValue* Value = FindTyped(Key, EPGBlackboardType::VectorArray);
+	return Value ? Value->VectorArray.Get() : Empty;
+}
+
+TArray<FVector>& FPGBlackboard::EditVectorArray(FName Key)
+{
+	return EditSlot(Key, EPGBlackboardType::VectorArray).VectorArray.Edit();
+}
+
+void FPGBlackboard::SetTransformArray(FName Key, TArray<FTransform> Values)
+{
+	EditSlot(Key, EPGBlackboardType::TransformArray).TransformArray.Set(MoveTemp(Values));
+}
+
+const TArray<FTransform>& FPGBlackboard::GetTransformArray(FName Key) const
+{
+	static const TArray<FTransform> Empty;
+	const FPGBlackboardValue* Value = FindTyped(Key, EPGBlackboardType::TransformArray);
+	return Value ? Value->TransformArray.Get() : Empty;
+}
+
+TArray<FTransform>& FPGBlackboard::EditTransformArray(FName Key)
+{
+	return EditSlot(Key, EPGBlackboardType::TransformArray).TransformArray.Edit();
+}
+
+void FPGBlackboard::SetValue(FName Key, const FPGBlackboardValue& Value)
+{
+	EditSlots().Add(Key, Value);
+}
+
+void FPGBlackboard::Remove(FName Key)
+{
+	//Avoid detaching shared storage for a no-op
+	if (Contains(Key))
+	{
+		EditSlots().Remove(Key);
+	}
+}
+
+void FPGBlackboard::Reset()
+{
+	Slots.Reset();
+}
+
+void FPGBlackboard::Append(const FPGBlackboard& Other)
+{
+	if (Other.Num() == 0 || Slots == Other.Slots)
+	{
+		return;
+	}
+
+	if (Num() == 0)
+	{
+		Slots = Other.Slots;
+		return;
+	}
+
+	//Values are shallow, array buffers stay shared
+	EditSlots().Append(*Other.Slots);
+}
+
+FPGBlackboard::FSlotMap& FPGBlackboard::EditSlots()
+{
+	if (!Slots.IsValid())
+	{
+		Slots = MakeShared<FSlotMap, ESPMode::ThreadSafe>();
+	}
+	else if (!Slots.IsUnique())
+	{
+		Slots = MakeShared<FSlotMap, ESPMode::ThreadSafe>(*Slots);
+	}
+	return *Slots;
+}
+
+FPGBlackboardValue& FPGBlackboard::EditSlot(FName Key, EPGBlackboardType Type)
+{
+	FPGBlackboardValue& Value = EditSlots().FindOrAdd(Key);
+	if (Value.Type != Type)
+	{
+		Value = FPGBlackboardValue();
+		Value.Type = Type;
+	}
+	return Value;
+}
+
+const FPGBlackboardValue* FPGBlackboard::FindTyped(FName Key, EPGBlackboardType Type) const
+{
+	const FPGBlackboardValue* Value = Find(Key);
+	return (Value && Value->Type == Type) ? Value : nullptr;
+}
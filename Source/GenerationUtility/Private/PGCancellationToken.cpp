@@ -0,0 +1,110 @@
+#include "PGCancellationToken.h"
+
+FPGCancellationToken::FPGCancellationToken(TSharedPtr<FPGCancellationToken, ESPMode::ThreadSafe> InParent)
+	: Parent(InParent)
+	, Deadline(0.0)
+{
+	bCancelled = false;
+}
+
+void FPGCancellationToken::Cancel()
+{
+	bCancelled = true;
+}
+
+bool FPGCancellationToken::IsCancelled() const
+{
+	if (bCancelled || HasDeadlinePassed())
+	{
+		return true;
+	}
+	return Parent.IsValid() && Parent->IsCancelled();
+}
+
+bool FPGCancellationToken::HasDeadlinePassed() const
+{
+	const double CurrentDeadline = Deadline.load(std::memory_order_relaxed);
+	if (CurrentDeadline > 0.0 && FPlatformTime::Seconds() > CurrentDeadline)
+	{
+		return true;
+	}
+	return Parent.IsValid() && Parent->HasDeadlinePassed();
+}
+
+void FPGCancellationToken::SetDeadline(double InDeadline)
+{
+	Deadline.store(InDeadline > 0.0 ? InDeadline : 0.0, std::memory_order_relaxed);
+}
+
+void FPGCancellationToken::SetTimeBudget(float Seconds)
+{
+	SetDeadline(Seconds > 0.f ? FPlatformTime::Seconds() + Seconds : 0.0);
+}
+
+double FPGCancellationToken::GetDeadline() const
+{
+	return Deadline.load(std::memory_order_relaxed);
+}
+
+void FPGCancellationToken::BeginWork()
+{
+	ActiveWork.Increment();
+	if (Parent.IsValid())
+	{
+		Parent->BeginWork();
+	}
+}
+
+void FPGCancellationToken::EndWork()
+{
+	if (ActiveWork.Decrement() == 0)
+	{
+		TArray<TFunction<void()>> Callbacks;
+		{
+			FScopeLock Lock(&DrainedLock);
+			Callbacks = MoveTemp(DrainedCallbacks);
+		}
+		for (TFunction<void()>& Callback : Callbacks)
+		{
+			Callback();
+		}
+	}
+	if (Parent.IsValid())
+	{
+		Parent->EndWork();
+	}
+}
+
+int32 FPGCancellationToken::NumActiveWork() const
+{
+	return ActiveWork.GetValue();
+}
+
+bool FPGCancellationToken::WaitForWork(float TimeoutSeconds) const
+{
+	const double EndTime = FPlatformTime::Seconds() + TimeoutSeconds;
+
+	while (ActiveWork.GetValue() > 0)
+	{
+		if (FPlatformTime::Seconds() > EndTime)
+		{
+			return false;
+		}
+		FPlatformProcess::Sleep(0.001f);
+	}
+	return true;
+}
+
+void FPGCancellationToken::OnWorkDrained(TFunction<void()> Callback)
+{
+	{
+		//Checked under the lock so a concurrent last EndWork either sees our callback or we see zero
+		FScopeLock Lock(&DrainedLock);
+		if (ActiveWork.GetValue() > 0)
+		{
+			DrainedCallbacks.Add(MoveTemp(Callback));
+			return;
+		}
+	}
+	Callback();
+}
@@ -0,0 +1,290 @@
+#include "PGChainRegistrySubsystem.h"
+#include "PGChainResultCache.h"
+#include "GESHandler.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "UObject/Package.h"
+
+namespace
+{
+	//Point delegates bound to the template at the same function on the clone
+	void RebindToClone(FProcessChainSignature& Delegate, const UProcGeneratorChain* Template, UProcGeneratorChain* Clone)
+	{
+		if (Delegate.IsBound() && Delegate.GetUObject() == Template)
+		{
+			const FName FunctionName = Delegate.GetFunctionName();
+			Delegate.BindUFunction(Clone, FunctionName);
+		}
+	}
+
+	void RebindToClone(FProcGeneratorRequestSignature& Delegate, const UProcGeneratorChain* Template, UProcGeneratorChain* Clone)
+	{
+		if (Delegate.IsBound() && Delegate.GetUObject() == Template)
+		{
+			const FName FunctionName = Delegate.GetFunctionName();
+			Delegate.BindUFunction(Clone, FunctionName);
+		}
+	}
+
+	//Anything bound to another object (script wrappers, closures) can't be moved over to a clone
+	template<typename DelegateType>
+	bool IsBoundOnlyToSelf(const DelegateType& Delegate, const UProcGeneratorChain* Chain)
+	{
+		return !Delegate.IsBound() || Delegate.GetUObject() == Chain;
+	}
+}
+
+void UPGChainRegistrySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	FGESEventContext Context;
+	Context.Domain = TEXT("Procedural");
+	Context.Event = TEXT("JsReloaded");
+	Context.WorldContext = this;
+	FGESHandler::DefaultHandler()->AddLambdaListener(Context, [this]
+	{
+		InvalidateCache();
+		FPGChainResultCache::Get().OnScriptsReloaded();
+	});
+}
+
+void UPGChainRegistrySubsystem::Deinitialize()
+{
+	FGESHandler::DefaultHandler()->RemoveAllListenersForReceiver(this);
+	InvalidateCache();
+
+	Super::Deinitialize();
+}
+
+UPGChainRegistrySubsystem* UPGChainRegistrySubsystem::Get(const UObject* WorldContextObject)
+{
+	if (!WorldContextObject || !GEngine)
+	{
+		return nullptr;
+	}
+
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull);
+	return World ? World->GetSubsystem<UPGChainRegistrySubsystem>() : nullptr;
+}
+
+void UPGChainRegistrySubsystem::RegisterChainTemplate(const FString& Name, UProcGeneratorChain* Template)
+{
+	if (!Template)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UPGChainRegistrySubsystem::RegisterChainTemplate null template for %s"), *Name);
+		return;
+	}
+
+	if (!CanCloneChain(Template))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UPGChainRegistrySubsystem::RegisterChainTemplate %s contains script chains or delegates bound to other objects, not cached."), *Name);
+		return;
+	}
+
+	//Keep our own copy so later edits to the registered instance don't leak into new chains
+	Templates.Add(Name, CloneChain(Template, this));
+	ChainClasses.Remove(Name);
+}
+
+void UPGChainRegistrySubsystem::RegisterChainClass(const FString& Name, TSubclassOf<UProcGeneratorChain> ChainClass)
+{
+	if (!ChainClass)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UPGChainRegistrySubsystem::RegisterChainClass null class for %s"), *Name);
+		return;
+	}
+
+	ChainClasses.Add(Name, ChainClass);
+	Templates.Remove(Name);
+}
+
+UProcGeneratorChain* UPGChainRegistrySubsystem::CreateChainByName(const FString& Name, UObject* Outer)
+{
+	if (!Outer)
+	{
+		Outer = this;
+	}
+
+	if (UProcGeneratorChain** Template = Templates.Find(Name))
+	{
+		if (*Template)
+		{
+			CachedCreations++;
+			return CloneChain(*Template, Outer);
+		}
+	}
+
+	if (TSubclassOf<UProcGeneratorChain>* ChainClass = ChainClasses.Find(Name))
+	{
+		if (*ChainClass)
+		{
+			CachedCreations++;
+			return NewObject<UProcGeneratorChain>(Outer, *ChainClass);
+		}
+	}
+
+	return nullptr;
+}
+
+bool UPGChainRegistrySubsystem::IsChainCached(const FString& Name) const
+{
+	return Templates.Contains(Name) || ChainClasses.Contains(Name);
+}
+
+void UPGChainRegistrySubsystem::InvalidateCache()
+{
+	if (Templates.Num() > 0 || ChainClasses.Num() > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("UPGChainRegistrySubsystem cleared %d chain templates"), Templates.Num() + ChainClasses.Num());
+	}
+	Templates.Empty();
+	ChainClasses.Empty();
+}
+
+void UPGChainRegistrySubsystem::RequestChainByName(const FString& Name, UObject* Outer, TFunction<void(UProcGeneratorChain*)> ReceivingLambda)
+{
+	UProcGeneratorChain* Chain = CreateChainByName(Name, Outer);
+
+	if (!Chain)
+	{
+		//Miss: ask script, a native result becomes the template
+		UProcGeneratorChain* ScriptChain = FetchChainFromScript(Name, Outer ? Outer : this);
+		if (!ScriptChain)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UPGChainRegistrySubsystem: no chain found for %s"), *Name);
+			return;
+		}
+
+		if (CanCloneChain(ScriptChain))
+		{
+			RegisterChainTemplate(Name, ScriptChain);
+			Chain = CreateChainByName(Name, Outer);
+		}
+		else
+		{
+			//Script chains carry state a clone wouldn't get, use the fresh instance and ask again next time
+			Chain = ScriptChain;
+		}
+	}
+
+	if (Chain && ReceivingLambda)
+	{
+		ReceivingLambda(Chain);
+	}
+}
+
+UProcGeneratorChain* UPGChainRegistrySubsystem::FetchChainFromScript(const FString& Name, UObject* WorldContextObject)
+{
+	UProcGeneratorChain* Result = nullptr;
+
+	FGESEventContext ReplyContext;
+	ReplyContext.Domain = TEXT("Procedural");
+	ReplyContext.Event = TEXT("RequestJsCallback"); //script replies on the same thread before EmitEvent returns
+	ReplyContext.WorldContext = WorldContextObject;
+
+	FString Id = FGESHandler::DefaultHandler()->AddLambdaListener(ReplyContext, [&Result](UObject* FoundChain)
+	{
+		Result = Cast<UProcGeneratorChain>(FoundChain);
+	});
+
+	FGESEmitContext EmitContext;
+	EmitContext.Domain = ReplyContext.Domain;
+	EmitContext.Event = TEXT("RequestJsChainByName");
+	EmitContext.WorldContext = WorldContextObject;
+
+	FGESHandler::DefaultHandler()->EmitEvent(EmitContext, Name);
+
+	FGESHandler::DefaultHandler()->RemoveLambdaListener(ReplyContext, Id);
+
+	UPGChainRegistrySubsystem* Registry = Get(WorldContextObject);
+	if (Registry)
+	{
+		Registry->ScriptLookups++;
+	}
+
+	return Result;
+}
+
+UProcGeneratorChain* UPGChainRegistrySubsystem::CloneChain(UProcGeneratorChain* Template, UObject* Outer)
+{
+	if (!Template)
+	{
+		return nullptr;
+	}
+
+	UProcGeneratorChain* Clone = DuplicateObject<UProcGeneratorChain>(Template, Outer ? Outer : GetTransientPackage());
+	if (!Clone)
+	{
+		return nullptr;
+	}
+
+	FPGChainState& State = Clone->ChainState;
+	State.Status = EPGChainStatus::Idle;
+	State.LastLatentStatus = EPGChainStatus::Idle;
+	State.SubChainProcessingIndex = 0;
+
+	//DuplicateObject only copies subobjects outered to the template, anything else would still be shared
+	for (int32 i = 0; i < State.SubChains.Num(); i++)
+	{
+		UProcGeneratorChain* SubChain = State.SubChains[i];
+		if (SubChain && !SubChain->IsIn(Clone))
+		{
+			SubChain = CloneChain(SubChain, Clone);
+			State.SubChains[i] = SubChain;
+		}
+		if (SubChain)
+		{
+			SubChain->ChainState.ParentChain = Clone;
+		}
+	}
+
+	UProcGeneratorChain* NextChain = State.NextChain;
+	if (NextChain && !NextChain->IsIn(Clone))
+	{
+		NextChain = CloneChain(NextChain, Outer);
+		State.NextChain = NextChain;
+	}
+	if (NextChain)
+	{
+		NextChain->ChainState.PreviousChain = Clone;
+	}
+
+	RebindToClone(Clone->OnPreProcessChainEvent, Template, Clone);
+	RebindToClone(Clone->OnPostProcessChainEvent, Template, Clone);
+	RebindToClone(Clone->OnChainFinishedEvent, Template, Clone);
+	RebindToClone(Clone->OnRequestedChainFoundEvent, Template, Clone);
+
+	return Clone;
+}
+
+bool UPGChainRegistrySubsystem::CanCloneChain(const UProcGeneratorChain* Chain)
+{
+	if (!Chain)
+	{
+		return true;
+	}
+
+	//Script generated classes keep closures and non UPROPERTY state on the script side, bound to the original
+	if (!Chain->GetClass()->HasAnyClassFlags(CLASS_Native))
+	{
+		return false;
+	}
+
+	if (!IsBoundOnlyToSelf(Chain->OnPreProcessChainEvent, Chain) ||
+		!IsBoundOnlyToSelf(Chain->OnPostProcessChainEvent, Chain) ||
+		!IsBoundOnlyToSelf(Chain->OnChainFinishedEvent, Chain) ||
+		!IsBoundOnlyToSelf(Chain->OnRequestedChainFoundEvent, Chain))
+	{
+		return false;
+	}
+
+	for (const UProcGeneratorChain* SubChain : Chain->ChainState.SubChains)
+	{
+		if (!CanCloneChain(SubChain))
+		{
+			return false;
+		}
+	}
+	return CanCloneChain(Chain->ChainState.NextChain);
+}
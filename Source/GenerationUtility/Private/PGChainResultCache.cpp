@@ -0,0 +1,305 @@
+#include "PGChainResultCache.h"
+#include "GUDataTypes.h"
+#include "CUBlueprintLibrary.h"
+#include "Misc/FileHelper.h"
+#include "Misc/ScopeLock.h"
+#include "HAL/FileManager.h"
+#include "Misc/SecureHash.h"
+
+namespace
+{
+	FString HashScriptFile(const FString& Path)
+	{
+		TArray<uint8> Bytes;
+		if (!FFileHelper::LoadFileToArray(Bytes, *Path, FILEREAD_Silent))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("FPGChainResultCache: can't read script source %s"), *Path);
+			return FString();
+		}
+
+		FSHAHash Hash;
+		FSHA1::HashBuffer(Bytes.GetData(), Bytes.Num(), Hash.Hash);
+		return Hash.ToString();
+	}
+}
+
+FPGChainCachedResult FPGChainCachedResult::FromContextChange(const FPGContextData& Before, const FPGContextData& After, const TSet<FString>& OnlyKeys)
+{
+	FPGChainCachedResult Result;
+	auto IsTracked = [&OnlyKeys](const FString& Key)
+	{
+		return OnlyKeys.Num() == 0 || OnlyKeys.Contains(Key);
+	};
+
+	for (const TPair<FString, FString>& Pair : After.StringMap)
+	{
+		const FString* Previous = Before.StringMap.Find(Pair.Key);
+		if (IsTracked(Pair.Key) && (!Previous || *Previous != Pair.Value))
+		{
+			Result.StringMap.Add(Pair.Key, Pair.Value);
+		}
+	}
+	for (const TPair<FString, UObject*>& Pair : After.ObjectMap)
+	{
+		UObject* const* Previous = Before.ObjectMap.Find(Pair.Key);
+		if (IsTracked(Pair.Key) && (!Previous || *Previous != Pair.Value))
+		{
+			Result.ObjectMap.Add(Pair.Key, Pair.Value);
+		}
+	}
+	for (const TPair<FString, AActor*>& Pair : After.ActorMap)
+	{
+		AActor* const* Previous = Before.ActorMap.Find(Pair.Key);
+		if (IsTracked(Pair.Key) && (!Previous || *Previous != Pair.Value))
+		{
+			Result.ActorMap.Add(Pair.Key, Pair.Value);
+		}
+	}
+
+	//Unchanged array slots still share their buffer with Before, so this stays cheap
+	TArray<FName> BlackboardKeys;
+	After.Blackboard.GetKeys(BlackboardKeys);
+	for (const FName& Key : BlackboardKeys)
+	{
+		const FPGBlackboardValue* Value = After.Blackboard.Find(Key);
+		const FPGBlackboardValue* Previous = Before.Blackboard.Find(Key);
+		if (IsTracked(Key.ToString()) && (!Previous || !Previous->IsSameValue(*Value)))
+		{
+			Result.Blackboard.SetValue(Key, *Value);
+		}
+	}
+	Before.Blackboard.GetKeys(BlackboardKeys);
+	for (const FName& Key : BlackboardKeys)
+	{
+		if (IsTracked(Key.ToString()) && !After.Blackboard.Contains(Key))
+		{
+			Result.RemovedBlackboardKeys.Add(Key);
+		}
+	}
+
+	//Keys are shared between maps, so a removal is any key that's gone from all of them
+	TSet<FString> BeforeKeys;
+	for (const TPair<FString, FString>& Pair : Before.StringMap)
+	{
+		BeforeKeys.Add(Pair.Key);
+	}
+	for (const TPair<FString, UObject*>& Pair : Before.ObjectMap)
+	{
+		BeforeKeys.Add(Pair.Key);
+	}
+	for (const TPair<FString, AActor*>& Pair : Before.ActorMap)
+	{
+		BeforeKeys.Add(Pair.Key);
+	}
+	for (const FString& Key : BeforeKeys)
+	{
+		if (IsTracked(Key) &&
+			!After.StringMap.Contains(Key) &&
+			!After.ObjectMap.Contains(Key) &&
+			!After.ActorMap.Contains(Key))
+		{
+			Result.RemovedKeys.Add(Key);
+		}
+	}
+	return Result;
+}
+
+bool FPGChainCachedResult::ApplyTo(FPGContextData& Context) const
+{
+	for (const TPair<FString, TWeakObjectPtr<UObject>>& Pair : ObjectMap)
+	{
+		if (!Pair.Value.IsValid())
+		{
+			return false;
+		}
+	}
+	for (const TPair<FString, TWeakObjectPtr<AActor>>& Pair : ActorMap)
+	{
+		if (!Pair.Value.IsValid())
+		{
+			return false;
+		}
+	}
+
+	for (const FString& Key : RemovedKeys)
+	{
+		Context.StringMap.Remove(Key);
+		Context.ObjectMap.Remove(Key);
+		Context.ActorMap.Remove(Key);
+	}
+
+	for (const FName& Key : RemovedBlackboardKeys)
+	{
+		Context.Blackboard.Remove(Key);
+	}
+	Context.Blackboard.Append(Blackboard);
+
+	Context.StringMap.Append(StringMap);
+	for (const TPair<FString, TWeakObjectPtr<UObject>>& Pair : ObjectMap)
+	{
+		Context.ObjectMap.Add(Pair.Key, Pair.Value.Get());
+	}
+	for (const TPair<FString, TWeakObjectPtr<AActor>>& Pair : ActorMap)
+	{
+		Context.ActorMap.Add(Pair.Key, Pair.Value.Get());
+	}
+	return true;
+}
+
+bool FPGChainCachedResult::HasMemoryOnlyData() const
+{
+	return ObjectMap.Num() > 0 || ActorMap.Num() > 0 || Blackboard.Num() > 0 || RemovedBlackboardKeys.Num() > 0;
+}
+
+FPGChainResultCache& FPGChainResultCache::Get()
+{
+	static FPGChainResultCache Cache;
+	return Cache;
+}
+
+bool FPGChainResultCache::Find(const FString& Key, bool bAllowDisk, FPGChainCachedResult& OutResult)
+{
+	{
+		FScopeLock Lock(&CacheLock);
+		if (const FPGChainCachedResult* Entry = Entries.Find(Key))
+		{
+			OutResult = *Entry;
+			return true;
+		}
+	}
+
+	if (!bAllowDisk)
+	{
+		return false;
+	}
+
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *DiskPath(Key), FILEREAD_Silent))
+	{
+		return false;
+	}
+
+	FPGChainCachedResult Loaded;
+	UCUBlueprintLibrary::DeserializeStruct(FPGChainCachedResult::StaticStruct(), &Loaded, Bytes);
+
+	FScopeLock Lock(&CacheLock);
+	Entries.Add(Key, Loaded);
+	OutResult = Loaded;
+	return true;
+}
+
+void FPGChainResultCache::Store(const FString& Key, const FPGChainCachedResult& Result, bool bPersist)
+{
+	{
+		FScopeLock Lock(&CacheLock);
+		Entries.Add(Key, Result);
+	}
+
+	if (!bPersist || Result.HasMemoryOnlyData())
+	{
+		return;
+	}
+
+	TArray<uint8> Bytes;
+	UCUBlueprintLibrary::SerializeStruct(FPGChainCachedResult::StaticStruct(), (void*)&Result, Bytes);
+
+	if (!FFileHelper::SaveArrayToFile(Bytes, *DiskPath(Key)))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FPGChainResultCache::Store failed to write %s"), *DiskPath(Key));
+	}
+}
+
+void FPGChainResultCache::Remove(const FString& Key)
+{
+	{
+		FScopeLock Lock(&CacheLock);
+		Entries.Remove(Key);
+	}
+	IFileManager::Get().Delete(*DiskPath(Key), false, false, true);
+}
+
+void FPGChainResultCache::Clear(bool bIncludeDisk)
+{
+	{
+		FScopeLock Lock(&CacheLock);
+		Entries.Empty();
+	}
+
+	if (bIncludeDisk)
+	{
+		IFileManager::Get().DeleteDirectory(*CacheFolder(), false, true);
+	}
+}
+
+FString FPGChainResultCache::GetScriptFileHash(const FString& Path)
+{
+	{
+		FScopeLock Lock(&CacheLock);
+		if (const FString* Hash = ScriptFileHashes.Find(Path))
+		{
+			return *Hash;
+		}
+	}
+
+	const FString Hash = HashScriptFile(Path);
+
+	FScopeLock Lock(&CacheLock);
+	ScriptFileHashes.Add(Path, Hash);
+	return Hash;
+}
+
+void FPGChainResultCache::OnScriptsReloaded()
+{
+	TMap<FString, FString> KnownFiles;
+	{
+		FScopeLock Lock(&CacheLock);
+		KnownFiles = ScriptFileHashes;
+	}
+
+	//Disk entries of old hashes are simply never asked for again, and valid again if a script is reverted
+	TSet<FString> ChangedHashes;
+	TMap<FString, FString> CurrentHashes;
+	for (const TPair<FString, FString>& Pair : KnownFiles)
+	{
+		const FString Hash = HashScriptFile(Pair.Key);
+		CurrentHashes.Add(Pair.Key, Hash);
+		if (Hash != Pair.Value)
+		{
+			ChangedHashes.Add(Pair.Value);
+		}
+	}
+
+	FScopeLock Lock(&CacheLock);
+	ScriptFileHashes = MoveTemp(CurrentHashes);
+
+	int32 NumDropped = 0;
+	for (auto It = Entries.CreateIterator(); It; ++It)
+	{
+		for (const FString& Hash : It.Value().ScriptHashes)
+		{
+			if (ChangedHashes.Contains(Hash))
+			{
+				It.RemoveCurrent();
+				NumDropped++;
+				break;
+			}
+		}
+	}
+
+	if (ChangedHashes.Num() > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("FPGChainResultCache: %d scripts changed, dropped %d cached results"), ChangedHashes.Num(), NumDropped);
+	}
+}
+
+FString FPGChainResultCache::CacheFolder()
+{
+	//Same root as other proc gen caches
+	FPGCacheSettings Settings;
+	return Settings.CacheSavePath + TEXT("/ChainResults");
+}
+
+FString FPGChainResultCache::DiskPath(const FString& Key)
+{
+	return CacheFolder() + TEXT("/") + Key + TEXT(".bin");
+}
@@ -0,0 +1,456 @@
+#include "PGChainScheduler.h"
+#include "Misc/ScopeLock.h"
+
+namespace
+{
+	//Copies a key from all maps and the blackboard, keys missing in From are removed from To
+	void SyncContextKey(const FPGContextData& From, FPGContextData& To, const FString& Key)
+	{
+		if (const FString* StringValue = From.StringMap.Find(Key))
+		{
+			To.StringMap.Add(Key, *StringValue);
+		}
+		else
+		{
+			To.StringMap.Remove(Key);
+		}
+
+		if (UObject* const* ObjectValue = From.ObjectMap.Find(Key))
+		{
+			To.ObjectMap.Add(Key, *ObjectValue);
+		}
+		else
+		{
+			To.ObjectMap.Remove(Key);
+		}
+
+		if (AActor* const* ActorValue = From.ActorMap.Find(Key))
+		{
+			To.ActorMap.Add(Key, *ActorValue);
+		}
+		else
+		{
+			To.ActorMap.Remove(Key);
+		}
+
+		const FName BlackboardKey(*Key);
+		if (const FPGBlackboardValue* BlackboardValue = From.Blackboard.Find(BlackboardKey))
+		{
+			To.Blackboard.SetValue(BlackboardKey, *BlackboardValue);
+		}
+		else
+		{
+			To.Blackboard.Remove(BlackboardKey);
+		}
+	}
+}
+
+UPGChainScheduler::UPGChainScheduler()
+{
+	bIsRunning = false;
+	bCancelled = false;
+	bFailed = false;
+	bOutputDebugFlowLog = false;
+}
+
+bool UPGChainScheduler::RunChainGraph(UProcGeneratorChain* RootChain, UPGContextDataObject* InOutContextData)
+{
+	if (bIsRunning)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UPGChainScheduler::RunChainGraph graph is already running, cancel it first."));
+		return false;
+	}
+	if (!RootChain || !InOutContextData)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UPGChainScheduler::RunChainGraph invalid root chain or context."));
+		return false;
+	}
+
+	ResetGraph();
+	Root = RootChain;
+	TargetContext = InOutContextData;
+
+	if (AddChainNodes(RootChain, INDEX_NONE) == INDEX_NONE)
+	{
+		ResetGraph();
+		return false;
+	}
+
+	SharedContext = InOutContextData->Context;
+	bCancelled = false;
+	bFailed = false;
+	bIsRunning = true;
+
+	for (UProcGeneratorChain* Chain : Chains)
+	{
+		//Quiet reset, statuses are broadcast as steps run
+		Chain->ChainState.Status = EPGChainStatus::Idle;
+		Chain->bShouldLatentStillRun = true;
+		Chain->bHasPendingConcurrentError = false;
+		Chain->PendingConcurrentError.Empty();
+		Chain->bIsRunningConcurrently = true;
+	}
+
+	//Prerequisites always have lower indices so their events exist by the time we dispatch
+	FGraphEventArray AllEvents;
+	for (int32 NodeIndex = 0; NodeIndex < Nodes.Num(); NodeIndex++)
+	{
+		FPGChainGraphNode& Node = Nodes[NodeIndex];
+
+		FGraphEventArray Prerequisites;
+		for (int32 Prerequisite : Node.Prerequisites)
+		{
+			Prerequisites.Add(Nodes[Prerequisite].Event);
+		}
+
+		Node.Event = FFunctionGraphTask::CreateAndDispatchWhenReady([this, NodeIndex]()
+		{
+			RunNode(NodeIndex);
+		}, TStatId(), &Prerequisites, Node.bRunOnWorker ? ENamedThreads::AnyBackgroundThreadNormalTask : ENamedThreads::GameThread);
+
+		AllEvents.Add(Node.Event);
+	}
+
+	JoinEvent = FFunctionGraphTask::CreateAndDispatchWhenReady([this]()
+	{
+		JoinGraph();
+	}, TStatId(), &AllEvents, ENamedThreads::GameThread);
+
+	if (bOutputDebugFlowLog)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Flow Graph: dispatched %d steps for %d chains"), Nodes.Num(), Chains.Num());
+	}
+	return true;
+}
+
+void UPGChainScheduler::Cancel()
+{
+	bCancelled = true;
+}
+
+bool UPGChainScheduler::IsRunning() const
+{
+	return bIsRunning;
+}
+
+int32 UPGChainScheduler::NumGraphNodes() const
+{
+	return Nodes.Num();
+}
+
+void UPGChainScheduler::BeginDestroy()
+{
+	//In-flight tasks reference us, let them drain. Cancelled steps return immediately.
+	if (bIsRunning && JoinEvent.IsValid() && !JoinEvent->IsComplete())
+	{
+		Cancel();
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(JoinEvent, ENamedThreads::GameThread);
+	}
+
+	Super::BeginDestroy();
+}
+
+int32 UPGChainScheduler::AddChainNodes(UProcGeneratorChain* Chain, int32 AfterNode)
+{
+	if (!Chain)
+	{
+		return AfterNode;
+	}
+
+	if (VisitedChains.Contains(Chain))
+	{
+		UE_LOG(LogTemp, Error, TEXT("UPGChainScheduler::AddChainNodes %s is linked more than once, can't schedule cyclic or shared chains."), *Chain->GetName());
+		return INDEX_NONE;
+	}
+	VisitedChains.Add(Chain);
+
+	const int32 PreNode = AddNode(Chain, false);
+	AddEdge(AfterNode, PreNode);
+
+	//Subchains start after our pre, our post waits for all of them (including their next chains)
+	TArray<int32> SubChainTails;
+	for (UProcGeneratorChain* SubChain : Chain->ChainState.SubChains)
+	{
+		const int32 SubChainTail = AddChainNodes(SubChain, PreNode);
+		if (SubChainTail == INDEX_NONE)
+		{
+			return INDEX_NONE;
+		}
+		SubChainTails.Add(SubChainTail);
+	}
+
+	const int32 PostNode = AddNode(Chain, true);
+	AddEdge(PreNode, PostNode);
+	for (int32 SubChainTail : SubChainTails)
+	{
+		AddEdge(SubChainTail, PostNode);
+	}
+	Chains.Add(Chain);
+
+	if (Chain->ChainState.NextChain)
+	{
+		return AddChainNodes(Chain->ChainState.NextChain, PostNode);
+	}
+	return PostNode;
+}
+
+int32 UPGChainScheduler::AddNode(UProcGeneratorChain* Chain, bool bIsPost)
+{
+	const FPGChainState& State = Chain->ChainState;
+
+	const int32 NodeIndex = Nodes.AddDefaulted();
+	FPGChainGraphNode& Node = Nodes[NodeIndex];
+	Node.Chain = Chain;
+	Node.bIsPost = bIsPost;
+
+	//Script implementations and bound events have to stay on the game thread
+	const bool bHasBoundEvent = bIsPost ? Chain->OnPostProcessChainEvent.IsBound() : Chain->OnPreProcessChainEvent.IsBound();
+	Node.bRunOnWorker = State.bThreadSafe && Chain->GetClass()->HasAnyClassFlags(CLASS_Native) && !bHasBoundEvent;
+
+	Node.Context = NewObject<UPGContextDataObject>(this);
+	NodeContexts.Add(Node.Context);
+
+	AddEdge(LastBarrier, NodeIndex);
+
+	//Undeclared: waits for everything before it and everything after waits for it
+	if (!State.bDeclaresContextKeys)
+	{
+		for (int32 PreviousNode : NodesSinceBarrier)
+		{
+			AddEdge(PreviousNode, NodeIndex);
+		}
+		NodesSinceBarrier.Reset();
+		LastWriter.Reset();
+		ReadersSinceWrite.Reset();
+		LastBarrier = NodeIndex;
+		return NodeIndex;
+	}
+
+	//Read after write
+	for (const FString& Key : State.ReadsContextKeys)
+	{
+		if (const int32* Writer = LastWriter.Find(Key))
+		{
+			AddEdge(*Writer, NodeIndex);
+		}
+		ReadersSinceWrite.FindOrAdd(Key).Add(NodeIndex);
+	}
+
+	//Write after write and write after read
+	for (const FString& Key : State.WritesContextKeys)
+	{
+		if (const int32* Writer = LastWriter.Find(Key))
+		{
+			AddEdge(*Writer, NodeIndex);
+		}
+		if (TArray<int32>* Readers = ReadersSinceWrite.Find(Key))
+		{
+			for (int32 Reader : *Readers)
+			{
+				AddEdge(Reader, NodeIndex);
+			}
+			Readers->Reset();
+		}
+		LastWriter.Add(Key, NodeIndex);
+	}
+
+	NodesSinceBarrier.Add(NodeIndex);
+	return NodeIndex;
+}
+
+void UPGChainScheduler::AddEdge(int32 FromNode, int32 ToNode)
+{
+	if (FromNode == INDEX_NONE || FromNode == ToNode)
+	{
+		return;
+	}
+	Nodes[ToNode].Prerequisites.AddUnique(FromNode);
+}
+
+void UPGChainScheduler::RunNode(int32 NodeIndex)
+{
+	if (bCancelled || bFailed)
+	{
+		return;
+	}
+
+	FPGChainGraphNode& Node = Nodes[NodeIndex];
+	UProcGeneratorChain* Chain = Node.Chain;
+	const FPGChainState& State = Chain->ChainState;
+	FPGContextData& NodeData = Node.Context->Context;
+
+	//StopLatentAction on the chain tree
+	if (!Chain->bShouldLatentStillRun)
+	{
+		bCancelled = true;
+		return;
+	}
+
+	//Declared chains only see their own keys
+	{
+		FScopeLock Lock(&ContextLock);
+		if (State.bDeclaresContextKeys)
+		{
+			NodeData = FPGContextData();
+			for (const FString& Key : State.ReadsContextKeys)
+			{
+				SyncContextKey(SharedContext, NodeData, Key);
+			}
+			for (const FString& Key : State.WritesContextKeys)
+			{
+				SyncContextKey(SharedContext, NodeData, Key);
+			}
+		}
+		else
+		{
+			NodeData = SharedContext;
+		}
+	}
+
+	if (bOutputDebugFlowLog)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Flow Graph step %d: %s %s"), NodeIndex, *Chain->GetName(), Node.bIsPost ? TEXT("post") : TEXT("pre"));
+	}
+
+	if (Node.bRunOnWorker)
+	{
+		//Native implementations are called directly, the BlueprintNativeEvent thunk would go through ProcessEvent
+		if (Node.bIsPost)
+		{
+			Chain->OnPostProcessChain_Implementation(Node.Context);
+		}
+		else
+		{
+			Chain->OnPreProcessChain_Implementation(Node.Context);
+		}
+
+		if (Chain->bHasPendingConcurrentError)
+		{
+			bFailed = true;
+			return;
+		}
+	}
+	else
+	{
+		Chain->ContextData = Node.Context;
+
+		if (Node.bIsPost)
+		{
+			Chain->UpdateStatus(EPGChainStatus::ProcessingPost);
+			Chain->OnPostProcessChain(Node.Context);
+			Chain->OnPostProcessChainEvent.ExecuteIfBound(Node.Context);
+		}
+		else
+		{
+			Chain->UpdateStatus(EPGChainStatus::ProcessingPre);
+			Chain->OnPreProcessChain(Node.Context);
+			Chain->OnPreProcessChainEvent.ExecuteIfBound(Node.Context);
+		}
+
+		if (Chain->IsStatusLatent())
+		{
+			Chain->ThrowError(TEXT("Latent chains can't be scheduled by UPGChainScheduler, use StartChainProcess."));
+		}
+
+		if (Chain->IsStatusError())
+		{
+			bFailed = true;
+			return;
+		}
+	}
+
+	{
+		FScopeLock Lock(&ContextLock);
+		if (State.bDeclaresContextKeys)
+		{
+			for (const FString& Key : State.WritesContextKeys)
+			{
+				SyncContextKey(NodeData, SharedContext, Key);
+			}
+		}
+		else
+		{
+			//Barriers run alone
+			SharedContext = NodeData;
+		}
+	}
+}
+
+void UPGChainScheduler::JoinGraph()
+{
+	for (UProcGeneratorChain* Chain : Chains)
+	{
+		Chain->bIsRunningConcurrently = false;
+		Chain->ContextData = TargetContext;
+	}
+
+	const bool bWasCancelled = bCancelled && !bFailed;
+	if (!bWasCancelled)
+	{
+		FScopeLock Lock(&ContextLock);
+		TargetContext->Context = SharedContext;
+	}
+
+	//Raise deferred worker errors from the game thread
+	UProcGeneratorChain* FailedChain = nullptr;
+	for (UProcGeneratorChain* Chain : Chains)
+	{
+		if (Chain->bHasPendingConcurrentError)
+		{
+			Chain->bHasPendingConcurrentError = false;
+			Chain->ThrowError(Chain->PendingConcurrentError);
+		}
+		if (!FailedChain && Chain->IsStatusError())
+		{
+			FailedChain = Chain;
+		}
+	}
+
+	if (FailedChain)
+	{
+		//Same as sequential processing, the root reports subchain errors
+		if (FailedChain != Root)
+		{
+			Root->ChainState.StatusMessage = FailedChain->ChainState.StatusMessage;
+			Root->UpdateStatus(EPGChainStatus::ErrorSubchain);
+		}
+		ResetGraph();
+		return;
+	}
+
+	if (bWasCancelled)
+	{
+		ResetGraph();
+		return;
+	}
+
+	//Finish in sequential order, subchains before parents
+	for (UProcGeneratorChain* Chain : Chains)
+	{
+		Chain->bShouldLatentStillRun = false;
+		Chain->OnChainFinished(TargetContext);
+		Chain->OnChainFinishedEvent.ExecuteIfBound(TargetContext);
+		Chain->UpdateStatus(EPGChainStatus::Done);
+	}
+
+	UPGContextDataObject* FinishedContext = TargetContext;
+	ResetGraph();
+
+	OnGraphFinished.Broadcast(FinishedContext);
+}
+
+void UPGChainScheduler::ResetGraph()
+{
+	Nodes.Reset();
+	NodeContexts.Reset();
+	Chains.Reset();
+	LastWriter.Reset();
+	ReadersSinceWrite.Reset();
+	NodesSinceBarrier.Reset();
+	LastBarrier = INDEX_NONE;
+	VisitedChains.Reset();
+	SharedContext = FPGContextData();
+	Root = nullptr;
+	TargetContext = nullptr;
+	bIsRunning = false;
+}
@@ -0,0 +1,149 @@
+#include "PGChainTracer.h"
+#include "Misc/FileHelper.h"
+#include "Misc/ScopeLock.h"
+#include "HAL/PlatformTLS.h"
+
+namespace
+{
+	//JSON string escaping, ReplaceCharWithEscapedChar produces C escapes like \' that JSON rejects
+	FString EscapeJsonString(const FString& Value)
+	{
+		FString Escaped;
+		Escaped.Reserve(Value.Len());
+		for (const TCHAR Char : Value)
+		{
+			switch (Char)
+			{
+			case TEXT('"'):		Escaped += TEXT("\\\""); break;
+			case TEXT('\\'):	Escaped += TEXT("\\\\"); break;
+			case TEXT('\n'):	Escaped += TEXT("\\n"); break;
+			case TEXT('\r'):	Escaped += TEXT("\\r"); break;
+			case TEXT('\t'):	Escaped += TEXT("\\t"); break;
+			default:
+				if (Char < 0x20)
+				{
+					Escaped += FString::Printf(TEXT("\\u%04x"), (uint32)Char);
+				}
+				else
+				{
+					Escaped.AppendChar(Char);
+				}
+			}
+		}
+		return Escaped;
+	}
+}
+
+FPGChainTracer::FPGChainTracer()
+{
+	bIsCapturing = false;
+}
+
+FPGChainTracer& FPGChainTracer::Get()
+{
+	static FPGChainTracer Tracer;
+	return Tracer;
+}
+
+void FPGChainTracer::StartCapture()
+{
+	FScopeLock Lock(&EventLock);
+	Events.Reset();
+	CaptureStartTime = FPlatformTime::Seconds();
+	bIsCapturing = true;
+}
+
+void FPGChainTracer::StopCapture()
+{
+	bIsCapturing = false;
+}
+
+bool FPGChainTracer::IsCapturing() const
+{
+	return bIsCapturing;
+}
+
+void FPGChainTracer::AddSpan(const FString& Name, const TCHAR* Category, double StartTime, double EndTime)
+{
+	AddEvent({ Name, Category, TEXT('X'), StartTime, EndTime - StartTime, FPlatformTLS::GetCurrentThreadId(), 0 });
+}
+
+void FPGChainTracer::AddAsyncBegin(const FString& Name, const TCHAR* Category, uint32 Id, double Time)
+{
+	AddEvent({ Name, Category, TEXT('b'), Time, 0.0, FPlatformTLS::GetCurrentThreadId(), Id });
+}
+
+void FPGChainTracer::AddAsyncEnd(const FString& Name, const TCHAR* Category, uint32 Id, double Time)
+{
+	AddEvent({ Name, Category, TEXT('e'), Time, 0.0, FPlatformTLS::GetCurrentThreadId(), Id });
+}
+
+void FPGChainTracer::AddInstant(const FString& Name, const TCHAR* Category, double Time)
+{
+	AddEvent({ Name, Category, TEXT('i'), Time, 0.0, FPlatformTLS::GetCurrentThreadId(), 0 });
+}
+
+int32 FPGChainTracer::NumEvents() const
+{
+	FScopeLock Lock(&EventLock);
+	return Events.Num();
+}
+
+void FPGChainTracer::AddEvent(FTraceEvent&& Event)
+{
+	if (!bIsCapturing)
+	{
+		return;
+	}
+
+	FScopeLock Lock(&EventLock);
+	Events.Add(MoveTemp(Event));
+}
+
+bool FPGChainTracer::ExportChromeTrace(const FString& FilePath) const
+{
+	FString Json = TEXT("{\"traceEvents\":[\n");
+
+	{
+		FScopeLock Lock(&EventLock);
+
+		for (int32 i = 0; i < Events.Num(); i++)
+		{
+			const FTraceEvent& Event = Events[i];
+
+			//Chrome trace times are microseconds
+			const double TimestampUs = (Event.Timestamp - CaptureStartTime) * 1000000.0;
+
+			Json += FString::Printf(TEXT("{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u"),
+				*EscapeJsonString(Event.Name),
+				*EscapeJsonString(Event.Category),
+				Event.Phase,
+				TimestampUs,
+				Event.ThreadId);
+
+			if (Event.Phase == TEXT('X'))
+			{
+				Json += FString::Printf(TEXT(",\"dur\":%.3f"), Event.Duration * 1000000.0);
+			}
+			else if (Event.Phase == TEXT('b') || Event.Phase == TEXT('e'))
+			{
+				Json += FString::Printf(TEXT(",\"id\":%u"), Event.Id);
+			}
+			else if (Event.Phase == TEXT('i'))
+			{
+				Json += TEXT(",\"s\":\"t\"");
+			}
+
+			Json += (i + 1 < Events.Num()) ? TEXT("},\n") : TEXT("}\n");
+		}
+	}
+
+	Json += TEXT("]}");
+
+	if (!FFileHelper::SaveStringToFile(Json, *FilePath, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FPGChainTracer::ExportChromeTrace failed to write %s"), *FilePath);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,281 @@
+#include "PatchDiskStore.h"
+#include "GUDataTypes.h"
+#include "Math/Float16.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/PlatformTLS.h"
+#include "Async/MappedFileHandle.h"
+
+namespace
+{
+	constexpr uint32 PatchFileMagic = 0x54504750;	//'PGPT'
+	constexpr uint16 PatchFileVersion = 1;
+
+	//Patches per region folder side, keeps directories small for large streamed worlds
+	constexpr int32 PatchRegionShift = 4;
+
+	//Touched whenever a params folder is selected, directory timestamps don't track use
+	const TCHAR* LastUsedMarker = TEXT("LastUsed.marker");
+
+	struct FPatchFileHeader
+	{
+		uint32 Magic;
+		uint16 Version;
+		uint8 Format;
+		uint8 Padding;
+		int32 NumSamples;
+		float MinValue;
+		float MaxValue;
+	};
+
+	int32 BytesPerSample(EPatchStoreFormat Format)
+	{
+		return Format == EPatchStoreFormat::Float32 ? 4 : 2;
+	}
+}
+
+FPatchDiskStore::FPatchDiskStore()
+{
+	Format = EPatchStoreFormat::Quantized16;
+	SetParamsHash(0);
+}
+
+void FPatchDiskStore::SetParamsHash(uint32 ParamsHash)
+{
+	Folder = RootFolder() + FString::Printf(TEXT("/%08x"), ParamsHash);
+}
+
+void FPatchDiskStore::SetFormat(EPatchStoreFormat InFormat)
+{
+	Format = InFormat;
+}
+
+FString FPatchDiskStore::RootFolder()
+{
+	//Same root as other proc gen caches
+	FPGCacheSettings Settings;
+	return Settings.CacheSavePath + TEXT("/TerrainPatches");
+}
+
+FString FPatchDiskStore::PatchPath(const FPatchKey& Key) const
+{
+	const int32 X = Key.GetX();
+	const int32 Y = Key.GetY();
+
+	return FString::Printf(TEXT("%s/%d_%d/%d_%d/%d_%d.patch"),
+		*Folder,
+		Key.GetFace(), Key.GetDepth(),
+		X >> PatchRegionShift, Y >> PatchRegionShift,
+		X, Y);
+}
+
+bool FPatchDiskStore::Write(const FPatchKey& Key, const TArray<float>& Heights) const
+{
+	FPatchFileHeader Header;
+	Header.Magic = PatchFileMagic;
+	Header.Version = PatchFileVersion;
+	Header.Format = (uint8)Format;
+	Header.Padding = 0;
+	Header.NumSamples = Heights.Num();
+	Header.MinValue = 0.f;
+	Header.MaxValue = 0.f;
+
+	if (Heights.Num() > 0)
+	{
+		Header.MinValue = FMath::Min(Heights);
+		Header.MaxValue = FMath::Max(Heights);
+	}
+
+	TArray<uint8> Bytes;
+	Bytes.SetNumUninitialized(sizeof(FPatchFileHeader) + int64(Heights.Num()) * BytesPerSample(Format));
+	FMemory::Memcpy(Bytes.GetData(), &Header, sizeof(FPatchFileHeader));
+	uint8* Samples = Bytes.GetData() + sizeof(FPatchFileHeader);
+
+	if (Format == EPatchStoreFormat::Float32)
+	{
+		FMemory::Memcpy(Samples, Heights.GetData(), Heights.Num() * sizeof(float));
+	}
+	else if (Format == EPatchStoreFormat::Float16)
+	{
+		FFloat16* Out = (FFloat16*)Samples;
+		for (int32 i = 0; i < Heights.Num(); i++)
+		{
+			Out[i] = FFloat16(Heights[i]);
+		}
+	}
+	else
+	{
+		const float Range = Header.MaxValue - Header.MinValue;
+		const float Scale = Range > 0.f ? 65535.f / Range : 0.f;
+
+		uint16* Out = (uint16*)Samples;
+		for (int32 i = 0; i < Heights.Num(); i++)
+		{
+			Out[i] = (uint16)FMath::Clamp(FMath::RoundToInt((Heights[i] - Header.MinValue) * Scale), 0, 65535);
+		}
+	}
+
+	//Write to a temp file and move, so a reader never maps a half written patch
+	const FString Path = PatchPath(Key);
+	const FString TempPath = Path + FString::Printf(TEXT(".%u.tmp"), FPlatformTLS::GetCurrentThreadId());
+
+	if (!FFileHelper::SaveArrayToFile(Bytes, *TempPath))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FPatchDiskStore::Write failed to write %s"), *TempPath);
+		return false;
+	}
+	if (!IFileManager::Get().Move(*Path, *TempPath, true, true, false, true))
+	{
+		IFileManager::Get().Delete(*TempPath, false, false, true);
+		return false;
+	}
+	return true;
+}
+
+bool FPatchDiskStore::Read(const FPatchKey& Key, TArray<float>& OutHeights, int32 ExpectedNum) const
+{
+	const FString Path = PatchPath(Key);
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	if (!PlatformFile.FileExists(*Path))
+	{
+		return false;
+	}
+
+	TUniquePtr<IMappedFileHandle> MappedFile(PlatformFile.OpenMapped(*Path));
+	if (MappedFile.IsValid())
+	{
+		TUniquePtr<IMappedFileRegion> Region(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+		if (Region.IsValid())
+		{
+			return Decode(Region->GetMappedPtr(), Region->GetMappedSize(), OutHeights, ExpectedNum);
+		}
+	}
+
+	//Platform without mapping support
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *Path, FILEREAD_Silent))
+	{
+		return false;
+	}
+	return Decode(Bytes.GetData(), Bytes.Num(), OutHeights, ExpectedNum);
+}
+
+bool FPatchDiskStore::Decode(const uint8* Bytes, int64 Size, TArray<float>& OutHeights, int32 ExpectedNum) const
+{
+	if (Size < (int64)sizeof(FPatchFileHeader))
+	{
+		return false;
+	}
+
+	FPatchFileHeader Header;
+	FMemory::Memcpy(&Header, Bytes, sizeof(FPatchFileHeader));
+
+	if (Header.Magic != PatchFileMagic || Header.Version != PatchFileVersion || Header.Format > (uint8)EPatchStoreFormat::Quantized16)
+	{
+		return false;
+	}
+	if (Header.NumSamples < 0 || (ExpectedNum > 0 && Header.NumSamples != ExpectedNum))
+	{
+		return false;
+	}
+
+	const EPatchStoreFormat FileFormat = (EPatchStoreFormat)Header.Format;
+	if (Size < (int64)sizeof(FPatchFileHeader) + int64(Header.NumSamples) * BytesPerSample(FileFormat))
+	{
+		return false;
+	}
+
+	const uint8* Samples = Bytes + sizeof(FPatchFileHeader);
+	OutHeights.SetNumUninitialized(Header.NumSamples);
+
+	if (FileFormat == EPatchStoreFormat::Float32)
+	{
+		FMemory::Memcpy(OutHeights.GetData(), Samples, Header.NumSamples * sizeof(float));
+	}
+	else if (FileFormat == EPatchStoreFormat::Float16)
+	{
+		const FFloat16* In = (const FFloat16*)Samples;
+		for (int32 i = 0; i < Header.NumSamples; i++)
+		{
+			OutHeights[i] = In[i].GetFloat();
+		}
+	}
+	else
+	{
+		const float Step = (Header.MaxValue - Header.MinValue) / 65535.f;
+
+		const uint16* In = (const uint16*)Samples;
+		for (int32 i = 0; i < Header.NumSamples; i++)
+		{
+			OutHeights[i] = Header.MinValue + In[i] * Step;
+		}
+	}
+	return true;
+}
+
+bool FPatchDiskStore::Contains(const FPatchKey& Key) const
+{
+	return FPlatformFileManager::Get().GetPlatformFile().FileExists(*PatchPath(Key));
+}
+
+void FPatchDiskStore::Clear() const
+{
+	IFileManager::Get().DeleteDirectory(*Folder, false, true);
+}
+
+void FPatchDiskStore::PurgeOldFolders(int32 MaxFolders) const
+{
+	IFileManager& FileManager = IFileManager::Get();
+
+	TArray<uint8> NoBytes;
+	FFileHelper::SaveArrayToFile(NoBytes, *(Folder / LastUsedMarker));
+
+	if (MaxFolders <= 0)
+	{
+		return;
+	}
+
+	struct FParamsFolder
+	{
+		FString Path;
+		FDateTime LastUsed;
+	};
+	TArray<FParamsFolder> OtherFolders;
+
+	const FString CurrentFolder = FPaths::GetCleanFilename(Folder);
+	TArray<FString> FolderNames;
+	FileManager.FindFiles(FolderNames, *(RootFolder() / TEXT("*")), false, true);
+	for (const FString& Name : FolderNames)
+	{
+		if (Name == CurrentFolder)
+		{
+			continue;
+		}
+		const FString Path = RootFolder() / Name;
+
+		//Folders from before markers existed count as oldest
+		FDateTime LastUsed = FileManager.GetTimeStamp(*(Path / LastUsedMarker));
+		if (LastUsed == FDateTime::MinValue())
+		{
+			LastUsed = FileManager.GetTimeStamp(*Path);
+		}
+		OtherFolders.Add({ Path, LastUsed });
+	}
+
+	const int32 NumToDelete = OtherFolders.Num() - (MaxFolders - 1);
+	if (NumToDelete <= 0)
+	{
+		return;
+	}
+
+	OtherFolders.Sort([](const FParamsFolder& A, const FParamsFolder& B)
+	{
+		return A.LastUsed < B.LastUsed;
+	});
+	for (int32 i = 0; i < NumToDelete; i++)
+	{
+		FileManager.DeleteDirectory(*OtherFolders[i].Path, false, true);
+	}
+}
@@ -1,6 +1,15 @@
 #include "ProcGeneratorChain.h"
 #include "GESDataTypes.h"
 #include "GlobalEventSystemBPLibrary.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Async/Async.h"
+#include "UObject/GarbageCollection.h"
+#include "Containers/Ticker.h"
+#include "PGChainResultCache.h"
+#include "Misc/SecureHash.h"
+#include "PGChainTracer.h"
+#include "PGChainRegistrySubsystem.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
 
 
 FPGChainState::FPGChainState()
@@ -11,6 +20,12 @@ FPGChainState::FPGChainState()
 	StatusMessage = TEXT("None.");
 	SubChainProcessingIndex = 0;
 	bParallelProcessSubchains = false;
+	bConcurrentProcessSubchains = false;
+	bThreadSafe = false;
+	bDeclaresContextKeys = false;
+	bCacheResults = false;
+	bIsPure = false;
+	bPersistCachedResults = true;
 	bOutputDebugFlowLog = false;
 }
 
@@ -21,6 +36,8 @@ UProcGeneratorChain::UProcGeneratorChain()
 	ChainState.Status = EPGChainStatus::Idle;
 	RemoveAllSubchains();
 	bShouldLatentStillRun = false;
+	bHasPendingConcurrentError = false;
+	bIsRunningConcurrently = false;
 }
 
 void UProcGeneratorChain::OnPreProcessChain_Implementation(UPGContextDataObject* Data)
@@ -54,6 +71,13 @@ void UProcGeneratorChain::LinkNextChain(UProcGeneratorChain* NextChainLink)
 	ChainState.NextChain->ChainState.PreviousChain = this;
 }
 
+void UProcGeneratorChain::DeclareContextKeys(const TArray<FString>& Reads, const TArray<FString>& Writes)
+{
+	ChainState.ReadsContextKeys = Reads;
+	ChainState.WritesContextKeys = Writes;
+	ChainState.bDeclaresContextKeys = true;
+}
+
 void UProcGeneratorChain::AddSubchain(UProcGeneratorChain* SubChain, int32 AtIndex /*= -1*/)
 {
 	SubChain->ChainState.ParentChain = this;
@@ -113,8 +137,8 @@ bool UProcGeneratorChain::StartChainProcess(UPGContextDataObject* InOutContextDa
 		//resumed either from pre or a latent subchain
 		else if (ChainState.LastLatentStatus == EPGChainStatus::ProcessingSubChains)
 		{
-			//Sequential case, parallel should fall straight through
-			if (!ChainState.bParallelProcessSubchains)
+			//Sequential case, parallel/concurrent should fall straight through
+			if (!ChainState.bParallelProcessSubchains && !ChainState.bConcurrentProcessSubchains)
 			{
 				//resume from last index. NB overflow index will resume instantly
 				UpdateStatus(EPGChainStatus::ProcessingSubChains);
@@ -138,8 +162,11 @@ bool UProcGeneratorChain::StartChainProcess(UPGContextDataObject* InOutContextDa
 			UpdateStatus(EPGChainStatus::ProcessingPost);
 
 			//Any processing after sub-chains
-			OnPostProcessChain(InOutContextData);
-			OnPostProcessChainEvent.ExecuteIfBound(InOutContextData);
+			{
+				TRACE_CPUPROFILER_EVENT_SCOPE_TEXT(*GetClass()->GetName());
+				OnPostProcessChain(InOutContextData);
+				OnPostProcessChainEvent.ExecuteIfBound(InOutContextData);
+			}
 
 			//Both cases are just false returns
 			if (ChainState.Status == EPGChainStatus::LatentResponse)
@@ -163,13 +190,25 @@ bool UProcGeneratorChain::StartChainProcess(UPGContextDataObject* InOutContextDa
 		ChainState.Status == EPGChainStatus::Idle)
 	{
 		//Instant/Fresh start branch
+		ResetCancellationToken();
+
+		//Inputs unchanged since a previous run, skip straight to finishing
+		PendingResultCacheKey.Empty();
+		if (ChainState.bCacheResults && IsSubtreePure() && TryApplyCachedResult(InOutContextData))
+		{
+			UpdateStatus(EPGChainStatus::Finishing);
+			return FinishChainProcess(InOutContextData);
+		}
 		
 		//PRE PROCESS
 		UpdateStatus(EPGChainStatus::ProcessingPre);
 
 		//Any processing before chains
-		OnPreProcessChain(InOutContextData);
-		OnPreProcessChainEvent.ExecuteIfBound(InOutContextData);
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE_TEXT(*GetClass()->GetName());
+			OnPreProcessChain(InOutContextData);
+			OnPreProcessChainEvent.ExecuteIfBound(InOutContextData);
+		}
 		//OnPreProcessTest.ExecuteIfBound(InOutContextData);
 
 		//Check latent callback/resume. 
@@ -202,8 +241,11 @@ bool UProcGeneratorChain::StartChainProcess(UPGContextDataObject* InOutContextDa
 		UpdateStatus(EPGChainStatus::ProcessingPost);
 
 		//Any processing after sub-chains
-		OnPostProcessChain(InOutContextData);
-		OnPostProcessChainEvent.ExecuteIfBound(InOutContextData);
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE_TEXT(*GetClass()->GetName());
+			OnPostProcessChain(InOutContextData);
+			OnPostProcessChainEvent.ExecuteIfBound(InOutContextData);
+		}
 
 		//Both cases are just false returns
 		if (ChainState.Status == EPGChainStatus::LatentResponse)
@@ -227,6 +269,16 @@ bool UProcGeneratorChain::StartChainProcess(UPGContextDataObject* InOutContextDa
 		return false;
 	}
 
+	if (!PendingResultCacheKey.IsEmpty())
+	{
+		StoreCachedResult(InOutContextData);
+	}
+
+	return FinishChainProcess(InOutContextData);
+}
+
+bool UProcGeneratorChain::FinishChainProcess(UPGContextDataObject* InOutContextData)
+{
 	bShouldLatentStillRun = false;
 
 	//In both cases we finish the same unless we've exited early. Latent is not allowed in Finished callback.
@@ -248,6 +300,13 @@ bool UProcGeneratorChain::StartChainProcess(UPGContextDataObject* InOutContextDa
 
 void UProcGeneratorChain::ResumeChainFromLatentResult()
 {
+	//Late results from stopped or expired runs
+	if (CancellationToken.IsValid() && CancellationToken->IsCancelled())
+	{
+		OnAsyncWorkCancelled();
+		return;
+	}
+
 	UpdateStatus(EPGChainStatus::ResumeLatent);
 
 	//Advance our processing state for latent resume
@@ -305,6 +364,15 @@ void UProcGeneratorChain::RequestJsChainByName(const FString& Name)
 void UProcGeneratorChain::ThrowError(const FString& ErrorMessage)
 {
 	bShouldLatentStillRun = false;
+
+	//Status changes broadcast to script, raise it from the game thread when the concurrent task is joined
+	if (bIsRunningConcurrently && !IsInGameThread())
+	{
+		PendingConcurrentError = ErrorMessage;
+		bHasPendingConcurrentError = true;
+		return;
+	}
+
 	ChainState.StatusMessage = ErrorMessage;
 	UpdateStatus(EPGChainStatus::ErrorCurrentChain);
 	
@@ -315,16 +383,133 @@ void UProcGeneratorChain::ThrowError(const FString& ErrorMessage)
 }
 
 void UProcGeneratorChain::StopLatentAction()
+{
+	CancelChainTree();
+
+	if (!CancellationToken.IsValid())
+	{
+		OnCancelAcknowledged.Broadcast(this);
+		return;
+	}
+
+	//Never block here, async work may itself be waiting on the game thread
+	TWeakObjectPtr<UProcGeneratorChain> WeakThis = this;
+	TSharedRef<FThreadSafeBool, ESPMode::ThreadSafe> bAcknowledged = MakeShared<FThreadSafeBool, ESPMode::ThreadSafe>(false);
+
+	CancellationToken->OnWorkDrained([WeakThis, bAcknowledged]
+	{
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, bAcknowledged]
+		{
+			*bAcknowledged = true;
+			if (WeakThis.IsValid())
+			{
+				WeakThis->OnCancelAcknowledged.Broadcast(WeakThis.Get());
+			}
+		});
+	});
+
+	//Only a warning for work that hangs, nothing waits on it
+	TWeakPtr<FPGCancellationToken, ESPMode::ThreadSafe> WeakToken = CancellationToken;
+	const float Timeout = ChainState.CancelAcknowledgeTimeout;
+	FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([WeakThis, WeakToken, bAcknowledged, Timeout](float DeltaTime)
+	{
+		TSharedPtr<FPGCancellationToken, ESPMode::ThreadSafe> Token = WeakToken.Pin();
+		if (!*bAcknowledged && Token.IsValid() && Token->NumActiveWork() > 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UProcGeneratorChain::StopLatentAction %d async work items of %s didn't acknowledge within %1.2fs"),
+				Token->NumActiveWork(),
+				WeakThis.IsValid() ? *WeakThis->GetName() : TEXT("<destroyed chain>"),
+				Timeout);
+		}
+		return false;
+	}), Timeout);
+}
+
+void UProcGeneratorChain::CancelChainTree()
 {
 	UpdateStatus(EPGChainStatus::Done);
 	bShouldLatentStillRun = false;
 
+	if (CancellationToken.IsValid())
+	{
+		CancellationToken->Cancel();
+	}
+
 	for (UProcGeneratorChain* Chain : ChainState.SubChains)
 	{
-		Chain->StopLatentAction();
+		Chain->CancelChainTree();
 	}
+}
+
+bool UProcGeneratorChain::IsCancellationRequested() const
+{
+	return CancellationToken.IsValid() && CancellationToken->IsCancelled();
+}
 
-	//Block wait for latent acknowledgment
+void UProcGeneratorChain::SetChainDeadline(float SecondsFromNow)
+{
+	GetCancellationToken()->SetTimeBudget(SecondsFromNow);
+}
+
+FPGCancellationTokenRef UProcGeneratorChain::GetCancellationToken()
+{
+	if (!CancellationToken.IsValid())
+	{
+		ResetCancellationToken();
+	}
+	return CancellationToken.ToSharedRef();
+}
+
+void UProcGeneratorChain::ResetCancellationToken()
+{
+	//Anything still running from a previous run is stale
+	if (CancellationToken.IsValid())
+	{
+		CancellationToken->Cancel();
+	}
+
+	TSharedPtr<FPGCancellationToken, ESPMode::ThreadSafe> ParentToken;
+	if (ChainState.ParentChain)
+	{
+		ParentToken = ChainState.ParentChain->CancellationToken;
+	}
+
+	CancellationToken = MakeShared<FPGCancellationToken, ESPMode::ThreadSafe>(ParentToken);
+	CancellationToken->SetTimeBudget(ChainState.TimeBudgetSeconds);
+}
+
+void UProcGeneratorChain::OnAsyncWorkCancelled()
+{
+	//Explicit stops already moved us out of latent, only expired runs still wait
+	if (CancellationToken.IsValid() && CancellationToken->HasDeadlinePassed() && IsStatusLatent())
+	{
+		ThrowError(FString::Printf(TEXT("%s exceeded its time budget, abandoned."), *GetName()));
+	}
+}
+
+void UProcGeneratorChain::StartChainTraceCapture()
+{
+	FPGChainTracer::Get().StartCapture();
+}
+
+bool UProcGeneratorChain::StopChainTraceCapture(const FString& FilePath)
+{
+	FPGChainTracer& Tracer = FPGChainTracer::Get();
+	Tracer.StopCapture();
+
+	const FString OutputPath = FilePath.IsEmpty() ? FPaths::Combine(FPaths::ProfilingDir(), TEXT("ProcGenChains.json")) : FilePath;
+	if (!Tracer.ExportChromeTrace(OutputPath))
+	{
+		return false;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("UProcGeneratorChain::StopChainTraceCapture wrote %d events to %s"), Tracer.NumEvents(), *OutputPath);
+	return true;
+}
+
+void UProcGeneratorChain::ClearChainResultCache(bool bIncludeDisk /*= false*/)
+{
+	FPGChainResultCache::Get().Clear(bIncludeDisk);
 }
 
 bool UProcGeneratorChain::IsStatusError()
@@ -350,40 +535,29 @@ void UProcGeneratorChain::SetActorValue(UPGContextDataObject* Data, const FStrin
 
 void UProcGeneratorChain::RequestJsChainByNameLambdaCallback(const FString& Name, TFunction<void(UProcGeneratorChain*)> ReceivingLambda)
 {
-	FGESEventContext ReplyContext;
-	ReplyContext.Domain = TEXT("Procedural");
-	ReplyContext.Event = TEXT("RequestJsCallback"); //unique id? shouldn't need it should call back on same thread immediately
-	ReplyContext.WorldContext = this;
-
-	FString Id = FGESHandler::DefaultHandler()->AddLambdaListener(ReplyContext, [this, Name, ReceivingLambda](UObject* FoundChain)
+	//Registry clones cached templates natively, script is only asked on the first request per name
+	UPGChainRegistrySubsystem* Registry = UPGChainRegistrySubsystem::Get(this);
+	if (Registry)
 	{
-		UE_LOG(LogTemp, Log, TEXT("Received %s"), *Name);
-
-		UProcGeneratorChain* ValidChain = Cast<UProcGeneratorChain>(FoundChain);
-		if (ValidChain)
-		{
-			UE_LOG(LogTemp, Log, TEXT("Valid Chain %s"), *Name);
-
-			if (ReceivingLambda)
-			{
-				UE_LOG(LogTemp, Log, TEXT("Calling Lambda with chain %s"), *Name);
-				ReceivingLambda(ValidChain);
-			}
-		}
-	});
-
-	FGESEmitContext EmitContext;
-	EmitContext.Domain = ReplyContext.Domain;
-	EmitContext.Event = TEXT("RequestJsChainByName");
-	EmitContext.WorldContext = this;
-
-	FGESHandler::DefaultHandler()->EmitEvent(EmitContext, Name);
+		Registry->RequestChainByName(Name, this, ReceivingLambda);
+		return;
+	}
 
-	FGESHandler::DefaultHandler()->RemoveLambdaListener(ReplyContext, Id);
+	UProcGeneratorChain* ValidChain = UPGChainRegistrySubsystem::FetchChainFromScript(Name, this);
+	if (ValidChain && ReceivingLambda)
+	{
+		ReceivingLambda(ValidChain);
+	}
 }
 
 void UProcGeneratorChain::SendIntermediateResult(UPGContextDataObject* Data, const FString& ContextMessage)
 {
+	ChainState.Timings.IntermediateResults++;
+	if (FPGChainTracer::Get().IsCapturing())
+	{
+		FPGChainTracer::Get().AddInstant(GetName() + TEXT(" ") + ContextMessage, TEXT("result"), FPlatformTime::Seconds());
+	}
+
 	//Notify self
 	OnIntermediateResult.Broadcast(Data, ContextMessage, this);
 
@@ -403,6 +577,11 @@ void UProcGeneratorChain::SendIntermediateResult(UPGContextDataObject* Data, con
 //Protected
 bool UProcGeneratorChain::ProcessSubChains(int32 StartIndex /*=0*/)
 {
+	if (ChainState.bConcurrentProcessSubchains)
+	{
+		return ProcessSubChainsConcurrently(StartIndex);
+	}
+
 	//Reset subchain tracking index
 	ChainState.SubChainProcessingIndex = StartIndex;
 
@@ -486,6 +665,377 @@ bool UProcGeneratorChain::ProcessSubChains(int32 StartIndex /*=0*/)
 	}
 }
 
+bool UProcGeneratorChain::CanRunConcurrently() const
+{
+	//Script implementations and external events have to stay on the game thread.
+	//Subchains/latent flows need the status machine, so only synchronous leaf chains qualify.
+	return ChainState.bThreadSafe &&
+		GetClass()->HasAnyClassFlags(CLASS_Native) &&
+		ChainState.SubChains.Num() == 0 &&
+		!OnPreProcessChainEvent.IsBound() &&
+		!OnPostProcessChainEvent.IsBound();
+}
+
+bool UProcGeneratorChain::ProcessSubChainsConcurrently(int32 StartIndex)
+{
+	ChainState.SubChainProcessingIndex = StartIndex;
+
+	int32 SubchainInstantCount = 0;
+	bool bSubchainError = false;
+	FGraphEventArray PostTasks;
+
+	for (int32 i = ChainState.SubChainProcessingIndex; i < ChainState.SubChains.Num(); i++)
+	{
+		UProcGeneratorChain* SubChain = ChainState.SubChains[i];
+
+		if (SubChain->CanRunConcurrently())
+		{
+			//Each task works on its own copy, copies are merged back in subchain order at join
+			UPGContextDataObject* TaskContext = NewObject<UPGContextDataObject>(this);
+			TaskContext->Context = ContextData->Context;
+			ConcurrentContexts.Add(TaskContext);
+			ConcurrentSubChains.Add(SubChain);
+
+			SubChain->ContextData = TaskContext;
+			SubChain->bShouldLatentStillRun = true;
+			SubChain->bHasPendingConcurrentError = false;
+			SubChain->PendingConcurrentError.Empty();
+			SubChain->bIsRunningConcurrently = true;
+			SubChain->OnChainStatusChanged.AddUniqueDynamic(this, &UProcGeneratorChain::UpdateSubChainProgress);
+			SubChain->UpdateStatus(EPGChainStatus::ProcessingPre);
+
+			//Native implementations are called directly, the BlueprintNativeEvent thunk would go through ProcessEvent.
+			//The tasks mutate the UPROPERTY maps of TaskContext, so GC is held off while each one runs; reference
+			//collection would otherwise walk those maps mid-rehash. Between pre and post nothing touches the context
+			FGraphEventRef PreTask = FFunctionGraphTask::CreateAndDispatchWhenReady([SubChain, TaskContext]()
+			{
+				FGCScopeGuard GCGuard;
+				SubChain->OnPreProcessChain_Implementation(TaskContext);
+			}, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+
+			//Leaf chain, so post only depends on its own pre
+			FGraphEventArray PostPrerequisites;
+			PostPrerequisites.Add(PreTask);
+
+			PostTasks.Add(FFunctionGraphTask::CreateAndDispatchWhenReady([SubChain, TaskContext]()
+			{
+				if (!SubChain->bHasPendingConcurrentError)
+				{
+					FGCScopeGuard GCGuard;
+					SubChain->OnPostProcessChain_Implementation(TaskContext);
+				}
+			}, TStatId(), &PostPrerequisites, ENamedThreads::AnyBackgroundThreadNormalTask));
+			continue;
+		}
+
+		//Everything else is processed on the game thread as in parallel mode, while the tasks run
+		bool bValidInstantResponse = SubChain->StartChainProcess(ContextData);
+
+		if (SubChain->IsStatusError())
+		{
+			ChainState.StatusMessage = SubChain->ChainState.StatusMessage;
+			UpdateStatus(EPGChainStatus::ErrorSubchain);
+			bSubchainError = true;
+			break;
+		}
+
+		if (bValidInstantResponse)
+		{
+			SubchainInstantCount++;
+		}
+		else
+		{
+			SubChain->OnChainStatusChanged.AddUniqueDynamic(this, &UProcGeneratorChain::UpdateSubChainProgress);
+		}
+	}
+
+	if (PostTasks.Num() > 0)
+	{
+		TWeakObjectPtr<UProcGeneratorChain> WeakThis = this;
+		FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis]()
+		{
+			if (WeakThis.IsValid())
+			{
+				WeakThis->JoinConcurrentSubChains();
+			}
+		}, TStatId(), &PostTasks, ENamedThreads::GameThread);
+	}
+
+	//In-flight tasks still get joined, but won't resume us
+	if (bSubchainError)
+	{
+		return false;
+	}
+
+	//check if everything was instant, concurrent chains always finish at join
+	if (SubchainInstantCount != ChainState.SubChains.Num() - StartIndex)
+	{
+		UpdateStatus(EPGChainStatus::LatentResponse);
+		return false;
+	}
+	return true;
+}
+
+void UProcGeneratorChain::JoinConcurrentSubChains()
+{
+	TArray<UProcGeneratorChain*> JoinedChains = MoveTemp(ConcurrentSubChains);
+	ConcurrentSubChains.Reset();
+
+	for (UProcGeneratorChain* SubChain : JoinedChains)
+	{
+		UPGContextDataObject* TaskContext = SubChain->ContextData;
+		SubChain->ContextData = ContextData;
+		SubChain->bIsRunningConcurrently = false;
+
+		//Stopped while in flight
+		if (!SubChain->bShouldLatentStillRun && !SubChain->bHasPendingConcurrentError)
+		{
+			continue;
+		}
+
+		//Errors propagate to us through UpdateSubChainProgress
+		if (SubChain->bHasPendingConcurrentError)
+		{
+			SubChain->bHasPendingConcurrentError = false;
+			SubChain->ThrowError(SubChain->PendingConcurrentError);
+			continue;
+		}
+
+		//Merge in subchain order so results are deterministic
+		ContextData->Context.AppendData(TaskContext->Context);
+
+		SubChain->UpdateStatus(EPGChainStatus::Finishing);
+		SubChain->FinishChainProcess(ContextData);
+	}
+
+	ConcurrentContexts.Reset();
+}
+
+bool UProcGeneratorChain::TryApplyCachedResult(UPGContextDataObject* InOutContextData)
+{
+	//Edits to a script we can't identify would be served stale results
+	TArray<FString> ScriptHashes;
+	if (!CollectSubtreeScriptHashes(ScriptHashes))
+	{
+		if (ChainState.bOutputDebugFlowLog)
+		{
+			UE_LOG(LogTemp, Log, TEXT("Flow Cache skipped for %s, a script chain in it has no ScriptSourcePath/ScriptSourceHash"), *GetName());
+		}
+		return false;
+	}
+
+	const FString Key = ComputeResultCacheKey(InOutContextData->Context);
+
+	FPGChainCachedResult Cached;
+	if (FPGChainResultCache::Get().Find(Key, ChainState.bPersistCachedResults, Cached))
+	{
+		if (Cached.ApplyTo(InOutContextData->Context))
+		{
+			if (ChainState.bOutputDebugFlowLog)
+			{
+				UE_LOG(LogTemp, Log, TEXT("Flow Cache hit for %s (%s)"), *GetName(), *Key);
+			}
+			return true;
+		}
+
+		//Referenced objects are gone, regenerate
+		FPGChainResultCache::Get().Remove(Key);
+	}
+
+	PendingResultCacheKey = Key;
+	PendingScriptHashes = MoveTemp(ScriptHashes);
+	CacheInputSnapshot = InOutContextData->Context;
+	return false;
+}
+
+void UProcGeneratorChain::StoreCachedResult(UPGContextDataObject* InOutContextData)
+{
+	//Only declared writes are captured so parallel siblings' writes don't leak into our entry
+	TSet<FString> WrittenKeys;
+	if (!CollectSubtreeContextKeys(true, WrittenKeys))
+	{
+		WrittenKeys.Reset();
+	}
+
+	FPGChainCachedResult Result = FPGChainCachedResult::FromContextChange(CacheInputSnapshot, InOutContextData->Context, WrittenKeys);
+	Result.ScriptHashes = MoveTemp(PendingScriptHashes);
+	FPGChainResultCache::Get().Store(PendingResultCacheKey, Result, ChainState.bPersistCachedResults);
+
+	PendingResultCacheKey.Empty();
+	PendingScriptHashes.Reset();
+	CacheInputSnapshot = FPGContextData();
+}
+
+FString UProcGeneratorChain::ComputeResultCacheKey(const FPGContextData& Input) const
+{
+	FString Source;
+	AppendCacheParameters(Source);
+
+	TSet<FString> ReadKeys;
+	const bool bAllDeclared = CollectSubtreeContextKeys(false, ReadKeys);
+
+	//Sorted so map ordering doesn't change the key
+	TArray<FString> Keys;
+	if (bAllDeclared)
+	{
+		Keys = ReadKeys.Array();
+	}
+	else
+	{
+		Input.StringMap.GetKeys(Keys);
+		for (const TPair<FString, UObject*>& Pair : Input.ObjectMap)
+		{
+			Keys.AddUnique(Pair.Key);
+		}
+		for (const TPair<FString, AActor*>& Pair : Input.ActorMap)
+		{
+			Keys.AddUnique(Pair.Key);
+		}
+
+		TArray<FName> BlackboardKeys;
+		Input.Blackboard.GetKeys(BlackboardKeys);
+		for (const FName& BlackboardKey : BlackboardKeys)
+		{
+			Keys.AddUnique(BlackboardKey.ToString());
+		}
+	}
+	Keys.Sort();
+
+	for (const FString& Key : Keys)
+	{
+		const FString* StringValue = Input.StringMap.Find(Key);
+		UObject* const* ObjectValue = Input.ObjectMap.Find(Key);
+		AActor* const* ActorValue = Input.ActorMap.Find(Key);
+		const FPGBlackboardValue* BlackboardValue = Input.Blackboard.Find(FName(*Key));
+
+		Source += FString::Printf(TEXT("|%s=%s;%s;%s;%u"), *Key,
+			StringValue ? **StringValue : TEXT(""),
+			(ObjectValue && *ObjectValue) ? *(*ObjectValue)->GetPathName() : TEXT(""),
+			(ActorValue && *ActorValue) ? *(*ActorValue)->GetPathName() : TEXT(""),
+			BlackboardValue ? BlackboardValue->GetContentHash() : 0);
+	}
+
+	FTCHARToUTF8 Utf8Source(*Source);
+	FSHAHash Hash;
+	FSHA1::HashBuffer(Utf8Source.Get(), Utf8Source.Length(), Hash.Hash);
+	return Hash.ToString();
+}
+
+void UProcGeneratorChain::AppendCacheParameters(FString& OutSource) const
+{
+	OutSource += GetClass()->GetPathName();
+
+	//Script chains keep their class path across edits, their source content tells them apart
+	const FString ScriptHash = GetScriptSourceHash();
+	if (!ScriptHash.IsEmpty())
+	{
+		OutSource += TEXT("|Script=") + ScriptHash;
+	}
+
+	//Parameters are the subclass' own properties; base chain state, delegates and transient data are excluded
+	for (TFieldIterator<FProperty> It(GetClass()); It; ++It)
+	{
+		FProperty* Property = *It;
+		if (Property->GetOwnerClass() == UProcGeneratorChain::StaticClass() ||
+			Property->HasAnyPropertyFlags(CPF_Transient) ||
+			Property->IsA<FDelegateProperty>() ||
+			Property->IsA<FMulticastDelegateProperty>())
+		{
+			continue;
+		}
+
+		for (int32 ArrayIndex = 0; ArrayIndex < Property->ArrayDim; ArrayIndex++)
+		{
+			FString Value;
+			Property->ExportTextItem_Direct(Value, Property->ContainerPtrToValuePtr<void>(this, ArrayIndex), nullptr, nullptr, PPF_None);
+			OutSource += FString::Printf(TEXT("|%s=%s"), *Property->GetName(), *Value);
+		}
+	}
+
+	//Skipping us skips our subchains, so they're part of our key
+	OutSource += TEXT("|Sub[");
+	for (UProcGeneratorChain* SubChain : ChainState.SubChains)
+	{
+		if (SubChain)
+		{
+			SubChain->AppendCacheParameters(OutSource);
+		}
+		OutSource += TEXT(",");
+	}
+	OutSource += TEXT("]");
+}
+
+bool UProcGeneratorChain::CollectSubtreeContextKeys(bool bWrites, TSet<FString>& OutKeys) const
+{
+	if (!ChainState.bDeclaresContextKeys)
+	{
+		return false;
+	}
+
+	OutKeys.Append(bWrites ? ChainState.WritesContextKeys : ChainState.ReadsContextKeys);
+
+	for (UProcGeneratorChain* SubChain : ChainState.SubChains)
+	{
+		if (SubChain && !SubChain->CollectSubtreeContextKeys(bWrites, OutKeys))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool UProcGeneratorChain::IsSubtreePure() const
+{
+	if (!ChainState.bIsPure)
+	{
+		return false;
+	}
+
+	for (UProcGeneratorChain* SubChain : ChainState.SubChains)
+	{
+		if (SubChain && !SubChain->IsSubtreePure())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+FString UProcGeneratorChain::GetScriptSourceHash() const
+{
+	if (!ChainState.ScriptSourceHash.IsEmpty())
+	{
+		return ChainState.ScriptSourceHash;
+	}
+	if (!ChainState.ScriptSourcePath.IsEmpty())
+	{
+		return FPGChainResultCache::Get().GetScriptFileHash(ChainState.ScriptSourcePath);
+	}
+	return FString();
+}
+
+bool UProcGeneratorChain::CollectSubtreeScriptHashes(TArray<FString>& OutHashes) const
+{
+	const FString ScriptHash = GetScriptSourceHash();
+	if (!ScriptHash.IsEmpty())
+	{
+		OutHashes.AddUnique(ScriptHash);
+	}
+	else if (!GetClass()->HasAnyClassFlags(CLASS_Native))
+	{
+		return false;
+	}
+
+	for (UProcGeneratorChain* SubChain : ChainState.SubChains)
+	{
+		if (SubChain && !SubChain->CollectSubtreeScriptHashes(OutHashes))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
 void UProcGeneratorChain::ProcessNextChain()
 {
 	if (ChainState.NextChain != nullptr)
@@ -499,9 +1049,15 @@ void UProcGeneratorChain::UpdateSubChainProgress(EPGChainStatus Status, UProcGen
 	//If we're latent...
 	if (ChainState.Status == EPGChainStatus::LatentResponse)
 	{
-		if (Status == EPGChainStatus::Done)
+		if (Status == EPGChainStatus::ErrorCurrentChain || Status == EPGChainStatus::ErrorSubchain)
+		{
+			//Latent/concurrent subchain failed after we started waiting on it
+			ChainState.StatusMessage = Chain->ChainState.StatusMessage;
+			UpdateStatus(EPGChainStatus::ErrorSubchain);
+		}
+		else if (Status == EPGChainStatus::Done)
 		{
-			if (ChainState.bParallelProcessSubchains)
+			if (ChainState.bParallelProcessSubchains || ChainState.bConcurrentProcessSubchains)
 			{
 				//Check if all parallel subchains finished
 				int32 FinishedCount = 0;
@@ -540,6 +1096,8 @@ void UProcGeneratorChain::UpdateSubChainProgress(EPGChainStatus Status, UProcGen
 
 void UProcGeneratorChain::UpdateStatus(EPGChainStatus NewStatus)
 {
+	RecordStatusTiming(ChainState.Status, NewStatus);
+
 	ChainState.Status = NewStatus;
 	if (NewStatus != EPGChainStatus::LatentResponse &&
 		NewStatus != EPGChainStatus::ResumeLatent)
@@ -559,6 +1117,102 @@ void UProcGeneratorChain::UpdateStatus(EPGChainStatus NewStatus)
 	}
 }
 
+void UProcGeneratorChain::RecordStatusTiming(EPGChainStatus OldStatus, EPGChainStatus NewStatus)
+{
+	auto IsIdleStatus = [](EPGChainStatus Status)
+	{
+		return Status == EPGChainStatus::Idle ||
+			Status == EPGChainStatus::Done ||
+			Status == EPGChainStatus::ErrorSubchain ||
+			Status == EPGChainStatus::ErrorCurrentChain;
+	};
+
+	const bool bWasIdle = IsIdleStatus(OldStatus);
+	const bool bIsIdle = IsIdleStatus(NewStatus);
+	if (bWasIdle && bIsIdle)
+	{
+		return;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	FPGChainTimings& Timings = ChainState.Timings;
+
+	//New run
+	if (bWasIdle)
+	{
+		Timings = FPGChainTimings();
+		RunStartTime = Now;
+		StatusStartTime = Now;
+		return;
+	}
+
+	FPGChainTracer& Tracer = FPGChainTracer::Get();
+	const float Elapsed = Now - StatusStartTime;
+	const TCHAR* PhaseName = nullptr;
+
+	switch (OldStatus)
+	{
+	case EPGChainStatus::ProcessingPre:
+		Timings.PreSeconds += Elapsed;
+		PhaseName = TEXT("Pre");
+		break;
+	case EPGChainStatus::ProcessingSubChains:
+		Timings.SubChainsSeconds += Elapsed;
+		PhaseName = TEXT("SubChains");
+		break;
+	case EPGChainStatus::ProcessingPost:
+		Timings.PostSeconds += Elapsed;
+		PhaseName = TEXT("Post");
+		break;
+	case EPGChainStatus::Finishing:
+		Timings.FinishSeconds += Elapsed;
+		PhaseName = TEXT("Finish");
+		break;
+	case EPGChainStatus::LatentResponse:
+		Timings.LatentWaitSeconds += Elapsed;
+		if (Tracer.IsCapturing())
+		{
+			Tracer.AddAsyncEnd(GetName() + TEXT(" Latent"), TEXT("latent"), GetUniqueID(), Now);
+		}
+		break;
+	default:
+		break;
+	}
+	Timings.ActiveSeconds = Timings.PreSeconds + Timings.PostSeconds + Timings.FinishSeconds;
+
+	if (Tracer.IsCapturing())
+	{
+		if (PhaseName)
+		{
+			Tracer.AddSpan(GetName() + TEXT(" ") + PhaseName, TEXT("chain"), StatusStartTime, Now);
+		}
+		if (NewStatus == EPGChainStatus::LatentResponse)
+		{
+			Tracer.AddAsyncBegin(GetName() + TEXT(" Latent"), TEXT("latent"), GetUniqueID(), Now);
+		}
+	}
+	StatusStartTime = Now;
+
+	if (bIsIdle)
+	{
+		Timings.WallSeconds = Now - RunStartTime;
+
+		if (ChainState.bOutputDebugFlowLog)
+		{
+			UE_LOG(LogTemp, Log, TEXT("Flow Timing %s: wall %1.2fms, active %1.2fms (pre %1.2f, post %1.2f, finish %1.2f), subchains %1.2fms, latent %1.2fms, %d results"),
+				*GetName(),
+				Timings.WallSeconds * 1000.f,
+				Timings.ActiveSeconds * 1000.f,
+				Timings.PreSeconds * 1000.f,
+				Timings.PostSeconds * 1000.f,
+				Timings.FinishSeconds * 1000.f,
+				Timings.SubChainsSeconds * 1000.f,
+				Timings.LatentWaitSeconds * 1000.f,
+				Timings.IntermediateResults);
+		}
+	}
+}
+
 //Log Proc Chain Example
 
 void ULogProcGeneratorChain::OnPreProcessChain_Implementation(UPGContextDataObject* Data)
@@ -591,4 +1245,80 @@ void FPGContextData::AppendData(FPGContextData& Other)
 	ActorMap.Append(Other.ActorMap);
 	ObjectMap.Append(Other.ObjectMap);
 	StringMap.Append(Other.StringMap);
+	Blackboard.Append(Other.Blackboard);
+}
+
+void UPGContextDataObject::SetBlackboardFloat(FName Key, float Value)
+{
+	Context.Blackboard.SetFloat(Key, Value);
+}
+
+bool UPGContextDataObject::GetBlackboardFloat(FName Key, float& OutValue) const
+{
+	return Context.Blackboard.GetFloat(Key, OutValue);
+}
+
+void UPGContextDataObject::SetBlackboardInt(FName Key, int32 Value)
+{
+	Context.Blackboard.SetInt(Key, Value);
+}
+
+bool UPGContextDataObject::GetBlackboardInt(FName Key, int32& OutValue) const
+{
+	return Context.Blackboard.GetInt(Key, OutValue);
+}
+
+void UPGContextDataObject::SetBlackboardVector(FName Key, const FVector& Value)
+{
+	Context.Blackboard.SetVector(Key, Value);
+}
+
+bool UPGContextDataObject::GetBlackboardVector(FName Key, FVector& OutValue) const
+{
+	return Context.Blackboard.GetVector(Key, OutValue);
+}
+
+void UPGContextDataObject::SetBlackboardTransform(FName Key, const FTransform& Value)
+{
+	Context.Blackboard.SetTransform(Key, Value);
+}
+
+bool UPGContextDataObject::GetBlackboardTransform(FName Key, FTransform& OutValue) const
+{
+	return Context.Blackboard.GetTransform(Key, OutValue);
+}
+
+void UPGContextDataObject::SetBlackboardObject(FName Key, UObject* Value)
+{
+	Context.Blackboard.SetObject(Key, Value);
+}
+
+UObject* UPGContextDataObject::GetBlackboardObject(FName Key) const
+{
+	return Context.Blackboard.GetObject(Key);
+}
+
+void UPGContextDataObject::SetBlackboardFloatArray(FName Key, const TArray<float>& Values)
+{
+	Context.Blackboard.SetFloatArray(Key, Values);
+}
+
+TArray<float> UPGContextDataObject::GetBlackboardFloatArray(FName Key) const
+{
+	return Context.Blackboard.GetFloatArray(Key);
+}
+
+void UPGContextDataObject::SetBlackboardTransformArray(FName Key, const TArray<FTransform>& Values)
+{
+	Context.Blackboard.SetTransformArray(Key, Values);
+}
+
+TArray<FTransform> UPGContextDataObject::GetBlackboardTransformArray(FName Key) const
+{
+	return Context.Blackboard.GetTransformArray(Key);
+}
+
+EPGBlackboardType UPGContextDataObject::GetBlackboardType(FName Key) const
+{
+	return Context.Blackboard.GetType(Key);
 }
@@ -1,5 +1,7 @@
 #include "ProceduralChainComponent.h"
 #include "GESHandler.h"
+#include "PGChainRegistrySubsystem.h"
+#include "PGChainResultCache.h"
 
 
 // Sets default values for this component's properties
@@ -7,6 +9,7 @@ UProceduralChainComponent::UProceduralChainComponent(const FObjectInitializer& i
 {
 	PrimaryComponentTick.bCanEverTick = false;
 	MainChain = CreateDefaultSubobject<UProcGeneratorChain>(TEXT("MainChain"));
+	ChainScheduler = CreateDefaultSubobject<UPGChainScheduler>(TEXT("ChainScheduler"));
 
 	MainChain->OnPreProcessChainEvent.BindDynamic(this, &UProceduralChainComponent::OnPre);
 	MainChain->OnPostProcessChainEvent.BindDynamic(this, &UProceduralChainComponent::OnPost);
@@ -26,6 +29,7 @@ UProceduralChainComponent::UProceduralChainComponent(const FObjectInitializer& i
 	bWaitForJsChainsBeforeStart = true;
 	bListenForJsReload = true;
 	bProcessSubchainsInParallel = false;
+	bUseChainScheduler = false;
 	bDebugLogFlow = false;
 	bRunChainInConstruction = false;
 }
@@ -44,9 +48,16 @@ void UProceduralChainComponent::BeginPlay()
 		FGESHandler::DefaultHandler()->AddLambdaListener(Context, [this]
 		{
 			UE_LOG(LogTemp, Log, TEXT("UProceduralChainComponent js reload received for %s"), *this->GetName());
-			
+
+			//Listener order isn't guaranteed, make sure we don't restart from stale templates or results
+			if (UPGChainRegistrySubsystem* Registry = UPGChainRegistrySubsystem::Get(this))
+			{
+				Registry->InvalidateCache();
+			}
+			FPGChainResultCache::Get().OnScriptsReloaded();
+
 			ResetChains();
-			MainChain->StartChainProcessWithCurrentData();
+			StartMainChain();
 		});
 	}
 
@@ -72,6 +83,7 @@ void UProceduralChainComponent::BeginPlay()
 void UProceduralChainComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
 	MainChain->StopLatentAction();
+	ChainScheduler->Cancel();
 
 	FGESHandler::DefaultHandler()->RemoveAllListenersForReceiver(this);
 
@@ -140,7 +152,7 @@ void UProceduralChainComponent::AddJsChainByName(FString JsClassName, EPGChainOr
 
 void UProceduralChainComponent::StartChain()
 {
-	MainChain->StartChainProcessWithCurrentData();
+	StartMainChain();
 }
 
 void UProceduralChainComponent::SetResponseAsLatent()
@@ -168,6 +180,7 @@ void UProceduralChainComponent::EditorStartChain()
 void UProceduralChainComponent::CleanupChain()
 {
 	MainChain->StopLatentAction();
+	ChainScheduler->Cancel();
 	OnResultCleanup.Broadcast(MainChain->ContextData);
 	bIsInitialized = false;
 }
@@ -238,6 +251,7 @@ void UProceduralChainComponent::Initialize()
 		//Sync options
 		MainChain->ChainState.bParallelProcessSubchains = bProcessSubchainsInParallel;
 		MainChain->ChainState.bOutputDebugFlowLog = bDebugLogFlow;
+		ChainScheduler->bOutputDebugFlowLog = bDebugLogFlow;
 		bIsInitialized = true;
 
 		//only initialize if we don't listen for Js reloads
@@ -247,7 +261,7 @@ void UProceduralChainComponent::Initialize()
 
 			if (bAutoStartChain)
 			{
-				MainChain->StartChainProcessWithCurrentData();
+				StartMainChain();
 			}
 		}
 	}
@@ -258,7 +272,20 @@ void UProceduralChainComponent::ResetChains()
 	//Clear
 	MainChain->RemoveAllSubchains();
 	MainChain->StopLatentAction();
+	ChainScheduler->Cancel();
 	
 	//Setup
 	OnSetupChain.Broadcast(MainChain->ContextData);
+}
+
+void UProceduralChainComponent::StartMainChain()
+{
+	if (bUseChainScheduler)
+	{
+		ChainScheduler->RunChainGraph(MainChain, MainChain->ContextData);
+	}
+	else
+	{
+		MainChain->StartChainProcessWithCurrentData();
+	}
 }
\ No newline at end of file
@@ -0,0 +1,316 @@
+#include "TerrainErosionKernel.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	//Murmur3 finalizer over seed, global sample coordinate and a per use salt
+	uint32 HashSample(int32 Seed, int32 X, int32 Y, uint32 Salt)
+	{
+		uint32 H = (uint32)Seed * 0x9E3779B9u;
+		H ^= (uint32)X * 0x85EBCA6Bu;
+		H ^= (uint32)Y * 0xC2B2AE35u;
+		H ^= Salt * 0x27D4EB2Fu;
+
+		H ^= H >> 16;
+		H *= 0x85EBCA6Bu;
+		H ^= H >> 13;
+		H *= 0xC2B2AE35u;
+		H ^= H >> 16;
+		return H;
+	}
+
+	float HashToUnit(uint32 Hash)
+	{
+		return (Hash >> 8) * (1.f / 16777216.f);
+	}
+
+	struct FErosionBrush
+	{
+		TArray<FIntPoint> Offsets;
+		TArray<float> Weights;
+
+		explicit FErosionBrush(int32 Radius)
+		{
+			for (int32 Y = -Radius; Y <= Radius; Y++)
+			{
+				for (int32 X = -Radius; X <= Radius; X++)
+				{
+					const float Weight = Radius - FMath::Sqrt(float(X * X + Y * Y));
+					if (Weight > 0.f)
+					{
+						Offsets.Add(FIntPoint(X, Y));
+						Weights.Add(Weight);
+					}
+				}
+			}
+		}
+	};
+
+	/** One tile's droplets and the changes they made, Delta covers the tile grown by the droplet reach */
+	struct FErosionTile
+	{
+		int32 X0, Y0, X1, Y1;
+		int32 BufferX0, BufferY0, BufferWidth, BufferHeight;
+		TArray<float> Delta;
+
+		const float* Base;
+		int32 Size;
+
+		float Height(int32 X, int32 Y) const
+		{
+			return Base[Y * Size + X] + Delta[(Y - BufferY0) * BufferWidth + (X - BufferX0)];
+		}
+
+		void Add(int32 X, int32 Y, float Amount)
+		{
+			Delta[(Y - BufferY0) * BufferWidth + (X - BufferX0)] += Amount;
+		}
+
+		//Droplets need their bilinear cell fully inside the map and the buffer
+		bool ContainsCell(int32 X, int32 Y) const
+		{
+			return X >= BufferX0 && Y >= BufferY0 && X < BufferX0 + BufferWidth - 1 && Y < BufferY0 + BufferHeight - 1;
+		}
+
+		void HeightAndGradient(float PosX, float PosY, float& OutHeight, float& OutGradientX, float& OutGradientY) const
+		{
+			const int32 X = FMath::FloorToInt(PosX);
+			const int32 Y = FMath::FloorToInt(PosY);
+			const float U = PosX - X;
+			const float V = PosY - Y;
+
+			const float NW = Height(X, Y);
+			const float NE = Height(X + 1, Y);
+			const float SW = Height(X, Y + 1);
+			const float SE = Height(X + 1, Y + 1);
+
+			OutGradientX = (NE - NW) * (1.f - V) + (SE - SW) * V;
+			OutGradientY = (SW - NW) * (1.f - U) + (SE - NE) * U;
+			OutHeight = NW * (1.f - U) * (1.f - V) + NE * U * (1.f - V) + SW * (1.f - U) * V + SE * U * V;
+		}
+
+		void SimulateDroplet(float PosX, float PosY, const FTerrainErosionSettings& Settings, const FErosionBrush& Brush)
+		{
+			float DirX = 0.f;
+			float DirY = 0.f;
+			float Speed = 1.f;
+			float Water = 1.f;
+			float Sediment = 0.f;
+
+			for (int32 Life = 0; Life < Settings.MaxLifetime; Life++)
+			{
+				const int32 NodeX = FMath::FloorToInt(PosX);
+				const int32 NodeY = FMath::FloorToInt(PosY);
+				const float U = PosX - NodeX;
+				const float V = PosY - NodeY;
+
+				float CurrentHeight, GradientX, GradientY;
+				HeightAndGradient(PosX, PosY, CurrentHeight, GradientX, GradientY);
+
+				DirX = DirX * Settings.Inertia - GradientX * (1.f - Settings.Inertia);
+				DirY = DirY * Settings.Inertia - GradientY * (1.f - Settings.Inertia);
+
+				const float DirLength = FMath::Sqrt(DirX * DirX + DirY * DirY);
+				if (DirLength <= SMALL_NUMBER)
+				{
+					//Flat, nowhere to flow
+					break;
+				}
+				DirX /= DirLength;
+				DirY /= DirLength;
+				PosX += DirX;
+				PosY += DirY;
+
+				if (!ContainsCell(FMath::FloorToInt(PosX), FMath::FloorToInt(PosY)))
+				{
+					break;
+				}
+
+				float NewHeight, UnusedX, UnusedY;
+				HeightAndGradient(PosX, PosY, NewHeight, UnusedX, UnusedY);
+				const float DeltaHeight = NewHeight - CurrentHeight;
+
+				const float Capacity = FMath::Max(-DeltaHeight * Speed * Water * Settings.SedimentCapacityFactor, Settings.MinSedimentCapacity);
+
+				if (Sediment > Capacity || DeltaHeight > 0.f)
+				{
+					//Uphill fills the pit behind us, otherwise drop the surplus
+					const float Deposit = DeltaHeight > 0.f ? FMath::Min(DeltaHeight, Sediment) : (Sediment - Capacity) * Settings.DepositSpeed;
+					Sediment -= Deposit;
+
+					Add(NodeX, NodeY, Deposit * (1.f - U) * (1.f - V));
+					Add(NodeX + 1, NodeY, Deposit * U * (1.f - V));
+					Add(NodeX, NodeY + 1, Deposit * (1.f - U) * V);
+					Add(NodeX + 1, NodeY + 1, Deposit * U * V);
+				}
+				else
+				{
+					const float Erode = FMath::Min((Capacity - Sediment) * Settings.ErodeSpeed, -DeltaHeight);
+
+					//Brush weights renormalized over the samples that are on the map
+					float WeightSum = 0.f;
+					for (int32 i = 0; i < Brush.Offsets.Num(); i++)
+					{
+						const FIntPoint Cell(NodeX + Brush.Offsets[i].X, NodeY + Brush.Offsets[i].Y);
+						if (Cell.X >= 0 && Cell.Y >= 0 && Cell.X < Size && Cell.Y < Size)
+						{
+							WeightSum += Brush.Weights[i];
+						}
+					}
+					if (WeightSum > 0.f)
+					{
+						for (int32 i = 0; i < Brush.Offsets.Num(); i++)
+						{
+							const FIntPoint Cell(NodeX + Brush.Offsets[i].X, NodeY + Brush.Offsets[i].Y);
+							if (Cell.X >= 0 && Cell.Y >= 0 && Cell.X < Size && Cell.Y < Size)
+							{
+								Add(Cell.X, Cell.Y, -Erode * Brush.Weights[i] / WeightSum);
+							}
+						}
+						Sediment += Erode;
+					}
+				}
+
+				Speed = FMath::Sqrt(FMath::Max(Speed * Speed - DeltaHeight * Settings.Gravity, 0.f));
+				Water *= (1.f - Settings.EvaporateSpeed);
+			}
+		}
+	};
+}
+
+int32 FTerrainErosionKernel::DropletReach(const FTerrainErosionSettings& Settings)
+{
+	//One sample per step, plus the brush and the bilinear neighbour
+	return FMath::Max(Settings.MaxLifetime, 0) + FMath::Max(Settings.ErosionRadius, 0) + 2;
+}
+
+bool FTerrainErosionKernel::Erode(TArray<float>& Heights, int32 Size, const FTerrainErosionSettings& Settings, int32 Seed,
+	const FIntPoint& GlobalOffset, TFunction<bool()> InterruptCheck)
+{
+	if (Size < 2 || Heights.Num() != Size * Size)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FTerrainErosionKernel::Erode expected %d^2 samples, got %d"), Size, Heights.Num());
+		return true;
+	}
+
+	const int32 TileSize = FMath::Max(Settings.TileSize, 8);
+	const int32 Rounds = FMath::Max(Settings.Rounds, 1);
+	const int32 Reach = DropletReach(Settings);
+	const int32 DropletsWhole = FMath::FloorToInt(FMath::Max(Settings.DropletsPerSample, 0.f));
+	const float DropletsFraction = FMath::Max(Settings.DropletsPerSample, 0.f) - DropletsWhole;
+	const FErosionBrush Brush(FMath::Max(Settings.ErosionRadius, 1));
+
+	//Tile grid is aligned to global samples, droplets only see their own tile's deltas so neighbouring
+	//patches have to partition the shared seam area identically. The first tile may be partial
+	const int32 FirstTileX = -(((GlobalOffset.X % TileSize) + TileSize) % TileSize);
+	const int32 FirstTileY = -(((GlobalOffset.Y % TileSize) + TileSize) % TileSize);
+
+	TArray<FErosionTile> Tiles;
+	for (int32 TileY = FirstTileY; TileY < Size; TileY += TileSize)
+	{
+		for (int32 TileX = FirstTileX; TileX < Size; TileX += TileSize)
+		{
+			const int32 X = FMath::Max(TileX, 0);
+			const int32 Y = FMath::Max(TileY, 0);
+
+			FErosionTile& Tile = Tiles.AddDefaulted_GetRef();
+			Tile.X0 = X;
+			Tile.Y0 = Y;
+			Tile.X1 = FMath::Min(TileX + TileSize, Size);
+			Tile.Y1 = FMath::Min(TileY + TileSize, Size);
+			Tile.BufferX0 = FMath::Max(X - Reach, 0);
+			Tile.BufferY0 = FMath::Max(Y - Reach, 0);
+			Tile.BufferWidth = FMath::Min(Tile.X1 + Reach, Size) - Tile.BufferX0;
+			Tile.BufferHeight = FMath::Min(Tile.Y1 + Reach, Size) - Tile.BufferY0;
+			Tile.Delta.SetNumZeroed(Tile.BufferWidth * Tile.BufferHeight);
+			Tile.Base = Heights.GetData();
+			Tile.Size = Size;
+		}
+	}
+
+	FThreadSafeBool bInterrupted = false;
+
+	for (int32 Round = 0; Round < Rounds; Round++)
+	{
+		if (InterruptCheck && InterruptCheck())
+		{
+			return false;
+		}
+
+		//Every tile reads the heights left by the previous round and only writes its own buffer
+		ParallelFor(Tiles.Num(), [&](int32 TileIndex)
+		{
+			FErosionTile& Tile = Tiles[TileIndex];
+			FMemory::Memzero(Tile.Delta.GetData(), Tile.Delta.Num() * sizeof(float));
+
+			if (bInterrupted || (InterruptCheck && InterruptCheck()))
+			{
+				bInterrupted = true;
+				return;
+			}
+
+			//Last row/column can't hold a bilinear cell
+			for (int32 Y = Tile.Y0; Y < FMath::Min(Tile.Y1, Size - 1); Y++)
+			{
+				for (int32 X = Tile.X0; X < FMath::Min(Tile.X1, Size - 1); X++)
+				{
+					const int32 GlobalX = GlobalOffset.X + X;
+					const int32 GlobalY = GlobalOffset.Y + Y;
+
+					const int32 Count = DropletsWhole + (HashToUnit(HashSample(Seed, GlobalX, GlobalY, 0)) < DropletsFraction ? 1 : 0);
+					for (int32 Droplet = 0; Droplet < Count; Droplet++)
+					{
+						const uint32 Salt = 1 + Droplet * 3;
+						if (HashSample(Seed, GlobalX, GlobalY, Salt) % Rounds != (uint32)Round)
+						{
+							continue;
+						}
+						const float PosX = X + HashToUnit(HashSample(Seed, GlobalX, GlobalY, Salt + 1));
+						const float PosY = Y + HashToUnit(HashSample(Seed, GlobalX, GlobalY, Salt + 2));
+						Tile.SimulateDroplet(PosX, PosY, Settings, Brush);
+					}
+				}
+			}
+		});
+
+		if (bInterrupted)
+		{
+			return false;
+		}
+
+		//Reduce in tile order per sample, rows are independent so they can still run in parallel
+		ParallelFor(Size, [&](int32 Y)
+		{
+			float* Row = Heights.GetData() + Y * Size;
+			for (const FErosionTile& Tile : Tiles)
+			{
+				if (Y < Tile.BufferY0 || Y >= Tile.BufferY0 + Tile.BufferHeight)
+				{
+					continue;
+				}
+				const float* DeltaRow = Tile.Delta.GetData() + (Y - Tile.BufferY0) * Tile.BufferWidth;
+				for (int32 X = 0; X < Tile.BufferWidth; X++)
+				{
+					Row[Tile.BufferX0 + X] += DeltaRow[X];
+				}
+			}
+		});
+	}
+	return true;
+}
+
+void FTerrainErosionKernel::CropSquare(const TArray<float>& Source, int32 Border, int32 Size, TArray<float>& OutCropped)
+{
+	const int32 SourceSize = Size + 2 * Border;
+	if (Source.Num() != SourceSize * SourceSize)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FTerrainErosionKernel::CropSquare expected %d^2 samples, got %d"), SourceSize, Source.Num());
+		return;
+	}
+
+	OutCropped.SetNumUninitialized(Size * Size);
+	for (int32 Y = 0; Y < Size; Y++)
+	{
+		FMemory::Memcpy(OutCropped.GetData() + Y * Size, Source.GetData() + (Y + Border) * SourceSize + Border, Size * sizeof(float));
+	}
+}
@@ -4,6 +4,128 @@
 #include "RealtimeMeshSimple.h"
 #include "CubicSphere.h"
 #include "SIOJConvert.h"
+#include "Kismet/GameplayStatics.h"
+#include "Camera/PlayerCameraManager.h"
+#include "TerrainMaskCompositor.h"
+#include "Engine/Texture2D.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "Math/Float16Color.h"
+
+namespace
+{
+	//Game thread hop that gives up once the chain is cancelled, so a stop on the game thread never waits on us.
+	//Body may reference our stack, so once it started running we wait for it to finish even if cancelled
+	void WaitForGameThreadTask(const FPGCancellationTokenRef& Token, TUniqueFunction<void()>&& Body)
+	{
+		enum { Pending, Running, Abandoned };
+		TSharedRef<std::atomic<int32>, ESPMode::ThreadSafe> State = MakeShared<std::atomic<int32>, ESPMode::ThreadSafe>(Pending);
+
+		TFuture<void> Task = Async(EAsyncExecution::TaskGraphMainThread, [State, Body = MoveTemp(Body)]() mutable
+		{
+			int32 Expected = Pending;
+			if (State->compare_exchange_strong(Expected, Running))
+			{
+				Body();
+			}
+		});
+
+		const FTimespan PollInterval = FTimespan::FromMilliseconds(10);
+		while (!Task.WaitFor(PollInterval))
+		{
+			if (Token->IsCancelled())
+			{
+				int32 Expected = Pending;
+				if (!State->compare_exchange_strong(Expected, Abandoned))
+				{
+					Task.Wait();
+				}
+				return;
+			}
+		}
+	}
+
+	//Render thread region update of the whole texture, false for formats we don't write (library path handles those)
+	bool UpdateTextureInPlace(UTexture2D* Texture, const TArray<float>& Heights, int32 PatchSize)
+	{
+		if (!Texture || !Texture->GetResource() || Heights.Num() != PatchSize * PatchSize ||
+			Texture->GetSizeX() != PatchSize || Texture->GetSizeY() != PatchSize)
+		{
+			return false;
+		}
+
+		const EPixelFormat Format = Texture->GetPixelFormat();
+		int32 BytesPerPixel = 0;
+		switch (Format)
+		{
+		case PF_FloatRGBA:			BytesPerPixel = sizeof(FFloat16Color); break;
+		case PF_A32B32G32R32F:		BytesPerPixel = sizeof(FLinearColor); break;
+		case PF_R32_FLOAT:			BytesPerPixel = sizeof(float); break;
+		case PF_R16F:				BytesPerPixel = sizeof(FFloat16); break;
+		default:
+			return false;
+		}
+
+		//Owned by the render command, freed in the cleanup callback
+		uint8* Texels = (uint8*)FMemory::Malloc(int64(Heights.Num()) * BytesPerPixel);
+		for (int32 i = 0; i < Heights.Num(); i++)
+		{
+			const float Height = Heights[i];
+			switch (Format)
+			{
+			case PF_FloatRGBA:			((FFloat16Color*)Texels)[i] = FFloat16Color(FLinearColor(Height, Height, Height, 1.f)); break;
+			case PF_A32B32G32R32F:		((FLinearColor*)Texels)[i] = FLinearColor(Height, Height, Height, 1.f); break;
+			case PF_R32_FLOAT:			((float*)Texels)[i] = Height; break;
+			default:					((FFloat16*)Texels)[i] = FFloat16(Height); break;
+			}
+		}
+
+		FUpdateTextureRegion2D* Region = new FUpdateTextureRegion2D(0, 0, 0, 0, PatchSize, PatchSize);
+		Texture->UpdateTextureRegions(0, 1, Region, PatchSize * BytesPerPixel, BytesPerPixel, Texels,
+			[](uint8* SrcData, const FUpdateTextureRegion2D* Regions)
+			{
+				FMemory::Free(SrcData);
+				delete Regions;
+			});
+		return true;
+	}
+
+	//One full pass over the heightmap per mask
+	void ApplyMaskWithLibrary(TArray<float>& Heights, const FTGMaskReference& Mask, const FTransform& PatchTransform)
+	{
+		if (Mask.MaskChainOp != nullptr)
+		{
+			//TODO: define a chain op that would work here...
+			//Custom work, this should be using the chain instead of built in work...
+			UHeightmapDeformersLibrary::DeformTerrainByMask(
+				Heights,
+				Mask.MaskFloatArray,
+				PatchTransform,
+				Mask.MaskTransform,
+				[](float TerrainPixel, float MaskPixel, float MaskScale)
+				{
+					//Hard cutoff deformer
+					if (MaskPixel > 0.5f)
+					{
+						return TerrainPixel + (TerrainPixel * MaskScale);
+					}
+					else
+					{
+						return TerrainPixel;
+					}
+				}, Mask.MaskScale);
+		}
+		//Apply default ops (add/sub/multiply etc
+		else if (Mask.MaskDefaultOp != EFloatAppendTypes::None)
+		{
+			UHeightmapDeformersLibrary::DeformTerrainByMaskOp(
+				Heights,
+				Mask.MaskFloatArray,
+				PatchTransform,
+				Mask.MaskTransform,
+				Mask.MaskDefaultOp, Mask.MaskScale);
+		}
+	}
+}
 
 void UTerrainGeneratorChain::OnPreProcessChain_Implementation(UPGContextDataObject* Data)
 {
@@ -12,6 +134,12 @@ void UTerrainGeneratorChain::OnPreProcessChain_Implementation(UPGContextDataObje
 		Data->Context.ObjectMap.Num(),
 		Data->Context.ActorMap.Num());
 
+	//Params and mask buffers are read by workers, the previous run has to be gone before we replace them
+	if (DeferUntilWorkersExited(&UTerrainGeneratorChain::OnPreProcessChain_Implementation, Data))
+	{
+		return;
+	}
+
 	//Grab params
 	if (Data->Context.ObjectMap.Contains(TEXT("Params")))
 	{
@@ -28,307 +156,1090 @@ void UTerrainGeneratorChain::OnPreProcessChain_Implementation(UPGContextDataObje
 	{
 		for (FTGMaskReference& Mask : Params.Masks.Masks)
 		{
-			Mask.MaskFloatArray = UHeightmapDeformersLibrary::Conv_GreyScaleTexture2DToFloatArray(Mask.MaskTexture);
+			Mask.MaskFloatArray = FTGMaskFloatCache::Get().Convert(Mask.MaskTexture);
+		}
+	}
+
+	if (Params.bGenerateCubeQuadSphere)
+	{
+		GenerateCubeQuadSphere(Data);
+	}
+	else
+	{
+		GenerateTerrain(Data);
+	}
+}
+
+void UTerrainGeneratorChain::OnPostProcessChain_Implementation(UPGContextDataObject* Data)
+{
+	UE_LOG(LogTemp, Log, TEXT("UTerrainGeneratorChain::OnPostProcessChain_Implementation (Len %d %d %d)"),
+		Data->Context.StringMap.Num(),
+		Data->Context.ObjectMap.Num(),
+		Data->Context.ActorMap.Num());
+}
+
+
+void UTerrainGeneratorChain::OnChainFinished_Implementation(UPGContextDataObject* Data)
+{
+	UE_LOG(LogTemp, Log, TEXT("UTerrainGeneratorChain::OnChainFinished_Implementation (Len %d %d %d)"),
+		Data->Context.StringMap.Num(),
+		Data->Context.ObjectMap.Num(),
+		Data->Context.ActorMap.Num());
+}
+
+void EmitEventWithString(UObject* Context, const FString& FunctionName, const FString& Arg)
+{
+	if (!Context->IsValidLowLevelFast())
+	{
+		return;
+	}
+
+	UFunction* Function = Context->FindFunction(FName(FunctionName));
+
+	/*FStrProperty* StrProperty =
+		new FStrProperty(FFieldVariant(Context->GetClass()),
+			TEXT("StringValue"),
+			EObjectFlags::RF_Public | EObjectFlags::RF_LoadCompleted);
+
+	TArray<uint8> Buffer;
+	Buffer.SetNum(Arg.GetAllocatedSize());
+	StrProperty->SetPropertyValue_InContainer(Buffer.GetData(), Arg);*/
+
+	Context->ProcessEvent(Function, (void*)&Arg/*Buffer.GetData()*/);
+
+	//delete StrProperty;
+}
+
+void UTerrainGeneratorChain::GenerateTerrain(UPGContextDataObject* Data)
+{
+	//Default params
+	UObject* Callback = nullptr;
+	UArrayWrapper* FloatWrapper = NewObject<UArrayWrapper>(this);	
+
+	//for reflection signalling
+	if (Data->Context.ObjectMap.Contains(TEXT("Callback")))
+	{
+		Callback = Data->Context.ObjectMap[TEXT("Callback")];
+	}
+
+	//Start temp organization of work groups
+	//Generate temp workgrid, string as x,y, current work product
+
+	//No-op when called through OnPreProcessChain, which already waited before touching Params
+	if (DeferUntilWorkersExited(&UTerrainGeneratorChain::GenerateTerrain, Data))
+	{
+		return;
+	}
+
+	Params.Debug2DResults.Empty();
+
+	//Streamed patches belong to the previous params
+	ResetStreamedPatches();
+
+	//Cached heights stay valid across runs as long as nothing affecting them changed
+	const uint32 HeightParamsHash = ComputeHeightParamsHash();
+	if (HeightParamsHash != PatchCacheParamsHash)
+	{
+		PatchHeightCache.Empty();
+		PatchCacheParamsHash = HeightParamsHash;
+	}
+	PatchHeightCache.SetMemoryBudget(int64(FMath::Max(Params.PatchCacheBudgetMB, 0)) * 1024 * 1024);
+	PatchDiskStore.SetParamsHash(HeightParamsHash);
+	PatchDiskStore.SetFormat(Params.PatchStoreFormat);
+	if (Params.bPersistPatches)
+	{
+		PatchDiskStore.PurgeOldFolders(Params.MaxPatchStoreFolders);
+	}
+
+	if (Params.bStreamAroundViewer)
+	{
+		StartTerrainStreaming(Data);
+
+		//Idle downstream chain until the first ring around the viewer is done
+		WaitForLatentResponse();
+		return;
+	}
+
+	int32 GridSize = Params.ComputeGridSize;
+	float Spacing = Params.VisualSpacing;
+
+	//Work items are fixed for the run, workers claim them through NextWorkIndex. Last run's patches go back to the pool
+	ReleaseWorkItems();
+	WorkItems.Reserve(GridSize * GridSize);
+	for (int32 Y = 0; Y < GridSize; Y++)
+	{
+		for (int32 X = 0; X < GridSize; X++)
+		{
+			WorkProduct& NewProduct = WorkItems.AddDefaulted_GetRef();
+			NewProduct.Origin.SetLocation(FVector(X, Y, 0));
+			NewProduct.FloatData = UHeightmapDeformersLibrary::SquareFloatMapSized(Params.PatchSize);
+		}
+	}
+	NextWorkIndex.Set(0);
+
+	/*TODO:
+	Call intermediate results in a way that a gamethread can allocate and map results to world visuals
+	(procgen mesh, one per patch). This would be the parent/receiver chain node.
+	*/
+	FloatWrapper->FloatData = UHeightmapDeformersLibrary::SquareFloatMapSized(Params.PatchSize);
+	UTexture2D* OutputTexture = UHeightmapDeformersLibrary::SquareTextureSized(Params.PatchSize);
+
+	//Allow this to be referenced on later threads
+	Data->Context.ObjectMap.Add(TEXT("FloatHeightMap"), FloatWrapper);
+	Data->Context.ObjectMap.Add(TEXT("TextureHeightMap"), OutputTexture);
+
+	bWorkersShouldRun = true;
+	FPGCancellationTokenRef Token = GetCancellationToken();
+
+	//Results are uploaded from Tick, workers never wait on the game thread
+	ClearPatchResults();
+	TerrainRunToken = Token;
+	TerrainRunData = Data;
+	bTerrainWorkersDone = false;
+	bTickPatchUploads = true;
+
+	int32 NumWorkers = Params.TerrainWorkerCount > 0 ? Params.TerrainWorkerCount : FPlatformMisc::NumberOfWorkerThreadsToSpawn();
+	NumWorkers = FMath::Clamp(NumWorkers, 1, FMath::Max(WorkItems.Num(), 1));
+	GridWorkersLeft.Set(NumWorkers);
+	ActiveTerrainWorkers.Add(NumWorkers);
+
+	//Run on BG threads - each worker keeps pulling patches until none are left
+	for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; WorkerIndex++)
+	{
+		Async(EAsyncExecution::ThreadPool, [this, Token]
+		{
+			FPGCancellationToken::FWorkScope WorkScope(Token);
+
+			while (bWorkersShouldRun && !Token->IsCancelled())
+			{
+				const int32 WorkIndex = NextWorkIndex.Increment() - 1;
+				if (!WorkItems.IsValidIndex(WorkIndex))
+				{
+					break;
+				}
+
+				ProcessTerrainWorkUnit(WorkIndex, Token);
+			}
+
+			//Last worker out finishes the run
+			if (GridWorkersLeft.Decrement() == 0)
+			{
+				FinishTerrainWorkers(Token);
+			}
+			ActiveTerrainWorkers.Decrement();
+		});
+	}
+
+	//Idle downstream chain until ResumeChainFromLatentResult is called.
+	WaitForLatentResponse();
+}
+
+void UTerrainGeneratorChain::ProcessTerrainWorkUnit(int32 WorkIndex, const FPGCancellationTokenRef& Token)
+{
+	WorkProduct& WorkUnit = WorkItems[WorkIndex];
+
+	FTerrainPatchResult ResultKey;
+	ResultKey.WorkIndex = WorkIndex;
+
+	if (GeneratePatchResults(WorkUnit.FloatData, WorkUnit.Origin, ResultKey, Token))
+	{
+		UE_LOG(LogTemp, Log, TEXT("UTerrainGeneratorChain: WorkProduct done: %1.3f, %1.3f"), WorkUnit.Origin.GetLocation().X, WorkUnit.Origin.GetLocation().Y);
+	}
+}
+
+bool UTerrainGeneratorChain::GeneratePatchResults(TArray<float>& FloatData, const FTransform& Origin, const FTerrainPatchResult& ResultKey, const FPGCancellationTokenRef& Token)
+{
+	const FPatchKey Key = PatchKeyForOrigin(Origin);
+
+	//Previously generated, in memory or (warm restart) on disk
+	FPatchHeightData StoredHeights = FindStoredPatch(Key);
+	if (StoredHeights.IsValid())
+	{
+		FTerrainPatchResult StoredResult = ResultKey;
+		StoredResult.bIsEroded = Params.bApplyErosion;
+		StoredResult.Heights = MoveTemp(StoredHeights);
+		return EnqueuePatchResult(MoveTemp(StoredResult), Token);
+	}
+
+	//Tiled erosion runs on a bordered map so droplets near the seam match the neighbouring patch
+	const int32 Halo = ErosionSeamHalo();
+	TArray<float> BorderedData;
+	if (Halo > 0)
+	{
+		BorderedData = UHeightmapDeformersLibrary::SquareFloatMapSized(Params.PatchSize + 2 * Halo);
+		GenerateSourceHeights(BorderedData, Origin, Halo);
+		FTerrainErosionKernel::CropSquare(BorderedData, Halo, Params.PatchSize, FloatData);
+	}
+	else
+	{
+		GenerateSourceHeights(FloatData, Origin, 0);
+	}
+
+	//Erosion keeps working on our data, so the source result gets a copy
+	FTerrainPatchResult SourceResult = ResultKey;
+	if (Params.bApplyErosion)
+	{
+		SourceResult.Heights = MakeShared<const TArray<float>, ESPMode::ThreadSafe>(FloatData);
+	}
+	else
+	{
+		SourceResult.Heights = StorePatch(Key, MoveTemp(FloatData));
+	}
+	if (!EnqueuePatchResult(MoveTemp(SourceResult), Token))
+	{
+		return false;
+	}
+
+	//Erode
+	if (Params.bApplyErosion)
+	{
+		if (UsesTiledErosion())
+		{
+			const FVector SampleOrigin = Origin.GetLocation() * Params.PerlinSpacing;
+			const FIntPoint GlobalOffset(FMath::RoundToInt(SampleOrigin.X) - Halo, FMath::RoundToInt(SampleOrigin.Y) - Halo);
+
+			TArray<float>& ErodedData = Halo > 0 ? BorderedData : FloatData;
+			FTerrainErosionKernel::Erode(ErodedData, Params.PatchSize + 2 * Halo, Params.ErosionSettings, Params.Seed, GlobalOffset, [Token]()
+			{
+				return Token->IsCancelled();
+			});
+
+			if (Halo > 0 && !Token->IsCancelled())
+			{
+				FTerrainErosionKernel::CropSquare(BorderedData, Halo, Params.PatchSize, FloatData);
+			}
+		}
+		else
+		{
+			UHeightmapDeformersLibrary::HydraulicErosionOnHeightMapWithInterrupt(FloatData, Params.HydroParams, [Token]()
+			{
+				return Token->IsCancelled();
+			});
+		}
+
+		if (Token->IsCancelled())
+		{
+			return false;
+		}
+
+		FTerrainPatchResult ErodedResult = ResultKey;
+		ErodedResult.bIsEroded = true;
+		ErodedResult.Heights = StorePatch(Key, MoveTemp(FloatData));
+		if (!EnqueuePatchResult(MoveTemp(ErodedResult), Token))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool UTerrainGeneratorChain::EnqueuePatchResult(FTerrainPatchResult&& Result, const FPGCancellationTokenRef& Token)
+{
+	const int32 MaxQueued = FMath::Max(Params.MaxQueuedPatchResults, 1);
+
+	//Reserve a slot first so concurrent workers can't overshoot the bound
+	while (QueuedPatchResults.Increment() > MaxQueued)
+	{
+		QueuedPatchResults.Decrement();
+		if (Token->IsCancelled())
+		{
+			return false;
+		}
+		//Game thread is behind, back off until Tick drains
+		FPlatformProcess::Sleep(0.001f);
+	}
+
+	PatchResults.Enqueue(MoveTemp(Result));
+	return true;
+}
+
+void UTerrainGeneratorChain::ClearPatchResults()
+{
+	FTerrainPatchResult Discarded;
+	while (PatchResults.Dequeue(Discarded))
+	{
+		QueuedPatchResults.Decrement();
+	}
+}
+
+void UTerrainGeneratorChain::UploadPatchResult(FTerrainPatchResult& Result)
+{
+	if (!TerrainRunData || !Result.Heights.IsValid())
+	{
+		return;
+	}
+
+	FStreamedTerrainPatch* StreamedPatch = nullptr;
+	if (Result.bStreamed)
+	{
+		StreamedPatch = StreamedPatches.Find(Result.Coord);
+		if (!StreamedPatch)
+		{
+			//Evicted while generating
+			return;
+		}
+	}
+	else if (!WorkItems.IsValidIndex(Result.WorkIndex))
+	{
+		return;
+	}
+	WorkProduct& WorkUnit = StreamedPatch ? StreamedPatch->Product : WorkItems[Result.WorkIndex];
+
+	//Allocate if needed
+	if (!WorkUnit.FloatTexture)
+	{
+		AcquirePatchResources(WorkUnit, TerrainRunData->Context.ActorMap[TEXT("Origin")]);
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("UTerrainGeneratorChain: %s upload"), Result.bIsEroded ? TEXT("Erosion") : TEXT("Source generation"));
+
+	//Pooled and re-uploaded textures keep their resource, only the texels change
+	if (!UpdateTextureInPlace(WorkUnit.FloatTexture, *Result.Heights, Params.PatchSize))
+	{
+		UHeightmapDeformersLibrary::CopyFloatArrayToTexture(*Result.Heights, WorkUnit.FloatTexture);
+	}
+
+	if (WorkUnit.MaterialInstance)
+	{
+		WorkUnit.MaterialInstance->SetTextureParameterValue(FName("Height"), WorkUnit.FloatTexture);
+		WorkUnit.MaterialInstance->SetTextureParameterValue(FName("HeightTex"), WorkUnit.FloatTexture);
+		if (!Result.bIsEroded)
+		{
+			WorkUnit.MaterialInstance->SetScalarParameterValue(FName("Scale"), 8000.f);
+		}
+	}
+
+	const bool bIsFinalResult = Result.bIsEroded || !Params.bApplyErosion;
+
+	if (StreamedPatch)
+	{
+		//Texture holds the result, streamed patches don't keep float data around
+		if (bIsFinalResult)
+		{
+			StreamedPatch->bGenerating = false;
+			if (WorkUnit.Mesh)
+			{
+				WorkUnit.Mesh->SetVisibility(StreamedPatch->bVisible);
+			}
+		}
+		return;
+	}
+
+	Params.Debug2DResults.AddUnique(WorkUnit.FloatTexture);
+
+	//Final data goes back to the work product, workers are done with it
+	if (bIsFinalResult)
+	{
+		WorkUnit.Heights = MoveTemp(Result.Heights);
+	}
+}
+
+bool UTerrainGeneratorChain::DeferUntilWorkersExited(FTerrainRunFunction Run, UPGContextDataObject* Data)
+{
+	if (ActiveTerrainWorkers.GetValue() == 0)
+	{
+		return false;
+	}
+
+	//Usually already cancelled by the new run's token reset, cancelled workers exit without waiting on us
+	bWorkersShouldRun = false;
+	if (TerrainRunToken.IsValid())
+	{
+		TerrainRunToken->Cancel();
+	}
+
+	//Never block the frame on them, Tick restarts the run once the last one is out
+	DeferredRun = Run;
+	DeferredRunData = Data;
+	DeferredRunStartTime = FPlatformTime::Seconds();
+	WaitForLatentResponse();
+	return true;
+}
+
+void UTerrainGeneratorChain::BeginDestroy()
+{
+	bWorkersShouldRun = false;
+	if (TerrainRunToken.IsValid())
+	{
+		TerrainRunToken->Cancel();
+	}
+	if (CancellationToken.IsValid())
+	{
+		CancellationToken->Cancel();
+	}
+
+	Super::BeginDestroy();
+}
+
+bool UTerrainGeneratorChain::IsReadyForFinishDestroy()
+{
+	return ActiveTerrainWorkers.GetValue() == 0 && Super::IsReadyForFinishDestroy();
+}
+
+void UTerrainGeneratorChain::FinishTerrainWorkers(const FPGCancellationTokenRef& Token)
+{
+	bWorkersShouldRun = false;
+
+	//Stopped or out of budget, let the chain know so an expired run doesn't stay latent
+	if (Token->IsCancelled())
+	{
+		TWeakObjectPtr<UTerrainGeneratorChain> WeakThis = this;
+		AsyncTask(ENamedThreads::GameThread, [WeakThis]
+		{
+			if (WeakThis.IsValid())
+			{
+				WeakThis->OnAsyncWorkCancelled();
+			}
+		});
+		return;
+	}
+
+	//All results are queued before this, Tick resumes once they're uploaded
+	bTerrainWorkersDone = true;
+}
+
+void UTerrainGeneratorChain::Tick(float DeltaTime)
+{
+	if (DeferredRun)
+	{
+		if (IsCancellationRequested())
+		{
+			//Stopped while waiting for the previous workers
+			DeferredRun = nullptr;
+			DeferredRunData = nullptr;
+			OnAsyncWorkCancelled();
+			return;
+		}
+		if (ActiveTerrainWorkers.GetValue() > 0)
+		{
+			if (DeferredRunStartTime > 0.0 && FPlatformTime::Seconds() - DeferredRunStartTime > ChainState.CancelAcknowledgeTimeout)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("UTerrainGeneratorChain: %d previous terrain workers still running after %1.2fs, next run is waiting"),
+					ActiveTerrainWorkers.GetValue(), ChainState.CancelAcknowledgeTimeout);
+				DeferredRunStartTime = 0.0;
+			}
+			return;
+		}
+
+		FTerrainRunFunction Run = DeferredRun;
+		UPGContextDataObject* Data = DeferredRunData;
+		DeferredRun = nullptr;
+		DeferredRunData = nullptr;
+		(this->*Run)(Data);
+		return;
+	}
+
+	if (!TerrainRunToken.IsValid() || TerrainRunToken->IsCancelled())
+	{
+		//Cancel path reports through FinishTerrainWorkers, just drop what's left
+		ClearPatchResults();
+		bTickPatchUploads = false;
+
+		//Streaming has no last worker, report here if we were still latent
+		if (bStreamingActive)
+		{
+			bStreamingActive = false;
+			if (!bStreamingResumed)
+			{
+				OnAsyncWorkCancelled();
+			}
+		}
+		return;
+	}
+
+	const int32 UploadBudget = Params.MaxPatchUploadsPerFrame > 0 ? Params.MaxPatchUploadsPerFrame : MAX_int32;
+	int32 Uploads = 0;
+
+	FTerrainPatchResult Result;
+	while (Uploads < UploadBudget && PatchResults.Dequeue(Result))
+	{
+		QueuedPatchResults.Decrement();
+		UploadPatchResult(Result);
+		Uploads++;
+	}
+
+	if (bStreamingActive)
+	{
+		UpdateTerrainStreaming();
+		return;
+	}
+
+	if (bTerrainWorkersDone && PatchResults.IsEmpty())
+	{
+		bTickPatchUploads = false;
+
+		if (TerrainRunData && TerrainRunData->Context.ObjectMap.Contains(TEXT("Params")))
+		{
+			UTerrainGenParams* ParamsWrapper = Cast<UTerrainGenParams>(TerrainRunData->Context.ObjectMap[TEXT("Params")]);
+
+			//update params back
+			ParamsWrapper->ParamsStruct = Params;
+		}
+		TerrainRunData = nullptr;
+		UE_LOG(LogTemp, Log, TEXT("UTerrainGeneratorChain: Full generation complete, resuming from latent"));
+		ResumeChainFromLatentResult();
+	}
+}
+
+bool UTerrainGeneratorChain::IsTickable() const
+{
+	return bTickPatchUploads || bStreamingActive || DeferredRun != nullptr;
+}
+
+ETickableTickType UTerrainGeneratorChain::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UTerrainGeneratorChain::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTerrainGeneratorChain, STATGROUP_Tickables);
+}
+
+void UTerrainGeneratorChain::StartTerrainStreaming(UPGContextDataObject* Data)
+{
+	FPGCancellationTokenRef Token = GetCancellationToken();
+
+	ClearPatchResults();
+	TerrainRunToken = Token;
+	TerrainRunData = Data;
+	bWorkersShouldRun = true;
+	bStreamingActive = true;
+	bStreamingResumed = false;
+
+	//First requests go out right away, Tick keeps the ring up to date from here
+	UpdateTerrainStreaming();
+}
+
+bool UTerrainGeneratorChain::GetStreamingViewer(FVector& OutLocation, FVector& OutForward, float& OutFOV) const
+{
+	APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(this, 0);
+	if (CameraManager)
+	{
+		OutLocation = CameraManager->GetCameraLocation();
+		OutForward = CameraManager->GetCameraRotation().Vector();
+		OutFOV = CameraManager->GetFOVAngle();
+		return true;
+	}
+
+	//No camera (e.g. server), stream around the terrain origin actor without frustum preference
+	AActor* Owner = TerrainRunData ? TerrainRunData->Context.ActorMap.FindRef(TEXT("Origin")) : nullptr;
+	if (Owner)
+	{
+		OutLocation = Owner->GetActorLocation();
+		OutForward = Owner->GetActorForwardVector();
+		OutFOV = 360.f;
+		return true;
+	}
+	return false;
+}
+
+void UTerrainGeneratorChain::UpdateTerrainStreaming()
+{
+	AActor* Owner = TerrainRunData ? TerrainRunData->Context.ActorMap.FindRef(TEXT("Origin")) : nullptr;
+
+	FVector ViewerLocation, ViewerForward;
+	float ViewerFOV;
+	if (!Owner || !GetStreamingViewer(ViewerLocation, ViewerForward, ViewerFOV))
+	{
+		return;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	const float Spacing = FMath::Max(Params.VisualSpacing, 1.f);
+	const int32 Radius = FMath::Max(Params.StreamingRadius, 0);
+
+	//Patches are placed at Coord * VisualSpacing relative to the owner, same as the fixed grid
+	const FVector LocalViewer = (ViewerLocation - Owner->GetActorLocation()) / Spacing;
+	const FIntPoint ViewerCoord(FMath::FloorToInt(LocalViewer.X), FMath::FloorToInt(LocalViewer.Y));
+	const FVector2D ViewerForward2D = FVector2D(ViewerForward.X, ViewerForward.Y).GetSafeNormal();
+	const float FrustumCos = FMath::Cos(FMath::DegreesToRadians(FMath::Min(ViewerFOV, 360.f) * 0.5f));
+
+	struct FPatchRequest
+	{
+		FIntPoint Coord;
+		float Priority;
+	};
+	TArray<FPatchRequest> Requests;
+	bool bRingComplete = true;
+
+	for (int32 Y = -Radius; Y <= Radius; Y++)
+	{
+		for (int32 X = -Radius; X <= Radius; X++)
+		{
+			if (X * X + Y * Y > Radius * Radius)
+			{
+				continue;
+			}
+
+			const FIntPoint Coord = ViewerCoord + FIntPoint(X, Y);
+			FStreamedTerrainPatch* Patch = StreamedPatches.Find(Coord);
+			if (Patch)
+			{
+				Patch->LastVisibleTime = Now;
+				if (!Patch->bVisible)
+				{
+					//Cache hit, no regeneration needed
+					Patch->bVisible = true;
+					if (Patch->Product.Mesh && !Patch->bGenerating)
+					{
+						Patch->Product.Mesh->SetVisibility(true);
+					}
+				}
+				bRingComplete &= !Patch->bGenerating;
+				continue;
+			}
+
+			bRingComplete = false;
+
+			//Closest first, patches in front of the camera before those behind it
+			const FVector2D ToPatch = FVector2D(Coord.X + 0.5f, Coord.Y + 0.5f) - FVector2D(LocalViewer.X, LocalViewer.Y);
+			const float Distance = ToPatch.Size();
+			const bool bInFrustum = Distance < 1.f || FVector2D::DotProduct(ToPatch / Distance, ViewerForward2D) >= FrustumCos;
+			Requests.Add({ Coord, bInFrustum ? Distance : Distance + Radius });
+		}
+	}
+
+	//Anything outside the ring (with a patch of hysteresis) is hidden and becomes evictable
+	const int32 HideRadius = Radius + 1;
+	for (TPair<FIntPoint, FStreamedTerrainPatch>& Pair : StreamedPatches)
+	{
+		const FIntPoint Offset = Pair.Key - ViewerCoord;
+		if (Pair.Value.bVisible && Offset.X * Offset.X + Offset.Y * Offset.Y > HideRadius * HideRadius)
+		{
+			Pair.Value.bVisible = false;
+			if (Pair.Value.Product.Mesh)
+			{
+				Pair.Value.Product.Mesh->SetVisibility(false);
+			}
+		}
+	}
+	EvictStreamedPatches();
+
+	//Only as many requests in flight as we have workers, the rest wait for later frames with fresh priorities
+	int32 MaxInFlight = Params.TerrainWorkerCount > 0 ? Params.TerrainWorkerCount : FPlatformMisc::NumberOfWorkerThreadsToSpawn();
+	MaxInFlight = FMath::Max(MaxInFlight, 1);
+
+	Requests.Sort([](const FPatchRequest& A, const FPatchRequest& B)
+	{
+		return A.Priority < B.Priority;
+	});
+
+	for (const FPatchRequest& Request : Requests)
+	{
+		if (ActiveTerrainWorkers.GetValue() >= MaxInFlight)
+		{
+			break;
+		}
+		DispatchStreamedPatch(Request.Coord);
+	}
+
+	if (bRingComplete && !bStreamingResumed)
+	{
+		bStreamingResumed = true;
+		UE_LOG(LogTemp, Log, TEXT("UTerrainGeneratorChain: Streaming ring around viewer complete, resuming from latent"));
+		ResumeChainFromLatentResult();
+	}
+}
+
+void UTerrainGeneratorChain::DispatchStreamedPatch(const FIntPoint& Coord)
+{
+	FStreamedTerrainPatch& Patch = StreamedPatches.Add(Coord);
+	Patch.Product.Origin.SetLocation(FVector(Coord.X, Coord.Y, 0));
+	Patch.bGenerating = true;
+	Patch.bVisible = true;
+	Patch.LastVisibleTime = FPlatformTime::Seconds();
+
+	FPGCancellationTokenRef Token = TerrainRunToken.ToSharedRef();
+	const FTransform Origin = Patch.Product.Origin;
+
+	ActiveTerrainWorkers.Increment();
+	Async(EAsyncExecution::ThreadPool, [this, Token, Coord, Origin]
+	{
+		{
+			FPGCancellationToken::FWorkScope WorkScope(Token);
+
+			if (!Token->IsCancelled())
+			{
+				FTerrainPatchResult ResultKey;
+				ResultKey.Coord = Coord;
+				ResultKey.bStreamed = true;
+
+				//Revisits of evicted patches are served from the stores inside
+				TArray<float> FloatData = UHeightmapDeformersLibrary::SquareFloatMapSized(Params.PatchSize);
+				GeneratePatchResults(FloatData, Origin, ResultKey, Token);
+			}
+		}
+		ActiveTerrainWorkers.Decrement();
+	});
+}
+
+void UTerrainGeneratorChain::EvictStreamedPatches()
+{
+	TArray<FIntPoint> Hidden;
+	for (const TPair<FIntPoint, FStreamedTerrainPatch>& Pair : StreamedPatches)
+	{
+		//Generating patches are evicted once their result is in
+		if (!Pair.Value.bVisible && !Pair.Value.bGenerating)
+		{
+			Hidden.Add(Pair.Key);
+		}
+	}
+
+	const int32 NumToEvict = Hidden.Num() - FMath::Max(Params.MaxCachedPatches, 0);
+	if (NumToEvict <= 0)
+	{
+		return;
+	}
+
+	//Least recently visible first
+	Hidden.Sort([this](const FIntPoint& A, const FIntPoint& B)
+	{
+		return StreamedPatches[A].LastVisibleTime < StreamedPatches[B].LastVisibleTime;
+	});
+
+	for (int32 i = 0; i < NumToEvict; i++)
+	{
+		FStreamedTerrainPatch Patch;
+		StreamedPatches.RemoveAndCopyValue(Hidden[i], Patch);
+		ReleasePatchResources(Patch.Product);
+	}
+}
+
+void UTerrainGeneratorChain::ResetStreamedPatches()
+{
+	bStreamingActive = false;
+
+	for (TPair<FIntPoint, FStreamedTerrainPatch>& Pair : StreamedPatches)
+	{
+		ReleasePatchResources(Pair.Value.Product);
+	}
+	StreamedPatches.Empty();
+}
+
+void UTerrainGeneratorChain::AcquirePatchResources(WorkProduct& WorkUnit, AActor* Owner)
+{
+	const EPixelFormat Format = Params.GeneratedTextureType;
+
+	for (int32 i = PooledPatchResources.Num() - 1; i >= 0; i--)
+	{
+		const FTerrainPatchRenderResources& Pooled = PooledPatchResources[i];
+		if (!IsValid(Pooled.Mesh) || !IsValid(Pooled.FloatTexture) || Pooled.Mesh->GetOwner() != Owner)
+		{
+			//Owner went away or was GC'd meanwhile
+			PooledPatchResources.RemoveAtSwap(i);
+			continue;
+		}
+		if (Pooled.PatchSize != Params.PatchSize || Pooled.Format != Format)
+		{
+			continue;
+		}
+
+		WorkUnit.Mesh = Pooled.Mesh;
+		WorkUnit.FloatTexture = Pooled.FloatTexture;
+		WorkUnit.MaterialInstance = Pooled.MaterialInstance;
+		PooledPatchResources.RemoveAtSwap(i);
+
+		WorkUnit.Mesh->SetRelativeLocation(WorkUnit.Origin.GetLocation() * Params.VisualSpacing);
+		WorkUnit.Mesh->SetVisibility(true);
+
+		//Material param may have changed since the instance was made
+		if (!WorkUnit.MaterialInstance || WorkUnit.MaterialInstance->Parent != Params.Material)
+		{
+			WorkUnit.MaterialInstance = WorkUnit.Mesh->CreateDynamicMaterialInstance(0, Params.Material);
 		}
+		return;
 	}
 
-	if (Params.bGenerateCubeQuadSphere)
+	if (Params.bOutputToGeneratedMesh)
 	{
-		GenerateCubeQuadSphere(Data);
+		//Make a UGeneratedMesh and fill dynamic Actor from it
 	}
 	else
 	{
-		GenerateTerrain(Data);
+		//Make a procmeshcomponent to fill with vertex offset texture
+		WorkUnit.GenerateMesh(Owner, Params.PatchSize, true, GetSharedGridMesh(Params.PatchSize));
+		WorkUnit.Mesh->SetBoundsScale(10.f);
+		WorkUnit.Mesh->SetRelativeLocation(WorkUnit.Origin.GetLocation() * Params.VisualSpacing);
+		WorkUnit.MaterialInstance = WorkUnit.Mesh->CreateDynamicMaterialInstance(0, Params.Material);
 	}
 
-	//NB: we need a chain cancel callback so we can stop other threads/etc
-	//bWorkersShouldRun = false
+	//Texture prep
+	WorkUnit.FloatTexture = UHeightmapDeformersLibrary::SquareTextureSized(Params.PatchSize, Format);
 }
 
-void UTerrainGeneratorChain::OnPostProcessChain_Implementation(UPGContextDataObject* Data)
+URealtimeMeshSimple* UTerrainGeneratorChain::GetSharedGridMesh(int32 PatchSize)
 {
-	UE_LOG(LogTemp, Log, TEXT("UTerrainGeneratorChain::OnPostProcessChain_Implementation (Len %d %d %d)"),
-		Data->Context.StringMap.Num(),
-		Data->Context.ObjectMap.Num(),
-		Data->Context.ActorMap.Num());
+	URealtimeMeshSimple*& GridMesh = SharedGridMeshes.FindOrAdd(PatchSize);
+	if (!IsValid(GridMesh))
+	{
+		GridMesh = WorkProduct::BuildGridMesh(this, PatchSize);
+	}
+	return GridMesh;
 }
 
-
-void UTerrainGeneratorChain::OnChainFinished_Implementation(UPGContextDataObject* Data)
+void UTerrainGeneratorChain::ReleasePatchResources(WorkProduct& WorkUnit)
 {
-	UE_LOG(LogTemp, Log, TEXT("UTerrainGeneratorChain::OnChainFinished_Implementation (Len %d %d %d)"),
-		Data->Context.StringMap.Num(),
-		Data->Context.ObjectMap.Num(),
-		Data->Context.ActorMap.Num());
+	if (IsValid(WorkUnit.Mesh) && WorkUnit.FloatTexture && PooledPatchResources.Num() < Params.MaxPooledPatchResources)
+	{
+		WorkUnit.Mesh->SetVisibility(false);
+
+		FTerrainPatchRenderResources& Pooled = PooledPatchResources.AddDefaulted_GetRef();
+		Pooled.Mesh = WorkUnit.Mesh;
+		Pooled.MaterialInstance = WorkUnit.MaterialInstance;
+		Pooled.FloatTexture = WorkUnit.FloatTexture;
+		Pooled.PatchSize = WorkUnit.FloatTexture->GetSizeX();
+		Pooled.Format = WorkUnit.FloatTexture->GetPixelFormat();
+	}
+	else if (WorkUnit.Mesh)
+	{
+		WorkUnit.Mesh->DestroyComponent();
+	}
+
+	WorkUnit.Mesh = nullptr;
+	WorkUnit.MaterialInstance = nullptr;
+	WorkUnit.FloatTexture = nullptr;
 }
 
-void EmitEventWithString(UObject* Context, const FString& FunctionName, const FString& Arg)
+void UTerrainGeneratorChain::ReleaseWorkItems()
 {
-	if (!Context->IsValidLowLevelFast())
+	for (WorkProduct& WorkUnit : WorkItems)
 	{
-		return;
+		ReleasePatchResources(WorkUnit);
 	}
-
-	UFunction* Function = Context->FindFunction(FName(FunctionName));
-
-	/*FStrProperty* StrProperty =
-		new FStrProperty(FFieldVariant(Context->GetClass()),
-			TEXT("StringValue"),
-			EObjectFlags::RF_Public | EObjectFlags::RF_LoadCompleted);
-
-	TArray<uint8> Buffer;
-	Buffer.SetNum(Arg.GetAllocatedSize());
-	StrProperty->SetPropertyValue_InContainer(Buffer.GetData(), Arg);*/
-
-	Context->ProcessEvent(Function, (void*)&Arg/*Buffer.GetData()*/);
-
-	//delete StrProperty;
+	WorkItems.Reset();
 }
 
-void UTerrainGeneratorChain::GenerateTerrain(UPGContextDataObject* Data)
+FPatchKey UTerrainGeneratorChain::PatchKeyForOrigin(const FTransform& Origin)
 {
-	//Default params
-	UObject* Callback = nullptr;
-	UArrayWrapper* FloatWrapper = NewObject<UArrayWrapper>(this);	
+	//Flat terrain: face 0, depth 0, origin is the integer patch coordinate
+	const FVector Location = Origin.GetLocation();
+	return FPatchKey(0, 0, FMath::FloorToInt(Location.X), FMath::FloorToInt(Location.Y));
+}
 
-	//for reflection signalling
-	if (Data->Context.ObjectMap.Contains(TEXT("Callback")))
+FPatchHeightData UTerrainGeneratorChain::FindStoredPatch(const FPatchKey& Key)
+{
+	FPatchHeightData CachedHeights = PatchHeightCache.Find(Key);
+	if (CachedHeights.IsValid())
 	{
-		Callback = Data->Context.ObjectMap[TEXT("Callback")];
+		return CachedHeights;
 	}
 
-	//Start temp organization of work groups
-	//Generate temp workgrid, string as x,y, current work product
-
-	Params.Debug2DResults.Empty();
-
-	int32 GridSize = Params.ComputeGridSize;
-	float Spacing = Params.VisualSpacing;
-	bSafeToAccessGrid = false;
-
-	for (int32 Y = 0; Y < GridSize; Y++)
+	const int32 ExpectedNum = Params.PatchSize * Params.PatchSize;
+	TArray<float> DiskHeights;
+	if (Params.bPersistPatches && PatchDiskStore.Read(Key, DiskHeights, ExpectedNum))
 	{
-		for (int32 X = 0; X < GridSize; X++)
-		{
-			WorkProduct NewProduct;
-			NewProduct.Origin.SetLocation(FVector(X, Y, 0));
-			NewProduct.FloatData = UHeightmapDeformersLibrary::SquareFloatMapSized(Params.PatchSize);
-			WorkGrid.Enqueue(NewProduct);
-		}
+		return PatchHeightCache.Add(Key, MoveTemp(DiskHeights));
 	}
+	return nullptr;
+}
 
-	//Initialize as ready;
-	bSafeToAccessGrid = true;
-
-	/*TODO:
-	Specify number of patches or distance from frustrum/sphere to render out
-	in high detail and in low detail. Generate work requests in an atomic array
+FPatchHeightData UTerrainGeneratorChain::StorePatch(const FPatchKey& Key, TArray<float>&& Heights)
+{
+	FPatchHeightData Data = PatchHeightCache.Add(Key, MoveTemp(Heights));
 
-	Run multiple workers one per thread up to desired or pool max.
-	Pull work from work request array.
+	if (Params.bPersistPatches)
+	{
+		PatchDiskStore.Write(Key, *Data);
+	}
+	return Data;
+}
 
-	Call intermediate results in a way that a gamethread can allocate and map results to world visuals
-	(procgen mesh, one per patch). This would be the parent/receiver chain node.
-	*/
-	FloatWrapper->FloatData = UHeightmapDeformersLibrary::SquareFloatMapSized(Params.PatchSize);
-	UTexture2D* OutputTexture = UHeightmapDeformersLibrary::SquareTextureSized(Params.PatchSize);
+void UTerrainGeneratorChain::GenerateSourceHeights(TArray<float>& FloatData, const FTransform& Origin, int32 Border)
+{
+	const int32 Size = Params.PatchSize + 2 * Border;
 
-	//Allow this to be referenced on later threads
-	Data->Context.ObjectMap.Add(TEXT("FloatHeightMap"), FloatWrapper);
-	Data->Context.ObjectMap.Add(TEXT("TextureHeightMap"), OutputTexture);
+	//Perlin Generation
+	if (Params.bUseVectorizedNoise)
+	{
+		FTerrainNoiseKernel::AddFractalNoise(FloatData, Size, NoiseSettingsForOrigin(Origin, Border));
+	}
+	else
+	{
+		UHeightmapDeformersLibrary::PerlinDeformMap(
+			FloatData,
+			Params.Magnitude,
+			Params.Frequency,
+			Params.FrequencyShift + (Origin.GetLocation() * Params.PerlinSpacing) - FVector(Border, Border, 0.f),
+			Params.Seed,
+			Params.Octaves,
+			Params.OctaveFactor,
+			Params.bRidgedSource);
+	}
 
-	bWorkersShouldRun = true;
-	
-	//Run on BG thread - e.g. one work unit
-	Async(EAsyncExecution::ThreadPool, [&, Callback, OutputTexture, FloatWrapper, Data]
+	//Masking Test - assume we are in the correct stack index (~1)
+	if (Params.Masks.bUseMasks)
 	{
-		FTimespan ThreeSeconds = FTimespan(0, 0, 3);
+		//Prep transform for current work unit
+		FTransform WorkUnitSpaced = Origin;
+		WorkUnitSpaced.SetLocation(WorkUnitSpaced.GetLocation() * Params.PerlinSpacing - FVector(Border, Border, 0.f));
 
-		//Continuous work loop
-		while (bWorkersShouldRun && bShouldLatentStillRun)
+		if (Params.Masks.bFuseMaskPass)
 		{
-			while (!bSafeToAccessGrid)
+			//Runs of fusible masks share one pass, others keep their place in the stack order
+			TArray<const FTGMaskReference*> FusedRun;
+			for (const FTGMaskReference& Mask : Params.Masks.Masks)
 			{
-				FPlatformProcess::Sleep(0.01f);
-			}
-			//Grab access to next item in queue
-			bSafeToAccessGrid = false;
-			WorkProduct WorkUnit;
-			bool bFoundWork = WorkGrid.Dequeue(WorkUnit);
-			bSafeToAccessGrid = true;
-
-			if (!bFoundWork)
-			{
-				bWorkersShouldRun = false;
-				Async(EAsyncExecution::TaskGraphMainThread, [&, Callback, FloatWrapper, OutputTexture, Data]
+				if (FTerrainMaskCompositor::CanFuse(Mask))
 				{
-					if (Data->Context.ObjectMap.Contains(TEXT("Params")))
-					{
-						UTerrainGenParams* ParamsWrapper = Cast<UTerrainGenParams>(Data->Context.ObjectMap[TEXT("Params")]);
-
-						//update params back
-						ParamsWrapper->ParamsStruct = Params;
-					}
-					UE_LOG(LogTemp, Log, TEXT("UTerrainGeneratorChain: Full generation complete, resuming from latent"));
-					ResumeChainFromLatentResult();
-				}).WaitFor(ThreeSeconds);
-				break;
+					FusedRun.Add(&Mask);
+					continue;
+				}
+				FTerrainMaskCompositor::ApplyFused(FloatData, Size, WorkUnitSpaced, FusedRun);
+				FusedRun.Reset();
+				ApplyMaskWithLibrary(FloatData, Mask, WorkUnitSpaced);
 			}
-
-			//WorkUnit.FloatData
-
-			//Perlin Generation
-			UHeightmapDeformersLibrary::PerlinDeformMap(
-				WorkUnit.FloatData,
-				Params.Magnitude,
-				Params.Frequency,
-				Params.FrequencyShift + (WorkUnit.Origin.GetLocation() * Params.PerlinSpacing),
-				Params.Seed,
-				Params.Octaves,
-				Params.OctaveFactor,
-				Params.bRidgedSource);
-
-			//Masking Test - assume we are in the correct stack index (~1)
-			if (Params.Masks.bUseMasks)
+			FTerrainMaskCompositor::ApplyFused(FloatData, Size, WorkUnitSpaced, FusedRun);
+		}
+		else
+		{
+			for (const FTGMaskReference& Mask : Params.Masks.Masks)
 			{
-				//Prep transform for current work unit
-				FTransform WorkUnitSpaced = WorkUnit.Origin;
-				WorkUnitSpaced.SetLocation(WorkUnitSpaced.GetLocation() * Params.PerlinSpacing);
-
-				for (FTGMaskReference& Mask : Params.Masks.Masks)
-				{
-					if (Mask.MaskChainOp != nullptr)
-					{
-						//TODO: define a chain op that would work here...
-						//Custom work, this should be using the chain instead of built in work...
-						UHeightmapDeformersLibrary::DeformTerrainByMask(
-							WorkUnit.FloatData,
-							Mask.MaskFloatArray,
-							WorkUnitSpaced,
-							Mask.MaskTransform,
-							[](float TerrainPixel, float MaskPixel, float MaskScale)
-							{
-								//Hard cutoff deformer
-								if (MaskPixel > 0.5f)
-								{
-									return TerrainPixel + (TerrainPixel * MaskScale);
-								}
-								else
-								{
-									return TerrainPixel;
-								}
-							}, Mask.MaskScale);
-					}
-					//Apply default ops (add/sub/multiply etc
-					else if (Mask.MaskDefaultOp != EFloatAppendTypes::None)
-					{
-						UHeightmapDeformersLibrary::DeformTerrainByMaskOp(
-							WorkUnit.FloatData,
-							Mask.MaskFloatArray,
-							WorkUnitSpaced,
-							Mask.MaskTransform,
-							Mask.MaskDefaultOp, Mask.MaskScale);
-					}
-				}
+				ApplyMaskWithLibrary(FloatData, Mask, WorkUnitSpaced);
 			}
+		}
+	}
+}
 
-			//Call with result signal
-			Async(EAsyncExecution::TaskGraphMainThread, [&, Callback, FloatWrapper, Data]
-			{
-				if (!bShouldLatentStillRun)
-				{
-					//Exit early
-					return;
-				}
+FTerrainNoiseSettings UTerrainGeneratorChain::NoiseSettingsForOrigin(const FTransform& Origin, int32 Border) const
+{
+	const FVector Shift = Params.FrequencyShift + (Origin.GetLocation() * Params.PerlinSpacing) - FVector(Border, Border, 0.f);
+
+	FTerrainNoiseSettings Settings;
+	Settings.Magnitude = Params.Magnitude;
+	Settings.Frequency = Params.Frequency;
+	Settings.Shift = FVector2f(Shift.X, Shift.Y);
+	Settings.Seed = Params.Seed;
+	Settings.Octaves = Params.Octaves;
+	Settings.OctaveFactor = Params.OctaveFactor;
+	Settings.bRidged = Params.bRidgedSource;
+	return Settings;
+}
 
-				//Allocate if needed
-				if (!WorkUnit.Mesh)
-				{
-					AActor* Owner = Data->Context.ActorMap[TEXT("Origin")];
+FTerrainNoiseBenchmark UTerrainGeneratorChain::BenchmarkNoise(int32 Iterations)
+{
+	FTerrainNoiseBenchmark Result;
+	Iterations = FMath::Max(Iterations, 1);
 
-					if (Params.bOutputToGeneratedMesh)
-					{
-						//Make a UGeneratedMesh and fill dynamic Actor from it
-					}
-					else
-					{
-						//Make a procmeshcomponent to fill with vertex offset texture
-						WorkUnit.GenerateMesh(Owner, Params.PatchSize);
-						WorkUnit.Mesh->SetBoundsScale(10.f);
-						WorkUnit.Mesh->SetRelativeLocation(WorkUnit.Origin.GetLocation() * Params.VisualSpacing);
-						WorkUnit.MaterialInstance = WorkUnit.Mesh->CreateDynamicMaterialInstance(0, Params.Material);
-					}
-					
-					//Texture prep
-					WorkUnit.FloatTexture = UHeightmapDeformersLibrary::SquareTextureSized(Params.PatchSize, Params.GeneratedTextureType);
-				}
+	const int32 Size = Params.PatchSize;
+	const double SampleCount = double(Size) * Size * Iterations;
+	const FTransform Origin;
+	const FTerrainNoiseSettings Settings = NoiseSettingsForOrigin(Origin);
 
-				UE_LOG(LogTemp, Log, TEXT("UTerrainGeneratorChain: Source generation complete"));
-				//Update texture - this might be callable on bg thread since allocation was on game thread. Worst case: copy on render thread
-				UHeightmapDeformersLibrary::CopyFloatArrayToTexture(WorkUnit.FloatData, WorkUnit.FloatTexture);
+	TArray<float> LibraryHeights;
+	TArray<float> KernelHeights;
+	TArray<float> ScalarHeights;
 
-				//Apply directly
-				WorkUnit.MaterialInstance->SetTextureParameterValue(FName("Height"), WorkUnit.FloatTexture);
-				WorkUnit.MaterialInstance->SetTextureParameterValue(FName("HeightTex"), WorkUnit.FloatTexture);
-				WorkUnit.MaterialInstance->SetScalarParameterValue(FName("Scale"), 8000.f);
+	double StartTime = FPlatformTime::Seconds();
+	for (int32 i = 0; i < Iterations; i++)
+	{
+		LibraryHeights = UHeightmapDeformersLibrary::SquareFloatMapSized(Size);
+		UHeightmapDeformersLibrary::PerlinDeformMap(
+			LibraryHeights,
+			Params.Magnitude,
+			Params.Frequency,
+			Params.FrequencyShift,
+			Params.Seed,
+			Params.Octaves,
+			Params.OctaveFactor,
+			Params.bRidgedSource);
+	}
+	Result.LibrarySamplesPerSecond = SampleCount / FMath::Max(FPlatformTime::Seconds() - StartTime, SMALL_NUMBER);
 
-				Params.Debug2DResults.AddUnique(WorkUnit.FloatTexture);
+	StartTime = FPlatformTime::Seconds();
+	for (int32 i = 0; i < Iterations; i++)
+	{
+		KernelHeights = UHeightmapDeformersLibrary::SquareFloatMapSized(Size);
+		FTerrainNoiseKernel::AddFractalNoise(KernelHeights, Size, Settings);
+	}
+	Result.KernelSamplesPerSecond = SampleCount / FMath::Max(FPlatformTime::Seconds() - StartTime, SMALL_NUMBER);
 
-				//Signal via callback
-				//SendIntermediateResult(Data, TEXT("SourceHeightMap"));
-			}).WaitFor(ThreeSeconds);
+	StartTime = FPlatformTime::Seconds();
+	for (int32 i = 0; i < Iterations; i++)
+	{
+		ScalarHeights = UHeightmapDeformersLibrary::SquareFloatMapSized(Size);
+		FTerrainNoiseKernel::AddFractalNoiseScalar(ScalarHeights, Size, Settings);
+	}
+	Result.ScalarSamplesPerSecond = SampleCount / FMath::Max(FPlatformTime::Seconds() - StartTime, SMALL_NUMBER);
 
+	for (int32 i = 0; i < KernelHeights.Num() && i < ScalarHeights.Num(); i++)
+	{
+		Result.MaxKernelError = FMath::Max(Result.MaxKernelError, FMath::Abs(KernelHeights[i] - ScalarHeights[i]));
+	}
 
-			//Erode
-			if (Params.bApplyErosion)
-			{
-				UHeightmapDeformersLibrary::HydraulicErosionOnHeightMapWithInterrupt(WorkUnit.FloatData, Params.HydroParams, [this]()
-				{
-					return !bShouldLatentStillRun;
-				});
+	//Kernel seeds and octaves are its own, so this measures how different the fields are rather than an error
+	for (int32 i = 0; i < KernelHeights.Num() && i < LibraryHeights.Num(); i++)
+	{
+		Result.MaxLibraryDifference = FMath::Max(Result.MaxLibraryDifference, FMath::Abs(KernelHeights[i] - LibraryHeights[i]));
+	}
 
-				//Call with result signal		
-				Async(EAsyncExecution::TaskGraphMainThread, [&, Callback, Data]
-				{
-					//long running op, check that we're still valid
-					if (!bShouldLatentStillRun)
-					{
-						//Exit early
-						return;
-					}
+	UE_LOG(LogTemp, Log, TEXT("UTerrainGeneratorChain::BenchmarkNoise %d^2 x%d: library %.1f Ms/s, kernel %.1f Ms/s, scalar %.1f Ms/s, max kernel error %g, max library difference %g (different noise field)"),
+		Size, Iterations,
+		Result.LibrarySamplesPerSecond / 1000000.0,
+		Result.KernelSamplesPerSecond / 1000000.0,
+		Result.ScalarSamplesPerSecond / 1000000.0,
+		Result.MaxKernelError,
+		Result.MaxLibraryDifference);
 
-					UE_LOG(LogTemp, Log, TEXT("UTerrainGeneratorChain: Erosion complete"));
-					UHeightmapDeformersLibrary::CopyFloatArrayToTexture(WorkUnit.FloatData, WorkUnit.FloatTexture);
+	return Result;
+}
 
-					WorkUnit.MaterialInstance->SetTextureParameterValue(FName("Height"), WorkUnit.FloatTexture);
-					WorkUnit.MaterialInstance->SetTextureParameterValue(FName("HeightTex"), WorkUnit.FloatTexture);
+bool UTerrainGeneratorChain::UsesTiledErosion() const
+{
+	return Params.bApplyErosion && Params.bUseTiledErosion;
+}
 
-					Params.Debug2DResults.AddUnique(WorkUnit.FloatTexture);
+int32 UTerrainGeneratorChain::ErosionSeamHalo() const
+{
+	//Droplets starting at the seam have to stay inside the halo, otherwise the neighbours erode them differently
+	return UsesTiledErosion() ? FMath::Max(Params.ErosionSettings.SeamHalo, FTerrainErosionKernel::DropletReach(Params.ErosionSettings)) : 0;
+}
 
-					//Signal via callback
-					//SendIntermediateResult(Data, TEXT("ErodedHeightMap"));
-				}).WaitFor(ThreeSeconds);
-			}
+uint32 UTerrainGeneratorChain::ComputeHeightParamsHash() const
+{
+	//Everything that changes generated heights, presentation params are left out
+	FString Key = FString::Printf(TEXT("%d|%d|%d|%f|%s|%f|%d|%f|%d|%d|%f|"),
+		Params.bUseVectorizedNoise,
+		Params.Seed,
+		Params.PatchSize,
+		Params.Frequency,
+		*Params.FrequencyShift.ToString(),
+		Params.Magnitude,
+		Params.Octaves,
+		Params.OctaveFactor,
+		Params.bRidgedSource,
+		Params.bApplyErosion,
+		Params.PerlinSpacing);
+
+	if (UsesTiledErosion())
+	{
+		Key += TEXT("|Tiled|");
+		FTerrainErosionSettings::StaticStruct()->ExportText(Key, &Params.ErosionSettings, nullptr, nullptr, PPF_None, nullptr);
+	}
+	else if (Params.bApplyErosion)
+	{
+		FHydroErosionParams::StaticStruct()->ExportText(Key, &Params.HydroParams, nullptr, nullptr, PPF_None, nullptr);
+	}
 
-			//Done, resume chain on game thread
-			Async(EAsyncExecution::TaskGraphMainThread, [&]
-			{
-				UE_LOG(LogTemp, Log, TEXT("UTerrainGeneratorChain: WorkProduct done: %1.3f, %1.3f"), WorkUnit.Origin.GetLocation().X, WorkUnit.Origin.GetLocation().Y);
-				//old end point
-				//UE_LOG(LogTemp, Log, TEXT("UTerrainGeneratorChain: Full generation complete, resuming from latent"));
-				//ResumeChainFromLatentResult();
-			}).WaitFor(ThreeSeconds);
-
-			//Sleep 10ms between work checks
-			FPlatformProcess::Sleep(0.01f);
-
-			//temp one loop
-			//bWorkersShouldRun = false;
-		}//end while run
-	});
+	if (Params.Masks.bUseMasks)
+	{
+		Key += Params.Masks.bFuseMaskPass ? TEXT("|Fused") : TEXT("|Library");
+		for (const FTGMaskReference& Mask : Params.Masks.Masks)
+		{
+			//Texture content, not just its path, so reimported or edited masks don't hit stale patches
+			Key += FString::Printf(TEXT("|%s|%s|%08x|%s|%f|%d|%s|%d"),
+				*GetPathNameSafe(Mask.MaskTexture),
+				Mask.MaskTexture ? *Mask.MaskTexture->LightingGuid.ToString() : TEXT(""),
+				FCrc::MemCrc32(Mask.MaskFloatArray.GetData(), Mask.MaskFloatArray.Num() * sizeof(float)),
+				*Mask.MaskTransform.ToString(),
+				Mask.MaskScale,
+				Mask.StackIndex,
+				*GetPathNameSafe(Mask.MaskChainOp ? Mask.MaskChainOp->GetClass() : nullptr),
+				(int32)Mask.MaskDefaultOp);
+		}
+	}
 
-	//Idle downstream chain until ResumeChainFromLatentResult is called.
-	WaitForLatentResponse();
+	return FCrc::StrCrc32(*Key);
 }
 
 void UTerrainGeneratorChain::GenerateCubeQuadSphere(UPGContextDataObject* Data)
@@ -341,14 +1252,22 @@ void UTerrainGeneratorChain::GenerateCubeQuadSphere(UPGContextDataObject* Data)
 			Mask.MaskFloatArray = UHeightmapDeformersLibrary::Conv_GreyScaleTexture2DToFloatArray(Mask.MaskTexture);
 		}
 	}*/
+	if (DeferUntilWorkersExited(&UTerrainGeneratorChain::GenerateCubeQuadSphere, Data))
+	{
+		return;
+	}
+
 	bWorkersShouldRun = true;
+	FPGCancellationTokenRef Token = GetCancellationToken();
+	TerrainRunToken = Token;
 
 	//Run on BG thread - e.g. one work unit
-	Async(EAsyncExecution::ThreadPool, [&, Data]
+	ActiveTerrainWorkers.Increment();
+	Async(EAsyncExecution::ThreadPool, [&, Token, Data]
 	{
-		const FTimespan ThreeSeconds = FTimespan(0, 0, 3);
+		FPGCancellationToken::FWorkScope WorkScope(Token);
 
-		while(bWorkersShouldRun && bShouldLatentStillRun)
+		while(bWorkersShouldRun && !Token->IsCancelled())
 		{
 			//Work loop
 			WorkProduct WorkUnit;
@@ -357,10 +1276,19 @@ void UTerrainGeneratorChain::GenerateCubeQuadSphere(UPGContextDataObject* Data)
 			AActor* Owner = Data->Context.ActorMap[TEXT("Origin")];
 
 			//Make the procmesh
-			Async(EAsyncExecution::TaskGraphMainThread, [&]
-			{				
+			WaitForGameThreadTask(Token, [&, Token]
+			{
+				if (Token->IsCancelled())
+				{
+					return;
+				}
 				WorkUnit.GenerateMesh(Owner, Params.PatchSize, false);
-			}).WaitFor(ThreeSeconds);
+			});
+
+			if (Token->IsCancelled() || !WorkUnit.Mesh)
+			{
+				break;
+			}
 
 			FCubicSphere CubicSphere = FCubicSphere(WorkUnit.Mesh);
 			FCubicSphereParams CubicParams;
@@ -376,28 +1304,58 @@ void UTerrainGeneratorChain::GenerateCubeQuadSphere(UPGContextDataObject* Data)
 			CubicParams.bQuadSplit = Params.bQuadSplit;
 			CubicParams.QuadBaseline = Params.CubeQuadBaseline;
 			CubicParams.QuadDepth = Params.CubeQuadMaxDepth;
+			CubicParams.MergeHysteresis = Params.QuadMergeHysteresis;
+			CubicParams.bStitchEdges = Params.bStitchQuadEdges;
+			if (CubicParams.bStitchEdges && CubicParams.bQuadSplit && !FStitchedGridIndexCache::CanStitch(CubicParams.Resolution))
+			{
+				UE_LOG(LogTemp, Warning, TEXT("GenerateCubeQuadSphere: QuadPatchResolution %d can't stitch edges, use an odd resolution"), CubicParams.Resolution);
+			}
 			CubicParams.WorldOrigin = Owner->GetActorLocation() + WorkUnit.Mesh->GetRelativeLocation();
 			WorkUnit.Mesh->SetRelativeLocation(CubicParams.WorldOrigin);
 
-			//Callback for patch code gen given current data
-			TFunction<void(FMeshSectionData&)> GenerateCallback = [&](FMeshSectionData& Data)
+			//Perlin Generation, only reads params so tip nodes can run it concurrently
+			TFunction<void(FMeshSectionData&)> DeformCallback = MakeQuadDeformCallback(WorkUnit.Origin);
+
+			if (Params.bParallelQuadFaces)
 			{
+				TArray<FCubicSphereSection> Sections;
+				TSharedPtr<FCubicSphere, ESPMode::ThreadSafe> Sphere;
+
+				if (CubicParams.bQuadSplit)
+				{
+					//Kept after generation, later LOD updates diff against this quadtree
+					Sphere = MakeShared<FCubicSphere, ESPMode::ThreadSafe>(WorkUnit.Mesh);
+
+					TArray<FPatchKey> Removed;
+					Sphere->GenerateCubeIncremental(CubicParams, Sections, Removed, DeformCallback);
+				}
+				else
+				{
+					CubicSphere.GenerateCubeStreams(CubicParams, Sections, DeformCallback);
+				}
+
+				WaitForGameThreadTask(Token, [&, Token]
+				{
+					if (Token->IsCancelled() || !IsValid(WorkUnit.Mesh))
+					{
+						return;
+					}
+					FCubicSphere::ApplySections(WorkUnit.Mesh, Sections);
 
-				//Perlin Generation
+					QuadSphere = Sphere;
+					QuadSphereParams = CubicParams;
+					QuadSphereOrigin = WorkUnit.Origin;
+					QuadSphereMesh = Sphere.IsValid() ? WorkUnit.Mesh : nullptr;
+				});
 
-				//Assume we have centered generation
-				FVector Center = FVector(0.f);
+				bWorkersShouldRun = false;
+				break;
+			}
 
-				UHeightmapDeformersLibrary::PerlinDeformMeshAlongCenter(
-					Data.Vertices,
-					Center,
-					Params.Magnitude,
-					Params.Frequency,
-					Params.FrequencyShift + (WorkUnit.Origin.GetLocation() * Params.PerlinSpacing),
-					Params.Seed,
-					Params.Octaves,
-					Params.OctaveFactor,
-					Params.bRidgedSource);
+			//Callback for patch code gen given current data
+			TFunction<void(FMeshSectionData&)> GenerateCallback = [&](FMeshSectionData& Data)
+			{
+				DeformCallback(Data);
 
 				//Masking -> need to convert patch from vertices to a float array and then back
 				//Use normal to convert?
@@ -450,8 +1408,12 @@ void UTerrainGeneratorChain::GenerateCubeQuadSphere(UPGContextDataObject* Data)
 				//((URuntimeMeshProviderStatic*)Data.Mesh->GetProvider())->UpdateSectionFromComponents(0, 0, Data.Vertices, Data.Triangles, Data.Normals, Data.UVs, Data.VertexColors, Data.Tangents);
 
 
-				Async(EAsyncExecution::TaskGraphMainThread, [&]
+				WaitForGameThreadTask(Token, [&, Token]
 				{
+					if (Token->IsCancelled())
+					{
+						return;
+					}
 					//This is broken atm, need to fix the provider api change
 
 					/*URuntimeMeshProviderStatic* Provider = (URuntimeMeshProviderStatic*)Data.Mesh->GetProvider();
@@ -482,7 +1444,7 @@ void UTerrainGeneratorChain::GenerateCubeQuadSphere(UPGContextDataObject* Data)
 						Data.Normals, Data.UVs,
 						Data.VertexColors, Data.Tangents,
 						false);*/
-				}).WaitFor(FTimespan(0, 0, 3));
+				});
 			};
 
 			//Callback is per tipnode patch, post gen
@@ -493,108 +1455,190 @@ void UTerrainGeneratorChain::GenerateCubeQuadSphere(UPGContextDataObject* Data)
 			break;
 		}
 
-		//Finish call
-		Async(EAsyncExecution::TaskGraphMainThread, [&, Data]
+		//Stopped or out of budget, a cancelled hop may never run so report without waiting on it
+		if (Token->IsCancelled())
+		{
+			TWeakObjectPtr<UTerrainGeneratorChain> WeakThis = this;
+			AsyncTask(ENamedThreads::GameThread, [WeakThis]
+			{
+				if (WeakThis.IsValid())
+				{
+					WeakThis->OnAsyncWorkCancelled();
+				}
+			});
+		}
+		else
 		{
-			if (Data->Context.ObjectMap.Contains(TEXT("Params")))
+			//Finish call
+			WaitForGameThreadTask(Token, [&, Token, Data]
 			{
-				UTerrainGenParams* ParamsWrapper = Cast<UTerrainGenParams>(Data->Context.ObjectMap[TEXT("Params")]);
+				if (Token->IsCancelled())
+				{
+					return;
+				}
+				if (Data->Context.ObjectMap.Contains(TEXT("Params")))
+				{
+					UTerrainGenParams* ParamsWrapper = Cast<UTerrainGenParams>(Data->Context.ObjectMap[TEXT("Params")]);
 
-				//update params back
-				ParamsWrapper->ParamsStruct = Params;
-			}
-			UE_LOG(LogTemp, Log, TEXT("GenerateCubeQuadSphere: Full generation complete, resuming from latent"));
-			ResumeChainFromLatentResult();
-		}).WaitFor(ThreeSeconds);
+					//update params back
+					ParamsWrapper->ParamsStruct = Params;
+				}
+				UE_LOG(LogTemp, Log, TEXT("GenerateCubeQuadSphere: Full generation complete, resuming from latent"));
+				ResumeChainFromLatentResult();
+			});
+		}
+
+		//Nothing below touches this, destruction may proceed from here
+		ActiveTerrainWorkers.Decrement();
 	});
 
 	//Idle downstream chain until ResumeChainFromLatentResult is called.
 	WaitForLatentResponse();
 }
 
-void WorkProduct::GenerateMesh(AActor* Owner, int32 PatchSize, bool bWelded)
+void UTerrainGeneratorChain::UpdateCubeQuadSphereLOD(FVector CameraWorldVector)
 {
-	Mesh = NewObject<URealtimeMeshComponent>(Owner);
+	if (!QuadSphere.IsValid() || !IsValid(QuadSphereMesh))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UpdateCubeQuadSphereLOD: No quad split sphere, run GenerateCubeQuadSphere with bQuadSplit first"));
+		return;
+	}
 
-	if (bWelded)
+	//One update in flight at a time, callers keep sending the latest camera
+	if (bQuadLODUpdating)
+	{
+		return;
+	}
+	bQuadLODUpdating = true;
+
+	Params.QuadCameraWorldVector = CameraWorldVector;
+	QuadSphereParams.WorldCamera = CameraWorldVector;
+
+	TWeakObjectPtr<UTerrainGeneratorChain> WeakThis(this);
+	TSharedPtr<FCubicSphere, ESPMode::ThreadSafe> Sphere = QuadSphere;
+	const FCubicSphereParams SphereParams = QuadSphereParams;
+	TFunction<void(FMeshSectionData&)> DeformCallback = MakeQuadDeformCallback(QuadSphereOrigin);
+
+	Async(EAsyncExecution::ThreadPool, [WeakThis, Sphere, SphereParams, DeformCallback]
 	{
-		TArray<int32> Triangles;
-		TArray<FVector> Vertices, Normals;
-		TArray<FVector2D> UVs;
-		TArray<FLinearColor> VertexColors;
-		TArray<FRealtimeMeshTangentsNormalPrecision> Tangents;
+		TArray<FCubicSphereSection> Added;
+		TArray<FPatchKey> Removed;
+		Sphere->GenerateCubeIncremental(SphereParams, Added, Removed, DeformCallback);
 
-		UKismetProceduralMeshLibrary::CreateGridMeshWelded(
-			PatchSize,
-			PatchSize, Triangles, Vertices, UVs);
+		Async(EAsyncExecution::TaskGraphMainThread, [WeakThis, Sphere, Added = MoveTemp(Added), Removed = MoveTemp(Removed)]() mutable
+		{
+			UTerrainGeneratorChain* Chain = WeakThis.Get();
+			if (!Chain)
+			{
+				return;
+			}
+			Chain->bQuadLODUpdating = false;
 
-		// Initialize the mesh
-		URealtimeMeshSimple* RealtimeMesh = Mesh->InitializeRealtimeMesh<URealtimeMeshSimple>();
+			//Sphere was regenerated while this update ran, its sections are gone already
+			if (Chain->QuadSphere != Sphere || !IsValid(Chain->QuadSphereMesh))
+			{
+				return;
+			}
 
-		// Create the stream set
-		FRealtimeMeshStreamSet StreamSet;
+			//Merged parents and split children replace their old tips in the same frame
+			FCubicSphere::RemoveSections(Chain->QuadSphereMesh, Removed);
+			FCubicSphere::ApplySections(Chain->QuadSphereMesh, Added);
+		});
+	});
+}
 
-		// Add streams for your mesh data
-		TRealtimeMeshStreamBuilder<FVector3f> PositionBuilder(StreamSet.AddStream(FRealtimeMeshStreams::Position, GetRealtimeMeshBufferLayout<FVector3f>()));
-		TRealtimeMeshStreamBuilder<FRealtimeMeshTangentsHighPrecision, FRealtimeMeshTangentsNormalPrecision> TangentBuilder(
-			StreamSet.AddStream(FRealtimeMeshStreams::Tangents, GetRealtimeMeshBufferLayout<FRealtimeMeshTangentsNormalPrecision>()));
-		TRealtimeMeshStreamBuilder<FVector2f, FVector2DHalf> TexCoordsBuilder(StreamSet.AddStream(FRealtimeMeshStreams::TexCoords, GetRealtimeMeshBufferLayout<FVector2DHalf>()));
-		TRealtimeMeshStreamBuilder<FColor> ColorBuilder(StreamSet.AddStream(FRealtimeMeshStreams::Color, GetRealtimeMeshBufferLayout<FColor>()));
-		TRealtimeMeshStreamBuilder<TIndex3<uint32>, TIndex3<uint16>> TrianglesBuilder(StreamSet.AddStream(FRealtimeMeshStreams::Triangles, GetRealtimeMeshBufferLayout<TIndex3<uint16>>()));
+TFunction<void(FMeshSectionData&)> UTerrainGeneratorChain::MakeQuadDeformCallback(const FTransform& Origin) const
+{
+	//Noise fields only, Params also carries mask arrays
+	const float Magnitude = Params.Magnitude;
+	const float Frequency = Params.Frequency;
+	const FVector FrequencyShift = Params.FrequencyShift + (Origin.GetLocation() * Params.PerlinSpacing);
+	const int32 Seed = Params.Seed;
+	const int32 Octaves = Params.Octaves;
+	const float OctaveFactor = Params.OctaveFactor;
+	const bool bRidgedSource = Params.bRidgedSource;
+
+	return [=](FMeshSectionData& Data)
+	{
+		//Assume we have centered generation
+		FVector Center = FVector(0.f);
+
+		UHeightmapDeformersLibrary::PerlinDeformMeshAlongCenter(
+			Data.Vertices,
+			Center,
+			Magnitude,
+			Frequency,
+			FrequencyShift,
+			Seed,
+			Octaves,
+			OctaveFactor,
+			bRidgedSource);
+	};
+}
 
-		// Reserve space based on the array sizes
-		PositionBuilder.Reserve(Vertices.Num());
-		TangentBuilder.Reserve(Tangents.Num());
-		ColorBuilder.Reserve(VertexColors.Num());
-		TexCoordsBuilder.Reserve(UVs.Num());
-		TrianglesBuilder.Reserve(Triangles.Num() / 3); // Dividing by 3 since each triangle has 3 indices
+URealtimeMeshSimple* WorkProduct::BuildGridMesh(UObject* Outer, int32 PatchSize)
+{
+	FCanonicalGridMeshRef Grid = FCanonicalGridMeshCache::Get().FindOrCreate(PatchSize, PatchSize);
 
-		// Fill the streams with your data
-		for (int32 i = 0; i < Vertices.Num(); i++)
-		{
-			int32 VIndex = PositionBuilder.Add(FVector3f(Vertices[i]));
-			TangentBuilder.Add(FRealtimeMeshTangentsHighPrecision(FVector3f(Normals[i]), Tangents[i].GetTangent()));
-			ColorBuilder.Add(VertexColors.IsValidIndex(i) ? VertexColors[i].ToFColor(true) : FColor::White);  // Optional: use white if no color
-			TexCoordsBuilder.Add(UVs.IsValidIndex(i) ? FVector2f(UVs[i]) : FVector2f(0.0f, 0.0f));  // Optional: use default UV if not provided
-		}
+	URealtimeMeshSimple* RealtimeMesh = NewObject<URealtimeMeshSimple>(Outer);
 
-		// Add triangles
-		for (int32 i = 0; i < Triangles.Num(); i += 3)
-		{
-			TrianglesBuilder.Add(TIndex3<uint32>(Triangles[i], Triangles[i + 1], Triangles[i + 2]));
-		}
+	// Create the stream set
+	FRealtimeMeshStreamSet StreamSet;
+
+	// Add streams for your mesh data
+	TRealtimeMeshStreamBuilder<FVector3f> PositionBuilder(StreamSet.AddStream(FRealtimeMeshStreams::Position, GetRealtimeMeshBufferLayout<FVector3f>()));
+	TRealtimeMeshStreamBuilder<FRealtimeMeshTangentsHighPrecision, FRealtimeMeshTangentsNormalPrecision> TangentBuilder(
+		StreamSet.AddStream(FRealtimeMeshStreams::Tangents, GetRealtimeMeshBufferLayout<FRealtimeMeshTangentsNormalPrecision>()));
+	TRealtimeMeshStreamBuilder<FVector2f, FVector2DHalf> TexCoordsBuilder(StreamSet.AddStream(FRealtimeMeshStreams::TexCoords, GetRealtimeMeshBufferLayout<FVector2DHalf>()));
+	TRealtimeMeshStreamBuilder<FColor> ColorBuilder(StreamSet.AddStream(FRealtimeMeshStreams::Color, GetRealtimeMeshBufferLayout<FColor>()));
+
+	//512^2 patches are past 16 bit indices
+	TRealtimeMeshStreamBuilder<TIndex3<uint32>> TrianglesBuilder(StreamSet.AddStream(FRealtimeMeshStreams::Triangles, GetRealtimeMeshBufferLayout<TIndex3<uint32>>()));
 
-		// Setup material slots (Optional, based on your use case)
-		RealtimeMesh->SetupMaterialSlot(0, "MaterialSlot0");
+	PositionBuilder.Reserve(Grid->Vertices.Num());
+	TangentBuilder.Reserve(Grid->Vertices.Num());
+	ColorBuilder.Reserve(Grid->Vertices.Num());
+	TexCoordsBuilder.Reserve(Grid->UVs.Num());
+	TrianglesBuilder.Reserve(Grid->Triangles.Num() / 3);
+
+	//Flat grid (kismet grid spacing), height comes from the material's vertex offset texture
+	const float GridSpacing = 16.f;
+	const FRealtimeMeshTangentsHighPrecision FlatTangents(FVector3f::UpVector, FVector3f::ForwardVector);
+
+	for (int32 i = 0; i < Grid->Vertices.Num(); i++)
+	{
+		PositionBuilder.Add(Grid->Vertices[i] * GridSpacing);
+		TangentBuilder.Add(FlatTangents);
+		ColorBuilder.Add(FColor::White);
+		TexCoordsBuilder.Add(Grid->UVs[i]);
+	}
 
-		// Create the group and section keys
-		const FRealtimeMeshSectionGroupKey GroupKey = FRealtimeMeshSectionGroupKey::Create(0, FName("MeshGroup"));
-		const FRealtimeMeshSectionKey SectionKey = FRealtimeMeshSectionKey::CreateForPolyGroup(GroupKey, 0);
+	for (int32 i = 0; i < Grid->Triangles.Num(); i += 3)
+	{
+		TrianglesBuilder.Add(TIndex3<uint32>(Grid->Triangles[i], Grid->Triangles[i + 1], Grid->Triangles[i + 2]));
+	}
 
-		// Create the section group
-		RealtimeMesh->CreateSectionGroup(GroupKey, StreamSet);
+	RealtimeMesh->SetupMaterialSlot(0, "MaterialSlot0");
 
-		// Update the section configuration
-		RealtimeMesh->UpdateSectionConfig(SectionKey, FRealtimeMeshSectionConfig(0));
+	const FRealtimeMeshSectionGroupKey GroupKey = FRealtimeMeshSectionGroupKey::Create(0, FName("MeshGroup"));
+	const FRealtimeMeshSectionKey SectionKey = FRealtimeMeshSectionKey::CreateForPolyGroup(GroupKey, 0);
 
+	RealtimeMesh->CreateSectionGroup(GroupKey, StreamSet);
+	RealtimeMesh->UpdateSectionConfig(SectionKey, FRealtimeMeshSectionConfig(0));
 
+	return RealtimeMesh;
+}
 
-		//NB: tangents might currently not be set due to PMC ones being used for now
-		//StaticProvider->CreateSectionFromComponents(0, 0, 0, RMC_ConvertTArray<FVector3f>(Vertices), Triangles, RMC_ConvertTArray<FVector3f>(Normals), RMC_ConvertTArray<FVector2f>(UVs), VertexColors, Tangents, ERealtimeMeshUpdateFrequency::Infrequent, false);
-		
+void WorkProduct::GenerateMesh(AActor* Owner, int32 PatchSize, bool bWelded, URealtimeMeshSimple* SharedGridMesh)
+{
+	Mesh = NewObject<URealtimeMeshComponent>(Owner);
 
-		//Update Loop Notes
-		//((URuntimeMeshProviderStatic*)DrawingReceiver->RuntimeMesh->GetProvider())->UpdateSectionFromComponents(0, 0, MeshInfo.Vertices, MeshInfo.Triangles, MeshInfo.Normals, MeshInfo.UV0, MeshInfo.VertexColors, MeshInfo.Tangents);
-		
-		//PMC Note
-		/*Mesh->CreateMeshSection(0,
-			Vertices, Triangles,
-			Normals, UVs,
-			VertexColors, Tangents,
-			false);*/
+	//Patches of one size draw the same grid, per patch data is the transform and height texture
+	if (bWelded)
+	{
+		Mesh->SetRealtimeMesh(SharedGridMesh ? SharedGridMesh : BuildGridMesh(Mesh, PatchSize));
 	}
-	
-	//Mesh->SetRelativeLocation(Origin.GetLocation());
+
 	Owner->AddInstanceComponent(Mesh);
 	Mesh->RegisterComponent();
 }
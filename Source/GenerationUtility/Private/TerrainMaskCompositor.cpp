@@ -0,0 +1,177 @@
+#include "TerrainMaskCompositor.h"
+#include "TerrainGeneratorChain.h"
+#include "Engine/Texture2D.h"
+
+namespace
+{
+	enum class EFusedMaskOp : uint8
+	{
+		Add,
+		HardCutoff
+	};
+
+	/** Mask sample position for texel (x, y) is Origin + StepX * x + StepY * y in mask pixels */
+	struct FPreparedMask
+	{
+		const float* Values;
+		int32 Width;
+		FVector2f Origin;
+		FVector2f StepX;
+		FVector2f StepY;
+		float Scale;
+		EFusedMaskOp Op;
+
+		//Zero outside the mask so patches beyond its footprint are untouched
+		float Sample(float U, float V) const
+		{
+			if (U < 0.f || V < 0.f || U > Width - 1 || V > Width - 1)
+			{
+				return 0.f;
+			}
+
+			const int32 X = FMath::Min(FMath::FloorToInt(U), Width - 2);
+			const int32 Y = FMath::Min(FMath::FloorToInt(V), Width - 2);
+			const float FracX = U - X;
+			const float FracY = V - Y;
+
+			const float* Row = Values + Y * Width + X;
+			const float Top = FMath::Lerp(Row[0], Row[1], FracX);
+			const float Bottom = FMath::Lerp(Row[Width], Row[Width + 1], FracX);
+			return FMath::Lerp(Top, Bottom, FracY);
+		}
+
+		float Apply(float TerrainPixel, float MaskPixel) const
+		{
+			if (Op == EFusedMaskOp::HardCutoff)
+			{
+				//Same as the library chain op deformer in TerrainGeneratorChain.cpp
+				return MaskPixel > 0.5f ? TerrainPixel + (TerrainPixel * Scale) : TerrainPixel;
+			}
+			return TerrainPixel + MaskPixel * Scale;
+		}
+	};
+
+	bool PrepareMask(const FTGMaskReference& Mask, const FTransform& PatchTransform, FPreparedMask& OutPrepared)
+	{
+		const int32 Width = FMath::FloorToInt(FMath::Sqrt(float(Mask.MaskFloatArray.Num())));
+		if (Width < 2 || Width * Width != Mask.MaskFloatArray.Num())
+		{
+			return false;
+		}
+
+		//Patch and mask transforms are affine, three points give the whole mapping
+		auto ToMaskSpace = [&](float X, float Y)
+		{
+			const FVector Position = Mask.MaskTransform.InverseTransformPosition(PatchTransform.TransformPosition(FVector(X, Y, 0.f)));
+			return FVector2f(Position.X, Position.Y);
+		};
+
+		OutPrepared.Values = Mask.MaskFloatArray.GetData();
+		OutPrepared.Width = Width;
+		OutPrepared.Origin = ToMaskSpace(0.f, 0.f);
+		OutPrepared.StepX = ToMaskSpace(1.f, 0.f) - OutPrepared.Origin;
+		OutPrepared.StepY = ToMaskSpace(0.f, 1.f) - OutPrepared.Origin;
+		OutPrepared.Scale = Mask.MaskScale;
+		OutPrepared.Op = Mask.MaskChainOp != nullptr ? EFusedMaskOp::HardCutoff : EFusedMaskOp::Add;
+		return true;
+	}
+}
+
+bool FTerrainMaskCompositor::CanFuse(const FTGMaskReference& Mask)
+{
+	return Mask.MaskChainOp != nullptr || Mask.MaskDefaultOp == EFloatAppendTypes::Add || Mask.MaskDefaultOp == EFloatAppendTypes::None;
+}
+
+void FTerrainMaskCompositor::ApplyFused(TArray<float>& Heights, int32 Size, const FTransform& PatchTransform, const TArray<const FTGMaskReference*>& Masks)
+{
+	if (Heights.Num() != Size * Size)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FTerrainMaskCompositor::ApplyFused expected %d^2 samples, got %d"), Size, Heights.Num());
+		return;
+	}
+
+	TArray<FPreparedMask, TInlineAllocator<8>> Prepared;
+	for (const FTGMaskReference* Mask : Masks)
+	{
+		if (Mask->MaskChainOp == nullptr && Mask->MaskDefaultOp == EFloatAppendTypes::None)
+		{
+			continue;
+		}
+
+		FPreparedMask PreparedMask;
+		if (PrepareMask(*Mask, PatchTransform, PreparedMask))
+		{
+			Prepared.Add(PreparedMask);
+		}
+	}
+
+	if (Prepared.Num() == 0)
+	{
+		return;
+	}
+
+	for (int32 Y = 0; Y < Size; Y++)
+	{
+		float* Row = Heights.GetData() + Y * Size;
+		for (int32 X = 0; X < Size; X++)
+		{
+			float Height = Row[X];
+			for (const FPreparedMask& Mask : Prepared)
+			{
+				const FVector2f MaskPosition = Mask.Origin + Mask.StepX * X + Mask.StepY * Y;
+				Height = Mask.Apply(Height, Mask.Sample(MaskPosition.X, MaskPosition.Y));
+			}
+			Row[X] = Height;
+		}
+	}
+}
+
+FTGMaskFloatCache& FTGMaskFloatCache::Get()
+{
+	static FTGMaskFloatCache Cache;
+	return Cache;
+}
+
+const TArray<float>& FTGMaskFloatCache::Convert(UTexture2D* Texture)
+{
+	static const TArray<float> Empty;
+	if (!Texture)
+	{
+		return Empty;
+	}
+
+	//Few entries but MBs each, conversions of garbage collected textures go here
+	for (auto It = Entries.CreateIterator(); It; ++It)
+	{
+		if (!It.Value().Texture.IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	FEntry& Entry = Entries.FindOrAdd(FObjectKey(Texture));
+	const bool bStale = !Entry.Texture.IsValid() ||
+		Entry.LightingGuid != Texture->LightingGuid ||
+		Entry.SizeX != Texture->GetSizeX() ||
+		Entry.SizeY != Texture->GetSizeY();
+
+	if (bStale)
+	{
+		Entry.Texture = Texture;
+		Entry.LightingGuid = Texture->LightingGuid;
+		Entry.SizeX = Texture->GetSizeX();
+		Entry.SizeY = Texture->GetSizeY();
+		Entry.Values = UHeightmapDeformersLibrary::Conv_GreyScaleTexture2DToFloatArray(Texture);
+	}
+	return Entry.Values;
+}
+
+void FTGMaskFloatCache::Clear()
+{
+	Entries.Empty();
+}
+
+int32 FTGMaskFloatCache::Num() const
+{
+	return Entries.Num();
+}
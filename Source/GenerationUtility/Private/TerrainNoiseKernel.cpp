@@ -0,0 +1,241 @@
+#include "TerrainNoiseKernel.h"
+#include "Math/VectorRegister.h"
+#include "Math/RandomStream.h"
+
+namespace
+{
+	//Ken Perlin's reference permutation, repeated so lookups of index + 1 and hash + y don't wrap
+	const int32 Permutation[512] =
+	{
+		151, 160, 137, 91, 90, 15, 131, 13, 201, 95, 96, 53, 194, 233, 7, 225,
+		140, 36, 103, 30, 69, 142, 8, 99, 37, 240, 21, 10, 23, 190, 6, 148,
+		247, 120, 234, 75, 0, 26, 197, 62, 94, 252, 219, 203, 117, 35, 11, 32,
+		57, 177, 33, 88, 237, 149, 56, 87, 174, 20, 125, 136, 171, 168, 68, 175,
+		74, 165, 71, 134, 139, 48, 27, 166, 77, 146, 158, 231, 83, 111, 229, 122,
+		60, 211, 133, 230, 220, 105, 92, 41, 55, 46, 245, 40, 244, 102, 143, 54,
+		65, 25, 63, 161, 1, 216, 80, 73, 209, 76, 132, 187, 208, 89, 18, 169,
+		200, 196, 135, 130, 116, 188, 159, 86, 164, 100, 109, 198, 173, 186, 3, 64,
+		52, 217, 226, 250, 124, 123, 5, 202, 38, 147, 118, 126, 255, 82, 85, 212,
+		207, 206, 59, 227, 47, 16, 58, 17, 182, 189, 28, 42, 223, 183, 170, 213,
+		119, 248, 152, 2, 44, 154, 163, 70, 221, 153, 101, 155, 167, 43, 172, 9,
+		129, 22, 39, 253, 19, 98, 108, 110, 79, 113, 224, 232, 178, 185, 112, 104,
+		218, 246, 97, 228, 251, 34, 242, 193, 238, 210, 144, 12, 191, 179, 162, 241,
+		81, 51, 145, 235, 249, 14, 239, 107, 49, 192, 214, 31, 181, 199, 106, 157,
+		184, 84, 204, 176, 115, 121, 50, 45, 127, 4, 150, 254, 138, 236, 205, 93,
+		222, 114, 67, 29, 24, 72, 243, 141, 128, 195, 78, 66, 215, 61, 156, 180,
+
+		151, 160, 137, 91, 90, 15, 131, 13, 201, 95, 96, 53, 194, 233, 7, 225,
+		140, 36, 103, 30, 69, 142, 8, 99, 37, 240, 21, 10, 23, 190, 6, 148,
+		247, 120, 234, 75, 0, 26, 197, 62, 94, 252, 219, 203, 117, 35, 11, 32,
+		57, 177, 33, 88, 237, 149, 56, 87, 174, 20, 125, 136, 171, 168, 68, 175,
+		74, 165, 71, 134, 139, 48, 27, 166, 77, 146, 158, 231, 83, 111, 229, 122,
+		60, 211, 133, 230, 220, 105, 92, 41, 55, 46, 245, 40, 244, 102, 143, 54,
+		65, 25, 63, 161, 1, 216, 80, 73, 209, 76, 132, 187, 208, 89, 18, 169,
+		200, 196, 135, 130, 116, 188, 159, 86, 164, 100, 109, 198, 173, 186, 3, 64,
+		52, 217, 226, 250, 124, 123, 5, 202, 38, 147, 118, 126, 255, 82, 85, 212,
+		207, 206, 59, 227, 47, 16, 58, 17, 182, 189, 28, 42, 223, 183, 170, 213,
+		119, 248, 152, 2, 44, 154, 163, 70, 221, 153, 101, 155, 167, 43, 172, 9,
+		129, 22, 39, 253, 19, 98, 108, 110, 79, 113, 224, 232, 178, 185, 112, 104,
+		218, 246, 97, 228, 251, 34, 242, 193, 238, 210, 144, 12, 191, 179, 162, 241,
+		81, 51, 145, 235, 249, 14, 239, 107, 49, 192, 214, 31, 181, 199, 106, 157,
+		184, 84, 204, 176, 115, 121, 50, 45, 127, 4, 150, 254, 138, 236, 205, 93,
+		222, 114, 67, 29, 24, 72, 243, 141, 128, 195, 78, 66, 215, 61, 156, 180,
+	};
+
+	//Grad2 as x/y weights: corners and major axes, picked by hash & 7
+	const float GradX[8] = { 1.f, 1.f, 0.f, -1.f, -1.f, -1.f, 0.f, 1.f };
+	const float GradY[8] = { 0.f, 1.f, 1.f, 1.f, 0.f, -1.f, -1.f, -1.f };
+
+	float SmoothCurve(float X)
+	{
+		return X * X * X * (X * (X * 6.0f - 15.0f) + 10.0f);
+	}
+
+	float OctaveAmplitude(const FTerrainNoiseSettings& Settings, int32 Octave)
+	{
+		return Settings.OctaveFactor > 0.f ? 1.f / FMath::Pow(Settings.OctaveFactor, Octave) : 1.f;
+	}
+
+	float OctaveFrequency(const FTerrainNoiseSettings& Settings, int32 Octave)
+	{
+		return Settings.Frequency * FMath::Pow(Settings.OctaveFactor, Octave);
+	}
+}
+
+float FTerrainNoiseKernel::PerlinNoise2D(float X, float Y)
+{
+	const float Xfl = FMath::FloorToFloat(X);
+	const float Yfl = FMath::FloorToFloat(Y);
+	const int32 Xi = (int32)(Xfl) & 255;
+	const int32 Yi = (int32)(Yfl) & 255;
+	X -= Xfl;
+	Y -= Yfl;
+	const float Xm1 = X - 1.0f;
+	const float Ym1 = Y - 1.0f;
+
+	const int32 AA = Permutation[Xi] + Yi;
+	const int32 AB = AA + 1;
+	const int32 BA = Permutation[Xi + 1] + Yi;
+	const int32 BB = BA + 1;
+
+	const int32 H00 = Permutation[AA] & 7;
+	const int32 H10 = Permutation[BA] & 7;
+	const int32 H01 = Permutation[AB] & 7;
+	const int32 H11 = Permutation[BB] & 7;
+
+	const float U = SmoothCurve(X);
+	const float V = SmoothCurve(Y);
+
+	return FMath::Lerp(
+		FMath::Lerp(GradX[H00] * X + GradY[H00] * Y, GradX[H10] * Xm1 + GradY[H10] * Y, U),
+		FMath::Lerp(GradX[H01] * X + GradY[H01] * Ym1, GradX[H11] * Xm1 + GradY[H11] * Ym1, U),
+		V);
+}
+
+FVector2f FTerrainNoiseKernel::SeedOffset(int32 Seed)
+{
+	//Lattice repeats every 256 units, keep offsets small for float precision
+	FRandomStream Stream(Seed);
+	const float OffsetX = Stream.FRandRange(0.f, 256.f);
+	const float OffsetY = Stream.FRandRange(0.f, 256.f);
+	return FVector2f(OffsetX, OffsetY);
+}
+
+void FTerrainNoiseKernel::AddFractalNoise(TArray<float>& Heights, int32 Size, const FTerrainNoiseSettings& Settings)
+{
+	if (Heights.Num() < Size * Size)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FTerrainNoiseKernel::AddFractalNoise heights smaller than %d^2"), Size);
+		return;
+	}
+
+	for (int32 Y = 0; Y < Size; Y++)
+	{
+		AddFractalRow(Heights.GetData() + Y * Size, Size, Y, Settings);
+	}
+}
+
+void FTerrainNoiseKernel::AddFractalNoiseScalar(TArray<float>& Heights, int32 Size, const FTerrainNoiseSettings& Settings)
+{
+	if (Heights.Num() < Size * Size)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FTerrainNoiseKernel::AddFractalNoiseScalar heights smaller than %d^2"), Size);
+		return;
+	}
+
+	for (int32 Y = 0; Y < Size; Y++)
+	{
+		AddFractalRowScalar(Heights.GetData() + Y * Size, Size, 0, Y, Settings);
+	}
+}
+
+void FTerrainNoiseKernel::AddFractalRowScalar(float* Row, int32 Count, int32 FirstSample, int32 RowIndex, const FTerrainNoiseSettings& Settings)
+{
+	const FVector2f Offset = SeedOffset(Settings.Seed);
+
+	for (int32 Octave = 0; Octave < FMath::Max(Settings.Octaves, 1); Octave++)
+	{
+		const float Frequency = OctaveFrequency(Settings, Octave);
+		const float Amplitude = OctaveAmplitude(Settings, Octave) * Settings.Magnitude;
+		const float Y = (Settings.Shift.Y + RowIndex) * Frequency + Offset.Y;
+
+		for (int32 i = FirstSample; i < Count; i++)
+		{
+			const float X = (Settings.Shift.X + i) * Frequency + Offset.X;
+			float Noise = PerlinNoise2D(X, Y);
+			if (Settings.bRidged)
+			{
+				Noise = 1.f - FMath::Abs(Noise);
+			}
+			Row[i] += Noise * Amplitude;
+		}
+	}
+}
+
+void FTerrainNoiseKernel::AddFractalRow(float* Row, int32 Count, int32 RowIndex, const FTerrainNoiseSettings& Settings)
+{
+	const FVector2f Offset = SeedOffset(Settings.Seed);
+	const int32 VectorCount = Count & ~3;
+
+	const VectorRegister4Float One = VectorOne();
+	const VectorRegister4Float Six = VectorSetFloat1(6.f);
+	const VectorRegister4Float Fifteen = VectorSetFloat1(15.f);
+	const VectorRegister4Float Ten = VectorSetFloat1(10.f);
+	const VectorRegister4Float LaneIndex = MakeVectorRegisterFloat(0.f, 1.f, 2.f, 3.f);
+
+	alignas(16) float Floors[4];
+	alignas(16) float Gx00[4], Gy00[4], Gx10[4], Gy10[4], Gx01[4], Gy01[4], Gx11[4], Gy11[4];
+
+	for (int32 Octave = 0; Octave < FMath::Max(Settings.Octaves, 1); Octave++)
+	{
+		const float Frequency = OctaveFrequency(Settings, Octave);
+		const float Amplitude = OctaveAmplitude(Settings, Octave) * Settings.Magnitude;
+
+		//Whole row shares y, only the x lattice cell differs per lane
+		const float Y = (Settings.Shift.Y + RowIndex) * Frequency + Offset.Y;
+		const float Yfl = FMath::FloorToFloat(Y);
+		const int32 Yi = (int32)(Yfl) & 255;
+		const float Yf = Y - Yfl;
+
+		const VectorRegister4Float VYf = VectorSetFloat1(Yf);
+		const VectorRegister4Float VYm1 = VectorSetFloat1(Yf - 1.f);
+		const VectorRegister4Float V = VectorSetFloat1(SmoothCurve(Yf));
+		const VectorRegister4Float VFrequency = VectorSetFloat1(Frequency);
+		const VectorRegister4Float VAmplitude = VectorSetFloat1(Amplitude);
+
+		for (int32 i = 0; i < VectorCount; i += 4)
+		{
+			//Same expression as the scalar path: (Shift + i) * Frequency + Offset
+			const VectorRegister4Float SampleIndex = VectorAdd(VectorSetFloat1(Settings.Shift.X + i), LaneIndex);
+			const VectorRegister4Float X = VectorMultiplyAdd(SampleIndex, VFrequency, VectorSetFloat1(Offset.X));
+			const VectorRegister4Float Xfl = VectorFloor(X);
+			const VectorRegister4Float Xf = VectorSubtract(X, Xfl);
+			const VectorRegister4Float Xm1 = VectorSubtract(Xf, One);
+
+			//Hash lookups are gathers, do them per lane
+			VectorStoreAligned(Xfl, Floors);
+			for (int32 Lane = 0; Lane < 4; Lane++)
+			{
+				const int32 Xi = (int32)(Floors[Lane]) & 255;
+				const int32 AA = Permutation[Xi] + Yi;
+				const int32 BA = Permutation[Xi + 1] + Yi;
+
+				const int32 H00 = Permutation[AA] & 7;
+				const int32 H10 = Permutation[BA] & 7;
+				const int32 H01 = Permutation[AA + 1] & 7;
+				const int32 H11 = Permutation[BA + 1] & 7;
+
+				Gx00[Lane] = GradX[H00]; Gy00[Lane] = GradY[H00];
+				Gx10[Lane] = GradX[H10]; Gy10[Lane] = GradY[H10];
+				Gx01[Lane] = GradX[H01]; Gy01[Lane] = GradY[H01];
+				Gx11[Lane] = GradX[H11]; Gy11[Lane] = GradY[H11];
+			}
+
+			const VectorRegister4Float G00 = VectorMultiplyAdd(VectorLoadAligned(Gx00), Xf, VectorMultiply(VectorLoadAligned(Gy00), VYf));
+			const VectorRegister4Float G10 = VectorMultiplyAdd(VectorLoadAligned(Gx10), Xm1, VectorMultiply(VectorLoadAligned(Gy10), VYf));
+			const VectorRegister4Float G01 = VectorMultiplyAdd(VectorLoadAligned(Gx01), Xf, VectorMultiply(VectorLoadAligned(Gy01), VYm1));
+			const VectorRegister4Float G11 = VectorMultiplyAdd(VectorLoadAligned(Gx11), Xm1, VectorMultiply(VectorLoadAligned(Gy11), VYm1));
+
+			//U = x^3 * (x * (x * 6 - 15) + 10)
+			const VectorRegister4Float Xf3 = VectorMultiply(VectorMultiply(Xf, Xf), Xf);
+			const VectorRegister4Float U = VectorMultiply(Xf3, VectorMultiplyAdd(Xf, VectorMultiplyAdd(Xf, Six, VectorNegate(Fifteen)), Ten));
+
+			const VectorRegister4Float Bottom = VectorMultiplyAdd(U, VectorSubtract(G10, G00), G00);
+			const VectorRegister4Float Top = VectorMultiplyAdd(U, VectorSubtract(G11, G01), G01);
+			VectorRegister4Float Noise = VectorMultiplyAdd(V, VectorSubtract(Top, Bottom), Bottom);
+
+			if (Settings.bRidged)
+			{
+				Noise = VectorSubtract(One, VectorAbs(Noise));
+			}
+
+			VectorStore(VectorMultiplyAdd(Noise, VAmplitude, VectorLoad(Row + i)), Row + i);
+		}
+	}
+
+	//Tail that doesn't fill a register
+	if (VectorCount < Count)
+	{
+		AddFractalRowScalar(Row, Count, VectorCount, RowIndex, Settings);
+	}
+}
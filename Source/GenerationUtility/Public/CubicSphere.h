@@ -97,6 +97,16 @@ struct FMeshSectionData
 	}
 };
 
+//One tip node's streams, built off the game thread and ready for CreateSectionGroup
+struct FCubicSphereSection
+{
+	int32 Section = 0;
+
+	//Quadtree node (or whole face) the section belongs to, names its section group
+	FPatchKey Key;
+	FRealtimeMeshStreamSet Streams;
+};
+
 //NB: this should probably be a reflected ustruct...
 struct FCubicSphereParams
 {
@@ -114,6 +124,12 @@ struct FCubicSphereParams
 	int32 QuadDepth;
 	int32 QuadBaseline;
 
+	//Incremental updates only merge a subtree once the camera is this much past its split distance
+	float MergeHysteresis;
+
+	//2:1 balanced quadtree with edge stitched indices towards coarser tips, needs an odd Resolution
+	bool bStitchEdges;
+
 	int32 Section;
 	bool bOffsetByDirection;
 
@@ -132,6 +148,8 @@ struct FCubicSphereParams
 		LocalOffset = FVector(0.f);
 		QuadBaseline = 4000.f;
 		QuadDepth = 8;
+		MergeHysteresis = 1.1f;
+		bStitchEdges = false;
 
 		Section = 0;
 		bOffsetByDirection = true;
@@ -145,6 +163,28 @@ public:
 	void GenerateFace(FVector Direction, const FCubicSphereParams& SphereParams, TFunction<void(FMeshSectionData& MeshData)> GenerateCallback);
 	void GenerateCube(const FCubicSphereParams& SphereParams, TFunction<void(FMeshSectionData& MeshData)> GenerateCallback = nullptr);
 
+	/**
+	* Builds every face/tip node in parallel straight into stream sets, one FCubicSphereSection per node.
+	* DeformCallback runs on worker threads with only Vertices filled and must be thread-safe.
+	*/
+	void GenerateCubeStreams(const FCubicSphereParams& SphereParams, TArray<FCubicSphereSection>& OutSections, TFunction<void(FMeshSectionData& MeshData)> DeformCallback = nullptr);
+
+	/**
+	* Quad split mode: moves the existing quadtree to the new camera and only builds the tip nodes that appeared.
+	* Keys of tips that went away go to OutRemoved. First call (or after a resolution change) builds everything.
+	*/
+	void GenerateCubeIncremental(const FCubicSphereParams& SphereParams, TArray<FCubicSphereSection>& OutAdded, TArray<FPatchKey>& OutRemoved,
+		TFunction<void(FMeshSectionData& MeshData)> DeformCallback = nullptr);
+
+	//Game thread: section group per FCubicSphereSection on the mesh component
+	static void ApplySections(URealtimeMeshComponent* MeshComponent, TArray<FCubicSphereSection>& Sections);
+	static void RemoveSections(URealtimeMeshComponent* MeshComponent, const TArray<FPatchKey>& Keys);
+	static FRealtimeMeshSectionGroupKey SectionGroupKey(const FPatchKey& Key);
+
+	//Float normals/tangents for a welded grid from central differences of its positions
+	static void CalculateGridTangents(int32 NumX, int32 NumY, const TArray<FVector3f>& Vertices,
+		TArray<FVector3f>& OutNormals, TArray<FVector3f>& OutTangents);
+
 	//Todo: Specialized for quadtree gen
 	static void CreateQuadGridMeshWelded(int32 NumX, int32 NumY,
 		TArray<int32>& Triangles, TArray<FVector3f>& Vertices,
@@ -153,6 +193,35 @@ public:
 	~FCubicSphere();
 
 protected:
+	struct FCubeFace
+	{
+		FVector Direction;
+		FCubicSphereParams Params;
+		FPatchKey Key;
+		FVector Forward = FVector::ForwardVector;
+		uint8 StitchMask = 0;
+	};
+
+	//Per task buffers of one BuildFaces call, reused across the faces that task builds and freed with the call
+	struct FFaceScratch
+	{
+		FMeshSectionData MeshData;
+		TArray<FVector3f> Tangents;
+	};
+
+	//Node stitch mask in canonical grid edges
+	static uint8 GridStitchMask(const FCubeFace& Face, const FTransform& Transform);
+
+	void AddNodeFace(const FGridQuadNode& Node, const FCubicSphereParams& SphereParams, int32 Section, TArray<FCubeFace>& OutFaces);
+	void BuildFaces(const TArray<FCubeFace>& Faces, TArray<FCubicSphereSection>& OutSections, TFunction<void(FMeshSectionData& MeshData)>& DeformCallback);
+	static FGnomonicParams GnomonicForParams(const FCubicSphereParams& SphereParams);
+
+	//Faces or quadtree tip nodes to generate for these params
+	void CollectFaces(const FCubicSphereParams& SphereParams, TArray<FCubeFace>& OutFaces);
+
+	static FTransform FaceTransform(const FVector& Direction, const FCubicSphereParams& SphereParams, float HalfOffset);
+	void BuildFaceStreams(const FCubeFace& Face, TFunction<void(FMeshSectionData& MeshData)>& DeformCallback, FFaceScratch& Scratch, FCubicSphereSection& OutSection);
+
 	URealtimeMeshComponent* Mesh;
 	TSharedPtr<FPlanetQuad> PlanetQuad;
 };
\ No newline at end of file
@@ -1,12 +1,15 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Async/Future.h"
 #include "GUDataTypes.h"
 #include "EntityPlanningSystem.generated.h"
 
 
 class AEntitySpawningManagerActor;
 class UEntityPlanTrack;
+class UStaticMesh;
 
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FPlanActionSignature, const FInstancedStruct&, InstancedAction, int32, EntityId);
@@ -51,11 +54,33 @@ public:
 
     void ActionFinished(int32 EntityId);
 
+    //Parallel variant of ProcessPendingEntities. Plans are stepped in parallel jobs which emit commands,
+    //applied on the game thread in input order. Unlike the serial path all plans are stepped before any
+    //OnNextAction fires, so script callbacks can't influence plans later in the same batch.
+    UFUNCTION(BlueprintCallable, Category = "EntityPlanHandler Functions")
+    void ProcessPendingEntitiesParallel(const TArray<int32>& IdsNeedingProcessing);
+
     UPROPERTY(BlueprintReadWrite, Category = "EntityPlanHandler Properties")
     UEntityPlanTrack* Track;
 
     UPROPERTY(BlueprintReadWrite, Category = "EntityPlanHandler Properties")
     bool bAutoCompleteActions = true;
+
+    //If set, parallel processing applies FInstancedAction targets/anim data directly to these instances on the track's esm
+    UPROPERTY(BlueprintReadWrite, Category = "EntityPlanHandler Properties")
+    UStaticMesh* NativeActionMesh = nullptr;
+
+    //Custom data float that receives FInstancedAction::AnimCustom when applied natively, -1 to skip
+    UPROPERTY(BlueprintReadWrite, Category = "EntityPlanHandler Properties")
+    int32 NativeAnimCustomDataIndex = -1;
+
+    //Natively applied actions skip OnNextAction unless this is set
+    UPROPERTY(BlueprintReadWrite, Category = "EntityPlanHandler Properties")
+    bool bNotifyScriptForNativeActions = false;
+
+    //Entities stepped per parallel job
+    UPROPERTY(BlueprintReadWrite, Category = "EntityPlanHandler Properties")
+    int32 ParallelBatchSize = 4096;
 };
 
 /**
@@ -135,6 +160,9 @@ class GENERATIONUTILITY_API UEntityPlanTrack: public UObject
 {
     GENERATED_BODY()
 
+    //Parallel processing batches plan lookups and journal marking
+    friend class UPlanProcessor;
+
 public:
     // Constructor
     UEntityPlanTrack();
@@ -187,24 +215,57 @@ public:
     UFUNCTION(BlueprintCallable, Category = "EntityPlanTrack Functions")
     void LoadTrackFromFile(const FString& FileName, bool bIsFullPath = false);
 
+    //Writes a full checkpoint the first time, afterwards only appends entities changed since the last save to <path>.journal
+    UFUNCTION(BlueprintCallable, Category = "EntityPlanTrack Functions")
+    void SaveTrackJournaled(const FString& FileName, bool bIsFullPath = false);
+
+    //Loads the checkpoint and replays the journal on top of it
+    UFUNCTION(BlueprintCallable, Category = "EntityPlanTrack Functions")
+    void LoadTrackJournaled(const FString& FileName, bool bIsFullPath = false);
 
-    //Todo: implement position caching
+    //Folds the journal into a fresh checkpoint, serialization and file io happen on a background thread
+    UFUNCTION(BlueprintCallable, Category = "EntityPlanTrack Functions")
+    void CompactTrackJournal(const FString& FileName, bool bIsFullPath = false);
+
+    UFUNCTION(BlueprintPure, Category = "EntityPlanTrack Functions")
+    bool IsCompactingJournal() const;
+
+
+    //Snapshots positions of all planned entities from the linked esm in one bulk read
     UFUNCTION(BlueprintCallable, Category = "EntityPlanTrack Functions")
     void CacheCurrentEntityPositions(UStaticMesh* ForKey);
 
-    //Todo: implement position caching
+    //Restores the last snapshot into the linked esm with one batched update
     UFUNCTION(BlueprintCallable, Category = "EntityPlanTrack Functions")
     void LoadCurrentEntityPositions(UStaticMesh* ForKey);
 
     UFUNCTION(BlueprintCallable, Category = "EntityPlanTrack Functions")
     void SetESMLink(AEntitySpawningManagerActor* Manager);
 
+    UFUNCTION(BlueprintPure, Category = "EntityPlanTrack Functions")
+    AEntitySpawningManagerActor* GetESMLink() const;
+
 
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "EntityPlanTrack Properties")
     FPGCacheSettings CacheSettings;
 
+    //Journaled saves compact automatically after this many appended deltas, <= 0 disables auto compaction
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "EntityPlanTrack Properties")
+    int32 JournalCompactionThreshold = 16;
+
 protected:
 
+    virtual void BeginDestroy() override;
+
+    void ResolveTrackPath(const FString& FileName, bool bIsFullPath, FString& OutFullPath, bool& bOutIsBinaryType);
+    void WriteCheckpoint(const FString& FullPath, bool bIsBinaryType);
+
+    //Journal bookkeeping
+    void MarkEntityDirty(int32 EntityId);
+    void ResetJournalState();
+    void CompactJournalAtPath(const FString& FullPath, bool bIsBinaryType);
+    void WaitForCompaction();
+
     //Current action map, use functions to modify
     UPROPERTY()
     FEntityMapTrackData TrackData;
@@ -218,6 +279,19 @@ protected:
 
     UPROPERTY()
     TWeakObjectPtr<AEntitySpawningManagerActor> Esm;
+
+    //Entities changed/removed since the last save, used for journaled saves
+    TSet<int32> DirtyEntities;
+    TSet<int32> RemovedEntities;
+    TSet<int32> DirtyPositionIds;
+    bool bClearedSinceLastSave = false;
+
+    //Journal is only valid against the checkpoint it was started on
+    FString JournalCheckpointPath;
+    int32 JournalDeltaCount = 0;
+
+    FThreadSafeBool bIsCompactingJournal = false;
+    TFuture<void> CompactionTask;
 };
 
 
@@ -73,6 +73,9 @@ struct GENERATIONUTILITY_API FInstanceSpecializedData
 
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = InstanceSpecializedData)
     int32 InstanceId = -1;
+
+    //World time of the last travel step, lets far instances catch up analytically. Used internally
+    double LastSimulatedTime = -1.0;
 };
 
 USTRUCT()
@@ -223,6 +226,7 @@ struct GENERATIONUTILITY_API FISMSpecializedData
 
     //Used internally
     int32 LastReachedCount = 0;
+    int32 SimulationFrameCounter = 0;
 };
 
 
@@ -259,6 +263,24 @@ struct GENERATIONUTILITY_API FISMDynamicMapData : public FISMBaseMapData
 };
 
 
+USTRUCT(BlueprintType)
+struct GENERATIONUTILITY_API FESMSimulationLODSettings
+{
+    GENERATED_USTRUCT_BODY();
+
+    //When disabled every moving instance is interpolated each travel tick
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ESMSimulationLODSettings)
+    bool bEnableSimulationLOD = false;
+
+    //Instances closer than this to the player travel every tick
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ESMSimulationLODSettings)
+    float FullRateDistance = 5000.f;   //~50m
+
+    //Far instances travel once every N ticks (staggered by index) and jump by the elapsed time
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ESMSimulationLODSettings)
+    int32 FarUpdateTickInterval = 8;
+};
+
 USTRUCT(BlueprintType)
 struct GENERATIONUTILITY_API FESMSettings
 {
@@ -284,6 +306,10 @@ struct GENERATIONUTILITY_API FESMSettings
     //Allow InteractionComponentInterface to interact with instances on this ESM
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ISMSpecializedData)
     bool bEnableInstanceInteraction = true;
+
+    //Distance based travel fidelity for dynamic instances
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ISMSpecializedData)
+    FESMSimulationLODSettings SimulationLOD;
 };
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FESMTargetReachedCountSignature, UStaticMesh*, Mesh, int32, ReachedTargetCount);
@@ -352,6 +378,10 @@ public:
     UFUNCTION(BlueprintCallable, Category = "ESM Functions")
     void SetISMCustomFloats(UStaticMesh* Mesh, const TArray<float> AllCustomFloats, int32 NumCustomFloats = 1, bool bMarkRenderStateDirty = false, bool bTypeDynamic=true);
 
+    //Sets one custom data float for each given dynamic instance, render state is marked once for the batch
+    UFUNCTION(BlueprintCallable, Category = "ESM Functions")
+    void SetISMCustomDataValueForIndices(UStaticMesh* Mesh, const TArray<int32>& Indices, const TArray<float>& Values, int32 CustomDataIndex = 0);
+
     //NB: checks dynamic map first before static map. Can't have same mesh key as both dynamic and static if you want to update static
     UFUNCTION(BlueprintCallable, Category = "ESM Functions")
     void SetNearFieldActor(UStaticMesh* Mesh, UClass* NearFieldActorClass);
@@ -421,6 +451,14 @@ public:
     UFUNCTION(BlueprintCallable, Category = "ESM Functions")
     FTransform GetISMTransformForIndex(UStaticMesh* Mesh, int32 Index);
 
+    //Bulk GetISMTransformForIndex, fills OutTransforms in the same order as Indices. False (and empty) if the mesh has no ISM component
+    UFUNCTION(BlueprintCallable, Category = "ESM Functions")
+    bool GetISMTransformsForIndices(UStaticMesh* Mesh, const TArray<int32>& Indices, TArray<FTransform>& OutTransforms);
+
+    //Bulk SetISMTransformForIndex, single component lookup and one render dirty mark for the whole batch
+    UFUNCTION(BlueprintCallable, Category = "ESM Functions")
+    void SetISMTransformsForIndices(UStaticMesh* Mesh, const TArray<int32>& Indices, const TArray<FTransform>& Transforms);
+
     UFUNCTION(BlueprintCallable, Category = "ESM Functions")
     UInstancedStaticMeshComponent* StaticInstanceComponentForMesh(UStaticMesh* Mesh);
 
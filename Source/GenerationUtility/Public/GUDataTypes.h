@@ -63,8 +63,8 @@ struct GENERATIONUTILITY_API FEntityPlan
 	UPROPERTY(BlueprintReadWrite, Category = FEntityAction)
 	TArray<FInstancedStruct> Actions;
 
-	//Used for caching/saving schedules
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = FEntityAction)
+	//Deprecated, positions are cached in FEntityMapTrackData::Positions. Only read to migrate older saves
+	UPROPERTY(BlueprintReadWrite, Category = FEntityAction, meta = (DeprecatedProperty, DeprecationMessage = "Use the track position snapshot instead"))
 	FTransform LastTransform;
 
 	//Current/Active one
@@ -108,6 +108,26 @@ struct GENERATIONUTILITY_API FPGCacheSettings
 };
 
 
+/** Entity positions as parallel contiguous arrays sorted by entity id, so snapshot/restore and save/load are linear copies. */
+USTRUCT()
+struct GENERATIONUTILITY_API FEntityPositionSnapshot
+{
+	GENERATED_BODY();
+
+	UPROPERTY()
+	TArray<int32> EntityIds;
+
+	UPROPERTY()
+	TArray<FTransform> Transforms;
+
+	void Reset();
+
+	//Insert or replace keeping ids sorted
+	void SetTransform(int32 EntityId, const FTransform& Transform);
+
+	void RemoveEntity(int32 EntityId);
+};
+
 /** Full list of entities with plans. Used for caching. */
 USTRUCT()
 struct GENERATIONUTILITY_API FEntityMapTrackData
@@ -116,4 +136,32 @@ struct GENERATIONUTILITY_API FEntityMapTrackData
 
 	UPROPERTY()
 	TMap<int32, FEntityPlan> PlanMap;
+
+	//Last cached entity positions. Older saves only have FEntityPlan::LastTransform
+	UPROPERTY()
+	FEntityPositionSnapshot Positions;
+
+	//Older saves only have FEntityPlan::LastTransform, moves those into Positions and clears them
+	void MigrateLegacyPositions();
+};
+
+/** Entities changed or removed since the last journaled save. Appended to a track journal, replayed over a checkpoint on load. */
+USTRUCT()
+struct GENERATIONUTILITY_API FEntityMapTrackDelta
+{
+	GENERATED_BODY();
+
+	//Whole map was emptied before the changes below were made
+	UPROPERTY()
+	bool bClearedAll = false;
+
+	UPROPERTY()
+	TArray<int32> RemovedIds;
+
+	UPROPERTY()
+	TMap<int32, FEntityPlan> PlanMap;
+
+	//Only entities that moved since the last save
+	UPROPERTY()
+	FEntityPositionSnapshot ChangedPositions;
 };
\ No newline at end of file
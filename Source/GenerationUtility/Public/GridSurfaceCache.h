@@ -1,6 +1,8 @@
 #pragma once
 #include "CoreMinimal.h"
 #include "GenericQuadTree.h"
+#include "Misc/ScopeRWLock.h"
+#include <atomic>
 #include "GridSurfaceCache.generated.h"
 
 USTRUCT(BlueprintType)
@@ -62,10 +64,80 @@ struct FPatch2DArray
 	FPatch2DIndex Index;
 };
 
+//Patch index packed into 64 bits: face (3) | depth (5) | x (28, signed) | y (28, signed)
+struct GENERATIONUTILITY_API FPatchKey
+{
+	uint64 Packed = 0;
+
+	FPatchKey() {}
+	FPatchKey(int32 Face, int32 Depth, int32 X, int32 Y);
+
+	//Flat terrain uses face 0
+	static FPatchKey FromIndex(const FPatch2DIndex& Index, int32 Face = 0);
+
+	int32 GetFace() const;
+	int32 GetDepth() const;
+	int32 GetX() const;
+	int32 GetY() const;
+
+	bool operator==(const FPatchKey& Other) const { return Packed == Other.Packed; }
+	bool operator!=(const FPatchKey& Other) const { return Packed != Other.Packed; }
+
+	friend uint32 GetTypeHash(const FPatchKey& Key)
+	{
+		return GetTypeHash(Key.Packed);
+	}
+};
+
+//Immutable once cached, readers keep their reference even if the entry gets evicted
+typedef TSharedPtr<const TArray<float>, ESPMode::ThreadSafe> FPatchHeightData;
+
+/**
+* Thread-safe height patch cache with an LRU memory budget. Lookups take a shared lock
+* and hand out a reference to the cached buffer instead of a copy.
+*/
+class GENERATIONUTILITY_API FPatchHeightCache
+{
+public:
+	explicit FPatchHeightCache(int64 InMemoryBudgetBytes = 256 * 1024 * 1024);
+
+	FPatchHeightData Add(const FPatchKey& Key, TArray<float>&& Heights);
+	void Add(const FPatchKey& Key, const FPatchHeightData& Heights);
+
+	FPatchHeightData Find(const FPatchKey& Key) const;
+	bool Contains(const FPatchKey& Key) const;
+
+	void Remove(const FPatchKey& Key);
+	void Empty();
+
+	//Evicts least recently used patches right away if we're over the new budget
+	void SetMemoryBudget(int64 InMemoryBudgetBytes);
+	int64 GetMemoryUsed() const;
+	int32 Num() const;
+
+private:
+	struct FEntry
+	{
+		FPatchHeightData Data;
+		int64 Bytes = 0;
+
+		//Written under the shared lock by concurrent readers
+		mutable std::atomic<uint64> LastAccess;
+	};
+
+	//Write lock must be held
+	void EvictToBudget();
+
+	TMap<FPatchKey, TUniquePtr<FEntry>> Entries;
+	mutable FRWLock Lock;
+	mutable std::atomic<uint64> AccessClock;
+	int64 MemoryBudgetBytes;
+	int64 MemoryUsedBytes;
+};
+
 class FGridSurfaceCache
 {
-	
-	TMap<FString, FPatch2DArray> Cache;
+	FPatchHeightCache Cache;
 
 	//add qtree?
 
@@ -82,18 +154,88 @@ public:
 	bool ResultForIndex(const FString& Index, FPatch2DArray& OutResult);
 	bool ContainsResult(const FString& Index);
 
+	//Preferred, no string conversion and no copy
+	FPatchHeightData HeightsForIndex(const FPatch2DIndex& Index) const;
+	bool ContainsResult(const FPatch2DIndex& Index) const;
+
 	FGridSurfaceCache();
 	~FGridSurfaceCache();
 };
 
-//Custom quad class
-class FGridQuadNode
+//Welded NumX x NumY grid with unit spacing centred on the origin, same layout as CreateGridMeshWelded
+struct FCanonicalGridMesh
 {
-	TSharedPtr<FGridQuadNode> TopLeft;
-	TSharedPtr<FGridQuadNode> TopRight;
-	TSharedPtr<FGridQuadNode> BottomLeft;
-	TSharedPtr<FGridQuadNode> BottomRight;
+	int32 NumX = 0;
+	int32 NumY = 0;
+	TArray<int32> Triangles;
+	TArray<FVector3f> Vertices;
+	TArray<FVector2f> UVs;
+};
+
+typedef TSharedPtr<const FCanonicalGridMesh, ESPMode::ThreadSafe> FCanonicalGridMeshRef;
+
+/**
+* Process wide grid streams per resolution. Every patch of a resolution shares one index and UV stream,
+* only positions get scaled/transformed per patch. Thread-safe, built once on first request.
+*/
+class GENERATIONUTILITY_API FCanonicalGridMeshCache
+{
+public:
+	static FCanonicalGridMeshCache& Get();
+
+	FCanonicalGridMeshRef FindOrCreate(int32 NumX, int32 NumY);
+
+	void Empty();
+
+private:
+	TMap<FIntPoint, FCanonicalGridMeshRef> Grids;
+	mutable FRWLock Lock;
+};
+
+//Sides of a quad node in face axes (x along Right, y along Forward), also the sides of a canonical grid
+enum class EQuadEdge : uint8
+{
+	West,	//-x
+	East,	//+x
+	South,	//-y
+	North	//+y
+};
+
+//Square canonical grid triangles for each of the 16 combinations of edges that meet a coarser neighbour
+struct FStitchedGridIndices
+{
+	int32 Num = 0;
+
+	//Indexed by edge mask, bit (1 << EQuadEdge). Variant 0 is the plain canonical grid
+	TArray<int32> Variants[16];
+};
+
+typedef TSharedPtr<const FStitchedGridIndices, ESPMode::ThreadSafe> FStitchedGridIndicesRef;
+
+/**
+* Process wide stitched index variants per resolution. A stitched edge skips every other vertex so it
+* follows the edge of a neighbour one level coarser, the border ring is re-triangulated to match.
+* Only grids with an even number of cells per side can stitch, others get the plain grid for every mask.
+*/
+class GENERATIONUTILITY_API FStitchedGridIndexCache
+{
+public:
+	static FStitchedGridIndexCache& Get();
+
+	FStitchedGridIndicesRef FindOrCreate(int32 Num);
+
+	void Empty();
+
+	static bool CanStitch(int32 Num);
+
+private:
+	TMap<int32, FStitchedGridIndicesRef> Grids;
+	mutable FRWLock Lock;
+};
 
+//Custom quad class, tree operations live in FPlanetQuad since children are indices into its FQuadNodePool
+class FGridQuadNode
+{
 public:
 	FVector Center;
 	FVector Normal;
@@ -102,22 +244,32 @@ public:
 	int32 Depth;
 	int32 MaxDepth;
 
+	//Cube face and position within the face at this depth, children are 2x + (0|1), 2y + (0|1)
+	int32 Face;
+	FIntPoint Coord;
+
+	//Edges that meet a coarser tip, bit (1 << EQuadEdge). Set by FPlanetQuad for tip nodes
+	uint8 StitchMask;
+
+	//First of 4 consecutive children in the pool, Morton order (x | y << 1). INDEX_NONE for tips
+	int32 FirstChild;
+
 	FGridQuadNode(	int32 InDepth = 0,
 					int32 InMaxDepth = 8,
 					FVector InCenter = FVector(0.f),
 					FVector InNormal = FVector(0,0,1), 
-					FVector2D InSize = FVector2D(1,1));
+					FVector2D InSize = FVector2D(1,1),
+					int32 InFace = 0,
+					FIntPoint InCoord = FIntPoint::ZeroValue);
 	~FGridQuadNode();
 
-	//Build the tree based on current depth information
-	void BuildTree(FVector CameraPosition, const TMap<int32, float>& DepthComparison, const FGnomonicParams& GnomonicParams = FGnomonicParams());
-
-	void ClearTree();
+	//Stable across regenerations, used to key sections
+	FPatchKey GetKey() const;
 
 	//Tip nodes are nodes with no children, used for downstream rendering
-	void FillTipNodes(TArray<FGridQuadNode*>& OutNodes);
+	bool IsTipNode() const;
 
-	bool IsTipNode();
+	float CameraDistance(const FVector& CameraPosition, const FGnomonicParams& GnomonicParams) const;
 	/*
 	TODO: 
 	- Set desired depth at location
@@ -125,6 +277,53 @@ public:
 	*/
 };
 
+/**
+* Arena for quad nodes. Children are handed out as blocks of 4 from pages that never move, so node pointers
+* stay valid while the tree grows. Freed blocks are reused first and Reset keeps the pages, so regenerating
+* a tree of the same size doesn't allocate.
+*/
+class FQuadNodePool
+{
+public:
+	//Index of the first node of a block of 4
+	int32 AllocateChildren();
+	void FreeChildren(int32 FirstChild);
+
+	//Drops every node, keeps the pages
+	void Reset();
+
+	int32 NumNodes() const;
+
+	FGridQuadNode& operator[](int32 Index)
+	{
+		return Pages[Index >> PageShift][Index & (NodesPerPage - 1)];
+	}
+
+	const FGridQuadNode& operator[](int32 Index) const
+	{
+		return Pages[Index >> PageShift][Index & (NodesPerPage - 1)];
+	}
+
+private:
+	static constexpr int32 PageShift = 10;
+	static constexpr int32 NodesPerPage = 1 << PageShift;
+
+	TArray<TUniquePtr<FGridQuadNode[]>> Pages;
+	TArray<int32> FreeBlocks;
+
+	//Nodes handed out from the pages since Reset, freed blocks included
+	int32 NumAllocated = 0;
+};
+
+//Tip node changes of one incremental update, Added pointers are valid until the next update
+struct FQuadTreeUpdate
+{
+	TArray<FGridQuadNode*> Added;
+	TArray<FPatchKey> Removed;
+
+	bool HasChanges() const { return Added.Num() > 0 || Removed.Num() > 0; }
+};
+
 class FPlanetQuad
 {
 	//Should be 6
@@ -141,6 +340,52 @@ class FPlanetQuad
 	int32 MaxTreeDepth; //How many levels default 8
 	float TreeBaseline;	//What the baseline is used for depth level calculations
 
+	//Tips the last Regenerate/UpdateIncremental handed out with their stitch masks, so a rebuilt tree can
+	//report them removed and tips whose neighbours changed depth get rebuilt
+	TMap<FPatchKey, uint8> TipStitchMasks;
+	bool bTreeReset;
+	bool bStitchEdges;
+
+	//Children of every face tree, reused across regenerations
+	FQuadNodePool NodePool;
+
+	//Child at offset (0|1, 0|1) from 2 * Coord, null for tips
+	FGridQuadNode* GetChild(const FGridQuadNode& Node, int32 X, int32 Y);
+
+	//Gives a tip its 4 children
+	void SplitNode(FGridQuadNode& Node);
+
+	//Frees everything below Node, which becomes a tip
+	void ClearNode(FGridQuadNode& Node);
+
+	//Drops all children, base quads become tips
+	void ResetNodes();
+
+	//Traversals below use explicit stacks, tips come out in Morton order
+	void CollectTips(FGridQuadNode& Root, TArray<FGridQuadNode*>& OutNodes);
+
+	//Build the tree based on current depth information
+	void BuildTree(FGridQuadNode& Root, const FVector& CameraPosition, const FGnomonicParams& GnomonicParams);
+
+	/**
+	* Splits/merges only where a distance threshold was crossed. Merges wait until MergeHysteresis * threshold
+	* so a camera sitting on a boundary doesn't flip every update. bIsNewRoot reports Root as added if it stays a tip.
+	*/
+	void UpdateTree(FGridQuadNode& Root, const FVector& CameraPosition, const FGnomonicParams& GnomonicParams, FQuadTreeUpdate& OutUpdate, bool bIsNewRoot);
+
+	bool IsFaceActive(int32 Face) const;
+
+	//Deepest existing node on the path to Key, coarser than Key if a tip covers it
+	FGridQuadNode* FindCoveringNode(const FPatchKey& Key);
+
+	//Splits coarse tips until no tip has an edge neighbour more than one level coarser
+	void BalanceTree(FQuadTreeUpdate* Update);
+
+	uint8 ComputeStitchMask(FGridQuadNode& Tip);
+
+	//Sets tip stitch masks and records them, with Update also turns restitched tips into remove + add
+	void FinalizeTips(FQuadTreeUpdate* Update, bool bReset);
+
 public:
 
 	FPlanetQuad(FVector InCenter,
@@ -154,13 +399,32 @@ public:
 	//Main function to generate QuadTree
 	void Regenerate(FVector CameraPosition, FVector WorldOrigin, const FGnomonicParams& GnomonicParams = FGnomonicParams());
 
+	//Updates the existing tree for the new camera position, cost scales with the LOD change instead of the tree size
+	void UpdateIncremental(FVector CameraPosition, FVector WorldOrigin, const FGnomonicParams& GnomonicParams, FQuadTreeUpdate& OutUpdate);
+
 	//Tip nodes are nodes with no children
 	void FillTipNodes(TArray<FGridQuadNode*>& OutNodes);
 
+	//Pooled nodes below the base quads
+	int32 NumNodes() const;
+
 	void SetTopOnly(bool bInTopOnly = false);
 
+	//Keeps tips 2:1 balanced and gives them stitch masks so mismatched edges don't crack
+	void SetStitchEdges(bool bInStitchEdges = true);
+
+	//Merge once the camera is this factor past the split distance
+	float MergeHysteresis;
+
 	//0-5 to face normals
 	static FVector NormalForFaceIndex(int32 Index);
+	static int32 FaceIndexForNormal(const FVector& Normal);
+
+	//Face axes as used by quad nodes, Coord.X runs along Right and Coord.Y along Forward
+	static void FaceAxes(int32 Face, FVector& OutRight, FVector& OutForward);
+
+	//Same depth neighbour across Edge, wraps onto the adjacent cube face at face borders
+	static FPatchKey NeighborKey(const FPatchKey& Key, EQuadEdge Edge);
 };
 
 
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+#include "PGBlackboard.generated.h"
+
+UENUM(BlueprintType)
+enum class EPGBlackboardType : uint8
+{
+	None,
+	Float,
+	Int,
+	Vector,
+	Transform,
+	Object,
+	FloatArray,
+	VectorArray,
+	TransformArray
+};
+
+/** Array shared between copies until one of them edits it */
+template<typename ElementType>
+struct TPGCowArray
+{
+	TSharedPtr<TArray<ElementType>, ESPMode::ThreadSafe> Data;
+
+	const TArray<ElementType>& Get() const
+	{
+		static const TArray<ElementType> Empty;
+		return Data.IsValid() ? *Data : Empty;
+	}
+
+	//Detaches from other copies first
+	TArray<ElementType>& Edit()
+	{
+		if (!Data.IsValid())
+		{
+			Data = MakeShared<TArray<ElementType>, ESPMode::ThreadSafe>();
+		}
+		else if (!Data.IsUnique())
+		{
+			Data = MakeShared<TArray<ElementType>, ESPMode::ThreadSafe>(*Data);
+		}
+		return *Data;
+	}
+
+	void Set(TArray<ElementType>&& Values)
+	{
+		Data = MakeShared<TArray<ElementType>, ESPMode::ThreadSafe>(MoveTemp(Values));
+	}
+
+	bool IsSharedWith(const TPGCowArray& Other) const
+	{
+		return Data == Other.Data;
+	}
+};
+
+/** One typed slot, only the member matching Type is meaningful */
+struct GENERATIONUTILITY_API FPGBlackboardValue
+{
+	EPGBlackboardType Type = EPGBlackboardType::None;
+
+	float Float = 0.f;
+	int32 Int = 0;
+	FVector Vector = FVector::ZeroVector;
+	FTransform Transform = FTransform::Identity;
+
+	//Not a GC reference, owners keep their objects alive through ObjectMap/ActorMap or elsewhere
+	TWeakObjectPtr<UObject> Object;
+
+	TPGCowArray<float> FloatArray;
+	TPGCowArray<FVector> VectorArray;
+	TPGCowArray<FTransform> TransformArray;
+
+	//Shared arrays compare by buffer, so this is cheap for unchanged slots
+	bool IsSameValue(const FPGBlackboardValue& Other) const;
+
+	//Content hash, stable across runs (objects hash by path)
+	uint32 GetContentHash() const;
+};
+
+/**
+* Typed context storage keyed by FName. The slot map itself is shared copy-on-write,
+* so copying a blackboard between chains is O(1) and large arrays are never duplicated unless edited.
+*/
+struct GENERATIONUTILITY_API FPGBlackboard
+{
+	typedef TMap<FName, FPGBlackboardValue> FSlotMap;
+
+	int32 Num() const;
+	bool Contains(FName Key) const;
+	EPGBlackboardType GetType(FName Key) const;
+	const FPGBlackboardValue* Find(FName Key) const;
+	void GetKeys(TArray<FName>& OutKeys) const;
+
+	void SetFloat(FName Key, float Value);
+	bool GetFloat(FName Key, float& OutValue) const;
+
+	void SetInt(FName Key, int32 Value);
+	bool GetInt(FName Key, int32& OutValue) const;
+
+	void SetVector(FName Key, const FVector& Value);
+	bool GetVector(FName Key, FVector& OutValue) const;
+
+	void SetTransform(FName Key, const FTransform& Value);
+	bool GetTransform(FName Key, FTransform& OutValue) const;
+
+	void SetObject(FName Key, UObject* Value);
+	UObject* GetObject(FName Key) const;
+
+	//Array getters return an empty array for missing/mismatched keys. Edit variants add the slot if needed
+	void SetFloatArray(FName Key, TArray<float> Values);
+	const TArray<float>& GetFloatArray(FName Key) const;
+	TArray<float>& EditFloatArray(FName Key);
+
+	void SetVectorArray(FName Key, TArray<FVector> Values);
+	const TArray<FVector>& GetVectorArray(FName Key) const;
+	TArray<FVector>& EditVectorArray(FName Key);
+
+	void SetTransformArray(FName Key, TArray<FTransform> Values);
+	const TArray<FTransform>& GetTransformArray(FName Key) const;
+	TArray<FTransform>& EditTransformArray(FName Key);
+
+	void SetValue(FName Key, const FPGBlackboardValue& Value);
+	void Remove(FName Key);
+	void Reset();
+
+	/** Other's slots win. Shares Other's storage when we're empty */
+	void Append(const FPGBlackboard& Other);
+
+protected:
+	FSlotMap& EditSlots();
+	FPGBlackboardValue& EditSlot(FName Key, EPGBlackboardType Type);
+	const FPGBlackboardValue* FindTyped(FName Key, EPGBlackboardType Type) const;
+
+	TSharedPtr<FSlotMap, ESPMode::ThreadSafe> Slots;
+};
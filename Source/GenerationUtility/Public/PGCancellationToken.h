@@ -0,0 +1,67 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
+#include <atomic>
+
+/**
+* Shared between a chain and the async work it launches. Work polls IsCancelled (explicit cancel,
+* passed deadline or cancelled parent) and registers itself while running, so whoever cancels
+* can wait for the work to acknowledge by draining out.
+*/
+class GENERATIONUTILITY_API FPGCancellationToken
+{
+public:
+	explicit FPGCancellationToken(TSharedPtr<FPGCancellationToken, ESPMode::ThreadSafe> InParent = nullptr);
+
+	void Cancel();
+	bool IsCancelled() const;
+
+	//True only if the deadline (not an explicit cancel) is what stopped us
+	bool HasDeadlinePassed() const;
+
+	/** Absolute FPlatformTime::Seconds() deadline, <= 0 clears it */
+	void SetDeadline(double InDeadline);
+	void SetTimeBudget(float Seconds);
+	double GetDeadline() const;
+
+	//Active work is also counted on all parents, so waiting on a root covers the whole tree
+	void BeginWork();
+	void EndWork();
+	int32 NumActiveWork() const;
+
+	/** Block until all registered work ended or the timeout passed. Returns true if everything acknowledged */
+	bool WaitForWork(float TimeoutSeconds) const;
+
+	/** Non blocking acknowledge, Callback runs once all registered work ended (immediately if none is active). Called on the thread ending the last work */
+	void OnWorkDrained(TFunction<void()> Callback);
+
+	/** RAII registration for the duration of an async work body */
+	struct FWorkScope
+	{
+		explicit FWorkScope(const TSharedRef<FPGCancellationToken, ESPMode::ThreadSafe>& InToken)
+			: Token(InToken)
+		{
+			Token->BeginWork();
+		}
+
+		~FWorkScope()
+		{
+			Token->EndWork();
+		}
+
+		TSharedRef<FPGCancellationToken, ESPMode::ThreadSafe> Token;
+	};
+
+private:
+	TSharedPtr<FPGCancellationToken, ESPMode::ThreadSafe> Parent;
+	FThreadSafeBool bCancelled;
+	FThreadSafeCounter ActiveWork;
+	std::atomic<double> Deadline;
+
+	FCriticalSection DrainedLock;
+	TArray<TFunction<void()>> DrainedCallbacks;
+};
+
+typedef TSharedRef<FPGCancellationToken, ESPMode::ThreadSafe> FPGCancellationTokenRef;
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ProcGeneratorChain.h"
+#include "PGChainRegistrySubsystem.generated.h"
+
+/**
+ * World-level cache of named chain templates. The first request for a name goes through the
+ * script round-trip (GES RequestJsChainByName), later requests clone the cached template natively.
+ * Only native chains are cached: script state (closures, wrapper objects, non UPROPERTY fields) isn't
+ * copied by DuplicateObject, so script chains keep going through the round-trip.
+ * Cleared on the Procedural.JsReloaded event.
+ */
+UCLASS()
+class GENERATIONUTILITY_API UPGChainRegistrySubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	//~ Begin UWorldSubsystem
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	//~ End UWorldSubsystem
+
+	static UPGChainRegistrySubsystem* Get(const UObject* WorldContextObject);
+
+	/** Register an instance to clone for Name. Rejected (with a warning) if CanCloneChain fails */
+	UFUNCTION(BlueprintCallable, Category = "ProcGeneratorChain|Registry")
+	void RegisterChainTemplate(const FString& Name, UProcGeneratorChain* Template);
+
+	/** Register a class to instantiate for Name, no script involved */
+	UFUNCTION(BlueprintCallable, Category = "ProcGeneratorChain|Registry")
+	void RegisterChainClass(const FString& Name, TSubclassOf<UProcGeneratorChain> ChainClass);
+
+	/** New chain for a cached name, nullptr if the name isn't cached */
+	UFUNCTION(BlueprintCallable, Category = "ProcGeneratorChain|Registry")
+	UProcGeneratorChain* CreateChainByName(const FString& Name, UObject* Outer);
+
+	UFUNCTION(BlueprintPure, Category = "ProcGeneratorChain|Registry")
+	bool IsChainCached(const FString& Name) const;
+
+	/** Drop all cached templates/classes, next requests go through script again */
+	UFUNCTION(BlueprintCallable, Category = "ProcGeneratorChain|Registry")
+	void InvalidateCache();
+
+	/** Cached clone if possible, otherwise a script round-trip whose result gets cached if it can be cloned. Calls back synchronously */
+	void RequestChainByName(const FString& Name, UObject* Outer, TFunction<void(UProcGeneratorChain*)> ReceivingLambda);
+
+	/** Script lookup without caching, the original GES round-trip */
+	static UProcGeneratorChain* FetchChainFromScript(const FString& Name, UObject* WorldContextObject);
+
+	/** Deep copy: subchains and next chains not owned by the template are cloned too, delegates bound to the template are rebound */
+	static UProcGeneratorChain* CloneChain(UProcGeneratorChain* Template, UObject* Outer);
+
+	/** True if every chain reachable from Chain is a native class whose bound delegates only target itself */
+	static bool CanCloneChain(const UProcGeneratorChain* Chain);
+
+	UPROPERTY(BlueprintReadOnly, Category = "ProcGeneratorChain|Registry")
+	int32 ScriptLookups = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "ProcGeneratorChain|Registry")
+	int32 CachedCreations = 0;
+
+protected:
+	UPROPERTY()
+	TMap<FString, UProcGeneratorChain*> Templates;
+
+	UPROPERTY()
+	TMap<FString, TSubclassOf<UProcGeneratorChain>> ChainClasses;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "ProcGeneratorChain.h"
+#include "PGChainResultCache.generated.h"
+
+/** What a chain (and its subchains) changed in the context. Strings persist to disk, object/actor refs and blackboard slots are memory only */
+USTRUCT()
+struct GENERATIONUTILITY_API FPGChainCachedResult
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TMap<FString, FString> StringMap;
+
+	UPROPERTY()
+	TArray<FString> RemovedKeys;
+
+	TMap<FString, TWeakObjectPtr<UObject>> ObjectMap;
+	TMap<FString, TWeakObjectPtr<AActor>> ActorMap;
+
+	FPGBlackboard Blackboard;
+	TArray<FName> RemovedBlackboardKeys;
+
+	//Source hashes of the script chains that produced this, entries go when one of their scripts changes
+	UPROPERTY()
+	TArray<FString> ScriptHashes;
+
+	/** Entries added, changed or removed between Before and After. Empty OnlyKeys means all keys */
+	static FPGChainCachedResult FromContextChange(const FPGContextData& Before, const FPGContextData& After, const TSet<FString>& OnlyKeys);
+
+	/** Returns false without touching the context if a cached object/actor no longer exists */
+	bool ApplyTo(FPGContextData& Context) const;
+
+	bool HasMemoryOnlyData() const;
+};
+
+/**
+* Process wide store of chain results keyed by input hash, so rebuilt chains can skip work when nothing
+* they depend on changed. Script edits don't show up in class paths or properties, so script chains add
+* a hash of their source to the key: after a js reload (or a restart with scripts edited offline) only
+* chains whose script changed miss.
+*/
+class GENERATIONUTILITY_API FPGChainResultCache
+{
+public:
+	static FPGChainResultCache& Get();
+
+	bool Find(const FString& Key, bool bAllowDisk, FPGChainCachedResult& OutResult);
+
+	//Results with object refs or blackboard data are kept in memory only
+	void Store(const FString& Key, const FPGChainCachedResult& Result, bool bPersist);
+
+	void Remove(const FString& Key);
+
+	void Clear(bool bIncludeDisk);
+
+	/** Content hash of a script file, cached until the next OnScriptsReloaded. Empty if it can't be read */
+	FString GetScriptFileHash(const FString& Path);
+
+	//Procedural.JsReloaded: rehash known script files and drop memory entries of scripts that changed
+	void OnScriptsReloaded();
+
+	static FString CacheFolder();
+	static FString DiskPath(const FString& Key);
+
+private:
+	FCriticalSection CacheLock;
+	TMap<FString, FPGChainCachedResult> Entries;
+	TMap<FString, FString> ScriptFileHashes;
+};
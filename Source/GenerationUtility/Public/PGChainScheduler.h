@@ -0,0 +1,110 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/NoExportTypes.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/CriticalSection.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "ProcGeneratorChain.h"
+#include "PGChainScheduler.generated.h"
+
+/** One pre or post step of a chain in the scheduled graph */
+struct FPGChainGraphNode
+{
+	UProcGeneratorChain* Chain = nullptr;
+
+	//Private context the step runs on, synced with the shared context before and after
+	UPGContextDataObject* Context = nullptr;
+
+	bool bIsPost = false;
+	bool bRunOnWorker = false;
+
+	//Indices of nodes that have to finish first, always lower than our own index
+	TArray<int32> Prerequisites;
+
+	FGraphEventRef Event;
+};
+
+/**
+* Runs a whole chain tree as a dependency graph instead of walking SubChains/NextChain in order.
+* Structural links (pre before subchains, subchains before post, post before next) are kept,
+* sibling order is replaced by read/write hazards on declared context keys. Independent steps
+* run concurrently; thread-safe native chains on task graph workers, everything else on the game thread.
+* Latent chains aren't supported in this mode and raise an error.
+*/
+UCLASS(BlueprintType)
+class GENERATIONUTILITY_API UPGChainScheduler : public UObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UPGChainScheduler();
+
+	/** Called once the graph finished without errors, with the merged context */
+	UPROPERTY(BlueprintAssignable, Category = "PGChainScheduler")
+	FProcessChainMCSignature OnGraphFinished;
+
+	/** Build the graph for RootChain and start it. Returns false if it couldn't be started */
+	UFUNCTION(BlueprintCallable, Category = "PGChainScheduler")
+	bool RunChainGraph(UProcGeneratorChain* RootChain, UPGContextDataObject* InOutContextData);
+
+	/** Remaining steps are skipped, the graph still joins on the game thread */
+	UFUNCTION(BlueprintCallable, Category = "PGChainScheduler")
+	void Cancel();
+
+	UFUNCTION(BlueprintPure, Category = "PGChainScheduler")
+	bool IsRunning() const;
+
+	/** Steps in the last built graph, for debugging */
+	UFUNCTION(BlueprintPure, Category = "PGChainScheduler")
+	int32 NumGraphNodes() const;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "PGChainScheduler")
+	bool bOutputDebugFlowLog = false;
+
+protected:
+
+	virtual void BeginDestroy() override;
+
+	//Graph building, returns the last node of the chain and its next chains or INDEX_NONE on error
+	int32 AddChainNodes(UProcGeneratorChain* Chain, int32 AfterNode);
+	int32 AddNode(UProcGeneratorChain* Chain, bool bIsPost);
+	void AddEdge(int32 FromNode, int32 ToNode);
+
+	void RunNode(int32 NodeIndex);
+	void JoinGraph();
+	void ResetGraph();
+
+	UPROPERTY()
+	UProcGeneratorChain* Root = nullptr;
+
+	UPROPERTY()
+	UPGContextDataObject* TargetContext = nullptr;
+
+	//In finishing order: subchains before their parent, next chains after
+	UPROPERTY()
+	TArray<UProcGeneratorChain*> Chains;
+
+	UPROPERTY()
+	TArray<UPGContextDataObject*> NodeContexts;
+
+	TArray<FPGChainGraphNode> Nodes;
+
+	//Hazard tracking while building
+	TMap<FString, int32> LastWriter;
+	TMap<FString, TArray<int32>> ReadersSinceWrite;
+	TArray<int32> NodesSinceBarrier;
+	int32 LastBarrier = INDEX_NONE;
+	TSet<UProcGeneratorChain*> VisitedChains;
+
+	//Shared context all steps sync with
+	FPGContextData SharedContext;
+	FCriticalSection ContextLock;
+
+	FGraphEventRef JoinEvent;
+
+	FThreadSafeBool bIsRunning;
+	FThreadSafeBool bCancelled;
+	FThreadSafeBool bFailed;
+};
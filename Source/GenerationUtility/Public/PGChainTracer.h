@@ -0,0 +1,52 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "HAL/ThreadSafeBool.h"
+
+/**
+* Collects chain phase spans while a capture is running and exports them as Chrome trace JSON
+* (chrome://tracing, Perfetto). Phases are complete events on the thread they ran on,
+* latent waits are async events keyed by chain so they can overlap other work.
+*/
+class GENERATIONUTILITY_API FPGChainTracer
+{
+public:
+	FPGChainTracer();
+
+	static FPGChainTracer& Get();
+
+	void StartCapture();
+	void StopCapture();
+	bool IsCapturing() const;
+
+	//Times are FPlatformTime::Seconds()
+	void AddSpan(const FString& Name, const TCHAR* Category, double StartTime, double EndTime);
+	void AddAsyncBegin(const FString& Name, const TCHAR* Category, uint32 Id, double Time);
+	void AddAsyncEnd(const FString& Name, const TCHAR* Category, uint32 Id, double Time);
+	void AddInstant(const FString& Name, const TCHAR* Category, double Time);
+
+	int32 NumEvents() const;
+
+	/** Write captured events to FilePath, keeps them until the next StartCapture */
+	bool ExportChromeTrace(const FString& FilePath) const;
+
+private:
+	struct FTraceEvent
+	{
+		FString Name;
+		const TCHAR* Category;
+		TCHAR Phase;
+		double Timestamp;
+		double Duration;
+		uint32 ThreadId;
+		uint32 Id;
+	};
+
+	void AddEvent(FTraceEvent&& Event);
+
+	mutable FCriticalSection EventLock;
+	TArray<FTraceEvent> Events;
+	double CaptureStartTime = 0.0;
+	FThreadSafeBool bIsCapturing;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GridSurfaceCache.h"
+#include "PatchDiskStore.generated.h"
+
+UENUM(BlueprintType)
+enum class EPatchStoreFormat : uint8
+{
+	Float32,
+	Float16,
+
+	//Heights mapped to 16 bit across the patch min/max range
+	Quantized16
+};
+
+/**
+* Persistent height patches, one file per patch grouped into region folders by coordinate.
+* Folder is per params hash so stale heights are never read back. Reads are memory mapped
+* where the platform supports it. Safe to use from terrain workers once the folder is set.
+*/
+class GENERATIONUTILITY_API FPatchDiskStore
+{
+public:
+	FPatchDiskStore();
+
+	/** Patches under <CacheSavePath>/TerrainPatches/<ParamsHash> */
+	void SetParamsHash(uint32 ParamsHash);
+	void SetFormat(EPatchStoreFormat InFormat);
+
+	bool Write(const FPatchKey& Key, const TArray<float>& Heights) const;
+
+	/** False if missing, corrupt or not ExpectedNum samples (when > 0) */
+	bool Read(const FPatchKey& Key, TArray<float>& OutHeights, int32 ExpectedNum = 0) const;
+
+	bool Contains(const FPatchKey& Key) const;
+
+	/** Deletes the current params folder */
+	void Clear() const;
+
+	/** Marks the current folder used and deletes the least recently used other params folders so at most MaxFolders remain */
+	void PurgeOldFolders(int32 MaxFolders) const;
+
+	FString PatchPath(const FPatchKey& Key) const;
+
+	static FString RootFolder();
+
+private:
+	bool Decode(const uint8* Bytes, int64 Size, TArray<float>& OutHeights, int32 ExpectedNum) const;
+
+	FString Folder;
+	EPatchStoreFormat Format;
+};
@@ -3,6 +3,8 @@
 #include "CoreMinimal.h"
 #include "UObject/NoExportTypes.h"
 #include "HAL/ThreadSafeBool.h"
+#include "PGBlackboard.h"
+#include "PGCancellationToken.h"
 #include "ProcGeneratorChain.generated.h"
 
 /** Store data that gets pass forward through each chain. Uses generic maps (string and object) */
@@ -23,6 +25,9 @@ struct GENERATIONUTILITY_API FPGContextData
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "GeneratorChainContextData")
 	TMap<FString, AActor*> ActorMap;
 
+	/** Typed FName keyed data, shared copy-on-write so passing it between chains doesn't copy. Not serialized */
+	FPGBlackboard Blackboard;
+
 	void AppendData(FPGContextData& Other);
 };
 
@@ -49,6 +54,39 @@ enum class EPGChainOrder : uint8
 	Next
 };
 
+/** Per run timings of a chain, filled from status changes */
+USTRUCT(BlueprintType)
+struct GENERATIONUTILITY_API FPGChainTimings
+{
+	GENERATED_BODY()
+
+	//Start of pre until done, including subchains and latent waits
+	UPROPERTY(BlueprintReadOnly, Category = "ProcGeneratorChain")
+	float WallSeconds = 0.f;
+
+	//Time spent in this chain's own callbacks (pre + post + finish), excludes subchains and latent waits
+	UPROPERTY(BlueprintReadOnly, Category = "ProcGeneratorChain")
+	float ActiveSeconds = 0.f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "ProcGeneratorChain")
+	float PreSeconds = 0.f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "ProcGeneratorChain")
+	float SubChainsSeconds = 0.f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "ProcGeneratorChain")
+	float PostSeconds = 0.f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "ProcGeneratorChain")
+	float FinishSeconds = 0.f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "ProcGeneratorChain")
+	float LatentWaitSeconds = 0.f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "ProcGeneratorChain")
+	int32 IntermediateResults = 0;
+};
+
 USTRUCT(BlueprintType)
 struct GENERATIONUTILITY_API FPGChainState
 {
@@ -60,6 +98,59 @@ struct GENERATIONUTILITY_API FPGChainState
 	UPROPERTY(BlueprintReadWrite, Category = "ProcGeneratorChain")
 	bool bParallelProcessSubchains = false;
 
+	//Like parallel, but thread-safe subchains run their pre/post as task graph tasks and are joined before our post
+	UPROPERTY(BlueprintReadWrite, Category = "ProcGeneratorChain")
+	bool bConcurrentProcessSubchains = false;
+
+	//Native leaf chains only: pre/post may run off the game thread on a private copy of the context data.
+	//GC is blocked while they run, so they must not wait on the game thread
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "ProcGeneratorChain")
+	bool bThreadSafe = false;
+
+	//Context keys read/written by this chain's pre/post, used by UPGChainScheduler to find independent chains.
+	//Chains that don't declare are scheduled as barriers (read and write everything)
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "ProcGeneratorChain")
+	bool bDeclaresContextKeys = false;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "ProcGeneratorChain")
+	TArray<FString> ReadsContextKeys;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "ProcGeneratorChain")
+	TArray<FString> WritesContextKeys;
+
+	//Skip this chain (and its subchains) when class, parameters and consumed context match a previous run.
+	//Consumed context is the declared reads of the subtree, or the whole input context if any chain in it doesn't declare.
+	//Only used when every chain in the subtree is bIsPure
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "ProcGeneratorChain")
+	bool bCacheResults = false;
+
+	//Everything this chain does ends up in the context, no spawned actors/meshes/files. A cache hit skips the run
+	//entirely, so any other side effect would be lost
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "ProcGeneratorChain")
+	bool bIsPure = false;
+
+	//Script (non native) chains keep their class path when the script is edited, so their result cache key needs
+	//the source itself: the module file this chain is defined in, hashed by content. Without it or ScriptSourceHash
+	//non native chains aren't cached
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "ProcGeneratorChain")
+	FString ScriptSourcePath;
+
+	//Alternative to ScriptSourcePath when the script hashes (or versions) its own source
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "ProcGeneratorChain")
+	FString ScriptSourceHash;
+
+	//Also keep results on disk, only results without object/actor refs are written
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "ProcGeneratorChain")
+	bool bPersistCachedResults = true;
+
+	//Optional budget per run in seconds, async work launched by the chain is abandoned once it passes. <= 0 is unlimited
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "ProcGeneratorChain")
+	float TimeBudgetSeconds = 0.f;
+
+	//How long async work may take to acknowledge a StopLatentAction before we warn about it
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "ProcGeneratorChain")
+	float CancelAcknowledgeTimeout = 1.f;
+
 	UPROPERTY(BlueprintReadWrite, Category = "ProcGeneratorChain")
 	bool bOutputDebugFlowLog = false;
 
@@ -87,6 +178,10 @@ struct GENERATIONUTILITY_API FPGChainState
 	UPROPERTY(BlueprintReadOnly, Category = "ProcGeneratorChain")
 	FString StatusMessage = TEXT("None.");
 
+	/** Timings of the current/last run */
+	UPROPERTY(BlueprintReadOnly, Category = "ProcGeneratorChain")
+	FPGChainTimings Timings;
+
 	FPGChainState();
 };
 
@@ -99,12 +194,60 @@ public:
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "GeneratorChainContextData")
 	FPGContextData Context;
+
+	//Blackboard accessors, getters return false/empty if the key is missing or holds another type
+	UFUNCTION(BlueprintCallable, Category = "GeneratorChainContextData")
+	void SetBlackboardFloat(FName Key, float Value);
+
+	UFUNCTION(BlueprintCallable, Category = "GeneratorChainContextData")
+	bool GetBlackboardFloat(FName Key, float& OutValue) const;
+
+	UFUNCTION(BlueprintCallable, Category = "GeneratorChainContextData")
+	void SetBlackboardInt(FName Key, int32 Value);
+
+	UFUNCTION(BlueprintCallable, Category = "GeneratorChainContextData")
+	bool GetBlackboardInt(FName Key, int32& OutValue) const;
+
+	UFUNCTION(BlueprintCallable, Category = "GeneratorChainContextData")
+	void SetBlackboardVector(FName Key, const FVector& Value);
+
+	UFUNCTION(BlueprintCallable, Category = "GeneratorChainContextData")
+	bool GetBlackboardVector(FName Key, FVector& OutValue) const;
+
+	UFUNCTION(BlueprintCallable, Category = "GeneratorChainContextData")
+	void SetBlackboardTransform(FName Key, const FTransform& Value);
+
+	UFUNCTION(BlueprintCallable, Category = "GeneratorChainContextData")
+	bool GetBlackboardTransform(FName Key, FTransform& OutValue) const;
+
+	UFUNCTION(BlueprintCallable, Category = "GeneratorChainContextData")
+	void SetBlackboardObject(FName Key, UObject* Value);
+
+	UFUNCTION(BlueprintPure, Category = "GeneratorChainContextData")
+	UObject* GetBlackboardObject(FName Key) const;
+
+	UFUNCTION(BlueprintCallable, Category = "GeneratorChainContextData")
+	void SetBlackboardFloatArray(FName Key, const TArray<float>& Values);
+
+	//Blueprint gets a copy, native code should use Context.Blackboard.GetFloatArray
+	UFUNCTION(BlueprintCallable, Category = "GeneratorChainContextData")
+	TArray<float> GetBlackboardFloatArray(FName Key) const;
+
+	UFUNCTION(BlueprintCallable, Category = "GeneratorChainContextData")
+	void SetBlackboardTransformArray(FName Key, const TArray<FTransform>& Values);
+
+	UFUNCTION(BlueprintCallable, Category = "GeneratorChainContextData")
+	TArray<FTransform> GetBlackboardTransformArray(FName Key) const;
+
+	UFUNCTION(BlueprintPure, Category = "GeneratorChainContextData")
+	EPGBlackboardType GetBlackboardType(FName Key) const;
 };
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FProcessChainMCSignature, UPGContextDataObject*, InOutContextData);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FChainStatusSignature, EPGChainStatus, Status, UProcGeneratorChain*, Chain);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FChainErrorSignature, EPGChainStatus, Status, const FString&, ErrorMessage);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FSubChainProgressSignature, int32, Completed, int32, Total);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FChainCancelAcknowledgedSignature, UProcGeneratorChain*, Chain);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FIntermediateResultSignature, UPGContextDataObject*, InOutContextData, const FString&, ContextMessage, UProcGeneratorChain*, Chain);
 
 DECLARE_DYNAMIC_DELEGATE_OneParam(FProcessChainSignature, UPGContextDataObject*, InOutContextData);
@@ -118,6 +261,8 @@ class GENERATIONUTILITY_API UProcGeneratorChain : public UObject
 {
 	GENERATED_BODY()
 
+	friend class UPGChainScheduler;
+
 public:
 
 	UProcGeneratorChain();
@@ -148,6 +293,10 @@ public:
 	UPROPERTY(BlueprintAssignable, Category = "ProcGeneratorChain")
 	FSubChainProgressSignature OnSubChainProgress;
 
+	//Game thread, once all async work of a stopped run has acknowledged the cancel
+	UPROPERTY(BlueprintAssignable, Category = "ProcGeneratorChain")
+	FChainCancelAcknowledgedSignature OnCancelAcknowledged;
+
 
 
 
@@ -189,6 +338,10 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "ProcGeneratorChain")
 	void LinkNextChain(UProcGeneratorChain* NextChainLink);
 
+	/** Declare which context keys this chain reads and writes, see UPGChainScheduler */
+	UFUNCTION(BlueprintCallable, Category = "ProcGeneratorChain")
+	void DeclareContextKeys(const TArray<FString>& Reads, const TArray<FString>& Writes);
+
 	/** Add a subchain, optionally an index != -1 will append it in that slot */
 	UFUNCTION(BlueprintCallable, Category = "ProcGeneratorChain")
 	void AddSubchain(UProcGeneratorChain* SubChain, int32 AtIndex = -1);
@@ -235,9 +388,33 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "ProcGeneratorChain")
 	void ThrowError(const FString& ErrorMessage);
 
+	/** Cancels the chain tree without blocking, OnCancelAcknowledged fires once async work drained out */
 	UFUNCTION(BlueprintCallable, Category = "ProcGeneratorChain")
 	void StopLatentAction();
 
+	/** Start recording phase spans of all chains */
+	UFUNCTION(BlueprintCallable, Category = "ProcGeneratorChain")
+	static void StartChainTraceCapture();
+
+	/** Stop recording and write a Chrome trace json (chrome://tracing, Perfetto). Empty path uses Saved/Profiling/ProcGenChains.json */
+	UFUNCTION(BlueprintCallable, Category = "ProcGeneratorChain")
+	static bool StopChainTraceCapture(const FString& FilePath);
+
+	/** Drop all memoized chain results, optionally including the disk cache */
+	UFUNCTION(BlueprintCallable, Category = "ProcGeneratorChain")
+	static void ClearChainResultCache(bool bIncludeDisk = false);
+
+	/** True once this run was stopped, ran past its budget/deadline or a parent was cancelled */
+	UFUNCTION(BlueprintCallable, Category = "ProcGeneratorChain")
+	bool IsCancellationRequested() const;
+
+	/** Abandon this run (and its subchains' async work) if it isn't done within Seconds. <= 0 clears the deadline */
+	UFUNCTION(BlueprintCallable, Category = "ProcGeneratorChain")
+	void SetChainDeadline(float SecondsFromNow);
+
+	/** Token for the current run. Pass it to async work, wrap the work in FPGCancellationToken::FWorkScope and poll IsCancelled */
+	FPGCancellationTokenRef GetCancellationToken();
+
 	/** Check if subchains or current chain has thrown an error */
 	UFUNCTION(BlueprintCallable, Category = "ProcGeneratorChain")
 	bool IsStatusError();
@@ -274,6 +451,66 @@ protected:
 	UFUNCTION()
 	void UpdateStatus(EPGChainStatus NewStatus);
 
+	//Shared tail of StartChainProcess: finished callbacks, Done status and forwarding to next chain
+	bool FinishChainProcess(UPGContextDataObject* InOutContextData);
+
+	//New token per fresh run, linked to the parent's so cancelling a parent reaches all async work below it
+	void ResetCancellationToken();
+
+	//Marks this chain and subchains stopped and cancels their tokens, doesn't wait
+	void CancelChainTree();
+
+	//Call on the game thread when async work stopped because of the token. Raises a budget error if the deadline passed
+	void OnAsyncWorkCancelled();
+
+	TSharedPtr<FPGCancellationToken, ESPMode::ThreadSafe> CancellationToken;
+
+	//Accumulates time spent in the status we're leaving
+	void RecordStatusTiming(EPGChainStatus OldStatus, EPGChainStatus NewStatus);
+
+	double RunStartTime = 0.0;
+	double StatusStartTime = 0.0;
+
+	//Result cache
+	bool TryApplyCachedResult(UPGContextDataObject* InOutContextData);
+	void StoreCachedResult(UPGContextDataObject* InOutContextData);
+	FString ComputeResultCacheKey(const FPGContextData& Input) const;
+	void AppendCacheParameters(FString& OutSource) const;
+
+	//Returns false if a chain in the subtree doesn't declare its keys
+	bool CollectSubtreeContextKeys(bool bWrites, TSet<FString>& OutKeys) const;
+
+	//True if this chain and all subchains declare bIsPure
+	bool IsSubtreePure() const;
+
+	//Source content hash of a script chain, empty for native chains or if it can't be identified
+	FString GetScriptSourceHash() const;
+
+	//Script hashes the subtree's results depend on. False if a non native chain in it has no source identity
+	bool CollectSubtreeScriptHashes(TArray<FString>& OutHashes) const;
+
+	//Set on a cache miss, stored once the chain finishes
+	FString PendingResultCacheKey;
+	TArray<FString> PendingScriptHashes;
+	FPGContextData CacheInputSnapshot;
+
+	//Concurrent subchain mode
+	bool CanRunConcurrently() const;
+	bool ProcessSubChainsConcurrently(int32 StartIndex);
+	void JoinConcurrentSubChains();
+
+	//Subchains currently running on task graph threads and their private contexts, released at join
+	UPROPERTY()
+	TArray<UProcGeneratorChain*> ConcurrentSubChains;
+
+	UPROPERTY()
+	TArray<UPGContextDataObject*> ConcurrentContexts;
+
+	//ThrowError from a concurrent task is deferred to the join
+	FString PendingConcurrentError;
+	FThreadSafeBool bHasPendingConcurrentError;
+	FThreadSafeBool bIsRunningConcurrently;
+
 	FThreadSafeBool bShouldLatentStillRun;
 };
 
@@ -3,6 +3,7 @@
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
 #include "ProcGeneratorChain.h"
+#include "PGChainScheduler.h"
 #include "ProceduralChainComponent.generated.h"
 
 //DECLARE_DYNAMIC_DELEGATE_OneParam(FProcessChainSignature, FPGContextData&, ContextData);
@@ -78,6 +79,10 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Procedural Chain Component")
 	bool bProcessSubchainsInParallel;
 
+	/** Run the chain tree through UPGChainScheduler, independent chains (by declared context keys) run concurrently. No latent chains */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Procedural Chain Component")
+	bool bUseChainScheduler;
+
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Procedural Chain Component")
 	bool bDebugLogFlow;
 
@@ -88,6 +93,9 @@ public:
 	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Category = "Procedural Chain Component")
 	UProcGeneratorChain* MainChain;
 
+	UPROPERTY(BlueprintReadOnly, Category = "Procedural Chain Component")
+	UPGChainScheduler* ChainScheduler;
+
 	/** Add a specified chain class at particular chain order (next or sub)*/
 	UFUNCTION(BlueprintCallable, Category = "Procedural Chain Component")
 	UProcGeneratorChain* AddChainByClass(UClass* ChainClass, EPGChainOrder Order = EPGChainOrder::Sub);
@@ -157,6 +165,9 @@ protected:
 	UFUNCTION()
 	void ResetChains();
 
+	//Starts the main chain directly or through the scheduler
+	void StartMainChain();
+
 	virtual void BeginPlay() override;
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 };
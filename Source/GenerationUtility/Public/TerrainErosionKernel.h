@@ -0,0 +1,99 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TerrainErosionKernel.generated.h"
+
+USTRUCT(BlueprintType)
+struct GENERATIONUTILITY_API FTerrainErosionSettings
+{
+	GENERATED_USTRUCT_BODY();
+
+	//Droplets spawned per heightmap sample, fractional part is a spawn chance
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = ErosionParams)
+	float DropletsPerSample;
+
+	//Steps per droplet, each step moves one sample
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = ErosionParams)
+	int32 MaxLifetime;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = ErosionParams)
+	float Inertia;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = ErosionParams)
+	float SedimentCapacityFactor;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = ErosionParams)
+	float MinSedimentCapacity;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = ErosionParams)
+	float ErodeSpeed;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = ErosionParams)
+	float DepositSpeed;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = ErosionParams)
+	float EvaporateSpeed;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = ErosionParams)
+	float Gravity;
+
+	//Brush radius in samples for removing material
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = ErosionParams)
+	int32 ErosionRadius;
+
+	//Droplets are split into rounds, each round sees the heights left by the previous ones
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = ErosionParams)
+	int32 Rounds;
+
+	//Droplets spawned in one tile are simulated by one task
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = ErosionParams)
+	int32 TileSize;
+
+	//Extra samples generated around each patch and eroded with it, then cropped so neighbours agree at the seam.
+	//Never less than DropletReach. With more than one round the agreement is approximate: droplets of later
+	//rounds see halo heights eroded by droplets outside the halo, which only the neighbour simulates
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = ErosionParams)
+	int32 SeamHalo;
+
+	FTerrainErosionSettings()
+	{
+		DropletsPerSample = 1.f;
+		MaxLifetime = 30;
+		Inertia = 0.05f;
+		SedimentCapacityFactor = 4.f;
+		MinSedimentCapacity = 0.01f;
+		ErodeSpeed = 0.3f;
+		DepositSpeed = 0.3f;
+		EvaporateSpeed = 0.01f;
+		Gravity = 4.f;
+		ErosionRadius = 3;
+		Rounds = 4;
+		TileSize = 64;
+		SeamHalo = 40;
+	}
+};
+
+/**
+* Droplet hydraulic erosion split across tiles. Each tile simulates the droplets spawned inside it against
+* the heights of the previous round and writes its changes to a private buffer that covers the tile plus
+* the furthest a droplet can travel. Buffers are summed in tile order, so the result only depends on the
+* seed and settings, never on thread timing. Droplets are seeded by global sample coordinate, so patches
+* eroded with a halo make the same droplets as their neighbours near the shared seam.
+*/
+class GENERATIONUTILITY_API FTerrainErosionKernel
+{
+public:
+	/**
+	* Erodes a Size x Size (row major) heightmap in place. GlobalOffset is the sample coordinate of index 0,
+	* droplet seeds and the tile grid follow global coordinates so overlapping maps erode their overlap alike.
+	* Returns false if interrupted, heights are then partially eroded.
+	*/
+	static bool Erode(TArray<float>& Heights, int32 Size, const FTerrainErosionSettings& Settings, int32 Seed,
+		const FIntPoint& GlobalOffset, TFunction<bool()> InterruptCheck = nullptr);
+
+	/** Copies the centre of a (Size + 2 * Border) square map into a Size square map */
+	static void CropSquare(const TArray<float>& Source, int32 Border, int32 Size, TArray<float>& OutCropped);
+
+	/** Samples a droplet can reach from its tile, buffers and seam halos need at least this */
+	static int32 DropletReach(const FTerrainErosionSettings& Settings);
+};
@@ -4,7 +4,13 @@
 #include "HeightmapDeformersLibrary.h"
 #include "ProceduralMeshComponent.h"
 #include "RealtimeMeshComponent.h"
+#include "RealtimeMeshSimple.h"
 #include "GridSurfaceCache.h"
+#include "CubicSphere.h"
+#include "PatchDiskStore.h"
+#include "TerrainNoiseKernel.h"
+#include "TerrainErosionKernel.h"
+#include "Tickable.h"
 #include "TerrainGeneratorChain.generated.h"
 
 USTRUCT(BlueprintType)
@@ -60,9 +66,14 @@ struct FTGMasks
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
 	TArray<FTGMaskReference> Masks;
 
+	//Apply consecutive Add/chain op masks in one bilinear pass (FTerrainMaskCompositor) instead of a library pass each
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	bool bFuseMaskPass;
+
 	FTGMasks()
 	{
 		bUseMasks = true;
+		bFuseMaskPass = false;
 	}
 };
 
@@ -78,6 +89,10 @@ struct FTerrainGenerationParams
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
 	bool bCalculateTangents;
 
+	//Build tip nodes across worker threads straight into realtime mesh streams
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	bool bParallelQuadFaces;
+
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
 	int32 QuadPatchResolution;
 
@@ -107,6 +122,14 @@ struct FTerrainGenerationParams
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
 	bool bQuadSplit;
 
+	//Split nodes merge back once the camera is this factor past their split distance, stops LOD flicker at the boundary
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	float QuadMergeHysteresis;
+
+	//Balance quad tips 2:1 and stitch edges towards coarser neighbours so LOD seams don't crack. Needs an odd QuadPatchResolution
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	bool bStitchQuadEdges;
+
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
 	int32 Seed;
@@ -133,6 +156,10 @@ struct FTerrainGenerationParams
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
 	bool bRidgedSource;
 
+	//Row-at-a-time SIMD noise (FTerrainNoiseKernel) instead of PerlinDeformMap. Not the same noise field, switching changes the terrain
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	bool bUseVectorizedNoise;
+
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
 	bool bApplyErosion;
 
@@ -143,6 +170,13 @@ struct FTerrainGenerationParams
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
 	FHydroErosionParams HydroParams;
 
+	//Erode with FTerrainErosionKernel (parallel tiles, seam halo) instead of HydraulicErosionOnHeightMapWithInterrupt
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	bool bUseTiledErosion;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	FTerrainErosionSettings ErosionSettings;
+
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
 	UMaterial* Material;
 
@@ -159,6 +193,49 @@ struct FTerrainGenerationParams
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
 	int32 ComputeGridSize;
 
+	//Patch workers running in parallel, <= 0 uses the platform worker thread count
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	int32 TerrainWorkerCount;
+
+	//Game thread texture/mesh uploads per frame, <= 0 uploads everything queued
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	int32 MaxPatchUploadsPerFrame;
+
+	//Workers block once this many results wait for upload
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	int32 MaxQueuedPatchResults;
+
+	//Keep a ring of patches generated around the viewer instead of the fixed ComputeGridSize square
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	bool bStreamAroundViewer;
+
+	//Ring radius in patches
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	int32 StreamingRadius;
+
+	//Hidden patches kept for revisits, least recently seen are destroyed past this
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	int32 MaxCachedPatches;
+
+	//Released patch meshes/textures/materials kept for reuse, extras are destroyed
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	int32 MaxPooledPatchResources;
+
+	//Memory budget for generated patch heights, reused by streaming revisits and reruns with the same params
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	int32 PatchCacheBudgetMB;
+
+	//Also keep generated heights on disk (FPGCacheSettings path), a restart then loads instead of regenerating
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	bool bPersistPatches;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	EPatchStoreFormat PatchStoreFormat;
+
+	//Every params change gets its own patch folder, least recently used ones beyond this are deleted. <= 0 keeps all
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
+	int32 MaxPatchStoreFolders;
+
 	//Temporary - needs to be in it's own node in layered structure
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = TerrainParams)
 	TEnumAsByte<EPixelFormat> GeneratedTextureType;
@@ -180,10 +257,12 @@ struct FTerrainGenerationParams
 		Seed = 1;
 		FrequencyShift = FVector(0.f);
 		bApplyErosion = false;
+		bUseTiledErosion = false;
 		bOutputToGeneratedMesh = false;
 		Octaves = 1;
 		OctaveFactor = 2.f;
 		bRidgedSource = false;
+		bUseVectorizedNoise = false;
 		Material = nullptr;
 
 		GeneratedTextureType = EPixelFormat::PF_FloatRGBA;
@@ -192,11 +271,23 @@ struct FTerrainGenerationParams
 		PerlinSpacing = PatchSize;
 		VisualSpacing = (PatchSize-1)*16;
 		ComputeGridSize = 2;
+		TerrainWorkerCount = 0;
+		MaxPatchUploadsPerFrame = 2;
+		MaxQueuedPatchResults = 8;
+		bStreamAroundViewer = false;
+		StreamingRadius = 3;
+		MaxCachedPatches = 16;
+		MaxPooledPatchResources = 32;
+		PatchCacheBudgetMB = 256;
+		bPersistPatches = false;
+		PatchStoreFormat = EPatchStoreFormat::Quantized16;
+		MaxPatchStoreFolders = 4;
 
 		//Quad tests
 		bGenerateCubeQuadSphere = true;
 		bCalculateTangents = false; //this can be slow!
-		QuadPatchResolution = 64;
+		bParallelQuadFaces = true;
+		QuadPatchResolution = 65;
 		QuadScaling = 1000.f;
 		QuadSphereFactor = 1.f;
 		QuadEquiangularFactor = 1.f;
@@ -205,9 +296,34 @@ struct FTerrainGenerationParams
 		CubeQuadBaseline = 4000.f;
 		bQuadTopOnly = false;
 		bQuadSplit = true;
+		QuadMergeHysteresis = 1.1f;
+		bStitchQuadEdges = true;
 	}
 };
 
+USTRUCT(BlueprintType)
+struct FTerrainNoiseBenchmark
+{
+	GENERATED_USTRUCT_BODY();
+
+	UPROPERTY(BlueprintReadOnly, Category = TerrainParams)
+	double LibrarySamplesPerSecond = 0.0;
+
+	UPROPERTY(BlueprintReadOnly, Category = TerrainParams)
+	double KernelSamplesPerSecond = 0.0;
+
+	UPROPERTY(BlueprintReadOnly, Category = TerrainParams)
+	double ScalarSamplesPerSecond = 0.0;
+
+	//Largest difference between the vector kernel and its scalar reference
+	UPROPERTY(BlueprintReadOnly, Category = TerrainParams)
+	float MaxKernelError = 0.f;
+
+	//Largest difference between PerlinDeformMap and the kernel. Expected to be large, the kernel is a different noise field
+	UPROPERTY(BlueprintReadOnly, Category = TerrainParams)
+	float MaxLibraryDifference = 0.f;
+};
+
 UCLASS(Blueprintable)
 class GENERATIONUTILITY_API UArrayWrapper : public UObject
 {
@@ -236,6 +352,9 @@ struct WorkProduct
 	UMaterialInstanceDynamic* MaterialInstance;
 	UTexture2D* FloatTexture;
 	TArray<float> FloatData;
+
+	//Final terrain patch heights, shared with the patch cache
+	FPatchHeightData Heights;
 	FTransform Origin;
 	bool bHasSource;
 	bool bIsEroded;
@@ -250,7 +369,54 @@ struct WorkProduct
 		MaterialInstance = nullptr;
 	}
 
-	void GenerateMesh(AActor* Owner, int32 PatchSize, bool bWelded = true);
+	//Without a shared grid the component gets its own copy
+	void GenerateMesh(AActor* Owner, int32 PatchSize, bool bWelded = true, URealtimeMeshSimple* SharedGridMesh = nullptr);
+
+	//Flat welded PatchSize^2 grid from the canonical grid cache
+	static URealtimeMeshSimple* BuildGridMesh(UObject* Outer, int32 PatchSize);
+};
+
+//Released patch render objects, reused by patches of the same size and texture format
+USTRUCT()
+struct FTerrainPatchRenderResources
+{
+	GENERATED_USTRUCT_BODY();
+
+	UPROPERTY()
+	URealtimeMeshComponent* Mesh = nullptr;
+
+	UPROPERTY()
+	UMaterialInstanceDynamic* MaterialInstance = nullptr;
+
+	UPROPERTY()
+	UTexture2D* FloatTexture = nullptr;
+
+	int32 PatchSize = 0;
+	EPixelFormat Format = PF_Unknown;
+};
+
+//Handed from terrain workers to the game thread, data is the patch heightmap at that stage
+struct FTerrainPatchResult
+{
+	int32 WorkIndex = INDEX_NONE;
+
+	//Streamed patches are keyed by coordinate instead
+	FIntPoint Coord = FIntPoint::ZeroValue;
+	bool bStreamed = false;
+
+	bool bIsEroded = false;
+
+	//Stored results are the patch cache's buffer itself, shared through to the upload instead of copied
+	FPatchHeightData Heights;
+};
+
+//Game thread state of a patch in streaming mode
+struct FStreamedTerrainPatch
+{
+	WorkProduct Product;
+	double LastVisibleTime = 0.0;
+	bool bGenerating = false;
+	bool bVisible = false;
 };
 
 
@@ -262,7 +428,7 @@ struct WorkProduct
  * Main chain class for running terrain generation
  */
 UCLASS(Blueprintable)
-class GENERATIONUTILITY_API UTerrainGeneratorChain : public UProcGeneratorChain
+class GENERATIONUTILITY_API UTerrainGeneratorChain : public UProcGeneratorChain, public FTickableGameObject
 {
 	GENERATED_BODY()
 
@@ -277,6 +443,10 @@ public:
 
 	void OnChainFinished_Implementation(UPGContextDataObject* InOutContextData);
 
+	//Workers capture this, destruction waits until they exited
+	virtual void BeginDestroy() override;
+	virtual bool IsReadyForFinishDestroy() override;
+
 public:
 
 	UFUNCTION(BlueprintCallable, Category="Terrain Generation")
@@ -287,8 +457,127 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Terrain Generation")
 	void GenerateCubeQuadSphere(UPGContextDataObject* Data);
 
+	/** Moves the quad split sphere LOD to a new camera, only tip nodes that split or merged are rebuilt */
+	UFUNCTION(BlueprintCallable, Category = "Terrain Generation")
+	void UpdateCubeQuadSphereLOD(FVector CameraWorldVector);
+
+	/** Times PerlinDeformMap against the noise kernel and its scalar reference for one patch with current params, and reports how far their heights differ */
+	UFUNCTION(BlueprintCallable, Category = "Terrain Generation")
+	FTerrainNoiseBenchmark BenchmarkNoise(int32 Iterations = 10);
+
+	//~ Begin FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	//~ End FTickableGameObject
+
 protected:
-	TQueue<WorkProduct> WorkGrid;
-	FThreadSafeBool bSafeToAccessGrid;
+	//Runs on a terrain worker, results are queued for Tick
+	void ProcessTerrainWorkUnit(int32 WorkIndex, const FPGCancellationTokenRef& Token);
+
+	//Perlin, masks and erosion for one patch, queues source and eroded results. False if cancelled
+	bool GeneratePatchResults(TArray<float>& FloatData, const FTransform& Origin, const FTerrainPatchResult& ResultKey, const FPGCancellationTokenRef& Token);
+
+	//Called by the last worker to exit
+	void FinishTerrainWorkers(const FPGCancellationTokenRef& Token);
+
+	//Game thread: workers of a previous run read Params without locks. If any are left they're cancelled and Run is
+	//deferred to the Tick where the last one exited, returns true in that case and the caller must return
+	typedef void (UTerrainGeneratorChain::*FTerrainRunFunction)(UPGContextDataObject*);
+	bool DeferUntilWorkersExited(FTerrainRunFunction Run, UPGContextDataObject* Data);
+
+	//Blocks only while the queue is full, false if cancelled meanwhile
+	bool EnqueuePatchResult(FTerrainPatchResult&& Result, const FPGCancellationTokenRef& Token);
+	void ClearPatchResults();
+
+	//Game thread: allocate patch mesh/texture if needed and upload the result
+	void UploadPatchResult(FTerrainPatchResult& Result);
+
+	//Game thread: pooled mesh/texture/material for a work unit, released ones are hidden until reused
+	void AcquirePatchResources(WorkProduct& WorkUnit, AActor* Owner);
+	void ReleasePatchResources(WorkProduct& WorkUnit);
+	void ReleaseWorkItems();
+
+	//One grid mesh per patch size, drawn by every patch component of that size
+	URealtimeMeshSimple* GetSharedGridMesh(int32 PatchSize);
+
+	//Perlin along sphere center, copies params so it can outlive the call
+	TFunction<void(FMeshSectionData&)> MakeQuadDeformCallback(const FTransform& Origin) const;
+
+	//Streaming mode, all game thread
+	void StartTerrainStreaming(UPGContextDataObject* Data);
+	void UpdateTerrainStreaming();
+	void DispatchStreamedPatch(const FIntPoint& Coord);
+	void EvictStreamedPatches();
+	void ResetStreamedPatches();
+	bool GetStreamingViewer(FVector& OutLocation, FVector& OutForward, float& OutFOV) const;
+
+	//Identifies params that affect generated heights, cached patches are dropped when it changes
+	uint32 ComputeHeightParamsHash() const;
+
+	//Source noise + masks into a square map, Border extra samples on each side of the patch
+	void GenerateSourceHeights(TArray<float>& FloatData, const FTransform& Origin, int32 Border);
+
+	//FTerrainNoiseKernel settings for a patch, Border moves the first sample out by that many samples
+	FTerrainNoiseSettings NoiseSettingsForOrigin(const FTransform& Origin, int32 Border = 0) const;
+
+	//Erosion params as used by the patch workers, library or tiled kernel
+	bool UsesTiledErosion() const;
+	int32 ErosionSeamHalo() const;
+
+	//Worker side patch stores: memory cache first, then disk if persisting
+	static FPatchKey PatchKeyForOrigin(const FTransform& Origin);
+	FPatchHeightData FindStoredPatch(const FPatchKey& Key);
+	FPatchHeightData StorePatch(const FPatchKey& Key, TArray<float>&& Heights);
+
+	//Not resized while workers run, NextWorkIndex hands out entries lock-free
+	TArray<WorkProduct> WorkItems;
+	FThreadSafeCounter NextWorkIndex;
+
+	//Every background task reading Params or WorkItems, grid, streamed and cube sphere alike
+	FThreadSafeCounter ActiveTerrainWorkers;
+	FThreadSafeCounter GridWorkersLeft;
 	FThreadSafeBool bWorkersShouldRun;
+
+	TQueue<FTerrainPatchResult, EQueueMode::Mpsc> PatchResults;
+	FThreadSafeCounter QueuedPatchResults;
+	FThreadSafeBool bTerrainWorkersDone;
+	bool bTickPatchUploads = false;
+
+	TMap<FIntPoint, FStreamedTerrainPatch> StreamedPatches;
+	bool bStreamingActive = false;
+	bool bStreamingResumed = false;
+
+	//Final heights by patch, shared with terrain workers
+	FPatchHeightCache PatchHeightCache;
+	FPatchDiskStore PatchDiskStore;
+	uint32 PatchCacheParamsHash = 0;
+
+	TSharedPtr<FPGCancellationToken, ESPMode::ThreadSafe> TerrainRunToken;
+
+	//Run waiting for the previous run's workers to exit
+	FTerrainRunFunction DeferredRun = nullptr;
+	double DeferredRunStartTime = 0.0;
+
+	UPROPERTY()
+	UPGContextDataObject* DeferredRunData = nullptr;
+
+	UPROPERTY()
+	UPGContextDataObject* TerrainRunData = nullptr;
+
+	UPROPERTY()
+	TArray<FTerrainPatchRenderResources> PooledPatchResources;
+
+	UPROPERTY()
+	TMap<int32, URealtimeMeshSimple*> SharedGridMeshes;
+
+	//Quad split sphere from the last GenerateCubeQuadSphere, its quadtree is what incremental LOD diffs against
+	TSharedPtr<FCubicSphere, ESPMode::ThreadSafe> QuadSphere;
+	FCubicSphereParams QuadSphereParams;
+	FTransform QuadSphereOrigin;
+	bool bQuadLODUpdating = false;
+
+	UPROPERTY()
+	URealtimeMeshComponent* QuadSphereMesh = nullptr;
 };
\ No newline at end of file
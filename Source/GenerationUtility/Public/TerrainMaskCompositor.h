@@ -0,0 +1,50 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectKey.h"
+
+struct FTGMaskReference;
+class UTexture2D;
+
+/**
+* Applies a run of terrain masks in one pass over the heightmap. Mask to patch transforms are reduced to a
+* per texel step up front, every mask is then sampled bilinearly per texel while the height is in register.
+*/
+class GENERATIONUTILITY_API FTerrainMaskCompositor
+{
+public:
+	/** Hard cutoff chain ops and Add default ops, anything else has to go through the deformer library */
+	static bool CanFuse(const FTGMaskReference& Mask);
+
+	/** PatchTransform places sample (x, y) of the Size x Size heightmap in mask space, same as the library deformers */
+	static void ApplyFused(TArray<float>& Heights, int32 Size, const FTransform& PatchTransform, const TArray<const FTGMaskReference*>& Masks);
+};
+
+/**
+* Process wide greyscale float conversions of mask textures, so rebuilt chains don't reconvert every
+* OnPreProcessChain. Entries of textures that are gone are pruned on the next Convert, resized or reimported
+* textures are reconverted. Game thread only.
+*/
+class GENERATIONUTILITY_API FTGMaskFloatCache
+{
+public:
+	static FTGMaskFloatCache& Get();
+
+	const TArray<float>& Convert(UTexture2D* Texture);
+
+	void Clear();
+
+	int32 Num() const;
+
+private:
+	struct FEntry
+	{
+		TWeakObjectPtr<UTexture2D> Texture;
+		FGuid LightingGuid;
+		int32 SizeX = 0;
+		int32 SizeY = 0;
+		TArray<float> Values;
+	};
+
+	TMap<FObjectKey, FEntry> Entries;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FTerrainNoiseSettings
+{
+	float Magnitude = 1.f;
+	float Frequency = 0.01f;
+
+	//In samples, e.g. patch origin * spacing
+	FVector2f Shift = FVector2f::ZeroVector;
+
+	int32 Seed = 0;
+	int32 Octaves = 1;
+
+	//Frequency multiplier per octave, amplitude is divided by it
+	float OctaveFactor = 2.f;
+
+	//1 - abs(noise) per octave
+	bool bRidged = false;
+};
+
+/**
+* Multi-octave 2D Perlin noise for heightmap patches. Same lattice and gradients as FMath::PerlinNoise2D,
+* evaluated four samples of a row at a time with VectorRegister4Float. The scalar variant is the reference
+* the vector path is checked against.
+* Not a reimplementation of PerlinDeformMap: seeds are our own lattice offsets and octave weights our own, so
+* for the same params it produces a different height field than the library.
+*/
+class GENERATIONUTILITY_API FTerrainNoiseKernel
+{
+public:
+	static float PerlinNoise2D(float X, float Y);
+
+	/** Adds fractal noise to a Size x Size patch (row major) */
+	static void AddFractalNoise(TArray<float>& Heights, int32 Size, const FTerrainNoiseSettings& Settings);
+	static void AddFractalNoiseScalar(TArray<float>& Heights, int32 Size, const FTerrainNoiseSettings& Settings);
+
+	/** Seed maps to a lattice offset, so equal seeds give equal patches on every platform */
+	static FVector2f SeedOffset(int32 Seed);
+
+private:
+	static void AddFractalRow(float* Row, int32 Count, int32 RowIndex, const FTerrainNoiseSettings& Settings);
+	static void AddFractalRowScalar(float* Row, int32 Count, int32 FirstSample, int32 RowIndex, const FTerrainNoiseSettings& Settings);
+};